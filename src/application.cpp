@@ -5,30 +5,79 @@
 #include "aboutdialog.h"
 #include "settingsdialog.h"
 #include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "icyclient.h"
+#include "playlist.h"
 
 #include <QUrl>
 #include <QFile>
 #include <QMessageBox>
-#include <QTextCodec>
+#include <QFileDialog>
+#include <QProgressDialog>
 #include <QCursor>
+#include <QTimer>
 #include <QSettings>
+#include <QDir>
 #include <QxtGlobalShortcut>
 
 // Config file.
 #define CONFIG_FILE "config.ini"
+// Station catalog file.
+#define CATALOG_FILE "stations.dat"
+// Station health history file.
+#define HEALTH_FILE "health.dat"
 
 Application::Application( int & argc, char ** argv )
     :QApplication( argc, argv ),
-     currTrayIcon( 0 )
+     settingsDialog( 0 ),
+     catalog( CATALOG_FILE ),
+     trayAnimator( &trayItem ),
+     recordAction( 0 ),
+     meterAction( 0 ),
+     monitor( HEALTH_FILE ),
+     importer( &prober ),
+     importProgress( 0 ),
+     fastStart( true ),
+     meterEnabled( false ),
+     firstAudio( false ),
+     bufferingShown( false )
 {
+    startupTimer.start();
+    connect( &importer, SIGNAL( progress( int, int ) ), SLOT( onImportProgress( int, int ) ) );
+    connect( &importer, SIGNAL( finished( const QList< Station > &, int ) ),
+                        SLOT( onImportFinished( const QList< Station > &, int ) ) );
+    connect( &monitor, SIGNAL( healthChanged( const QString &, StationMonitor::Health ) ),
+                       SLOT( onStationHealth( const QString &, StationMonitor::Health ) ) );
 }
 
 Application::~Application()
 {
+    delete importProgress;
+    delete settingsDialog;
+}
+
+void Application::setStartupTimer( const QElapsedTimer & timer )
+{
+    startupTimer = timer;
+}
+
+bool Application::claimInstance()
+{
+    if ( !control.listen() )
+    {
+        LOG_INFO( "application", tr( "Another instance is running." ) );
+        return false;
+    }
+
+    connect( &control, SIGNAL( commandReceived( const QString &, const QString &, QString * ) ),
+                       SLOT( onControlCommand( const QString &, const QString &, QString * ) ) );
+    return true;
 }
 
 bool Application::loadSettings()
 {
+    TRACE_SCOPE( "Application::loadSettings" );
     if ( !QFile::exists( CONFIG_FILE ) )
     {
         LOG_ERROR( "application", tr( "No config file!" ) );
@@ -39,13 +88,109 @@ bool Application::loadSettings()
     settings.beginGroup( "VOLUME" );
     player.setVolumeStep( settings.value( "step", 0.1 ).toReal() );
     settings.endGroup();
+    settings.beginGroup( "LOG" );
+    if ( Logger::instance() )
+    {
+        // "level" is common, other keys are per-source levels.
+        foreach ( const QString & key, settings.childKeys() )
+        {
+            const Logger::Type level = Logger::levelFromString( settings.value( key ).toString(),
+                                                                Logger::Debug );
+            if ( key == "level" )
+                Logger::instance()->setLevel( level );
+            else
+                Logger::instance()->setSourceLevel( key, level );
+        }
+    }
+    settings.endGroup();
+    settings.beginGroup( "STARTUP" );
+    fastStart = settings.value( "fast", true ).toBool();
+    settings.endGroup();
+    settings.beginGroup( "TRACE" );
+    const QString traceFile = settings.value( "file" ).toString();
+    if ( !traceFile.isEmpty() && Tracer::instance() && !Tracer::isEnabled() )
+        Tracer::instance()->start( traceFile );
+    settings.endGroup();
+    settings.beginGroup( "METRICS" );
+    if ( Metrics::instance() )
+        Metrics::instance()->start( quint16( settings.value( "port", 0 ).toInt() ) );
+    settings.endGroup();
+    settings.beginGroup( "PROBE" );
+    prober.setMaxConcurrent( settings.value( "concurrency", 4 ).toInt() );
+    prober.setTimeout( settings.value( "timeout", 10000 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "MONITOR" );
+    monitor.setMaxConcurrent( settings.value( "concurrency", 1 ).toInt() );
+    monitor.setBandwidth( settings.value( "bandwidth", 32 ).toInt() );
+    monitor.setInterval( settings.value( "interval", 1800000 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "TRAY" );
+    trayAnimator.setFrameRate( settings.value( "fps", 1 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "METER" );
+    meterEnabled = settings.value( "enabled", false ).toBool();
+    settings.endGroup();
+    settings.beginGroup( "STREAM" );
+    player.setNativeStream( settings.value( "native", false ).toBool(),
+                            settings.value( "buffer", 262144 ).toInt() );
+    player.setPrebuffer( settings.value( "prebuffer_min", 500 ).toInt(),
+                         settings.value( "prebuffer_max", 8000 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "FAULTS" );
+    IcyClient::Faults faults;
+    faults.latency = settings.value( "latency", 0 ).toInt();
+    faults.bandwidth = settings.value( "bandwidth", 0 ).toInt();
+    faults.stallEvery = settings.value( "stall_every", 0 ).toInt();
+    faults.stallLength = settings.value( "stall_length", 0 ).toInt();
+    faults.dropAfter = settings.value( "drop_after", 0 ).toInt();
+    player.setFaults( faults );
+    settings.endGroup();
+    settings.beginGroup( "DNS" );
+    resolver.setLifetime( settings.value( "lifetime", 300000 ).toInt() );
+    resolver.setPreconnectLimit( settings.value( "preconnect", 2 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "RECONNECT" );
+    player.setReconnectPolicy( settings.value( "attempts", 8 ).toInt(),
+                               settings.value( "budget", 120000 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "STANDBY" );
+    player.setStandbyLimits( settings.value( "count", 2 ).toInt(),
+                             settings.value( "bandwidth", 320 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "TIMESHIFT" );
+    QString spillFile = settings.value( "file" ).toString();
+    if ( spillFile.isEmpty() )
+        spillFile = QDir::tempPath() + "/qradiotray-timeshift.dat";
+    // Off by default: timeshift routes http stations through own stream client.
+    player.setTimeshift( settings.value( "minutes", 0 ).toInt(),
+                         settings.value( "memory", 33554432 ).toInt(), spillFile );
+    settings.endGroup();
+    settings.beginGroup( "RECORD" );
+    recorder.setDirectory( settings.value( "directory" ).toString() );
+    recorder.setSplitTracks( settings.value( "split", true ).toBool() );
+    recorder.setBacklogLimit( settings.value( "backlog", 16777216 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "METADATA" );
+    metaDataFilter.setWindow( settings.value( "debounce", 1000 ).toInt() );
+    metaDataFilter.setMaxWait( settings.value( "max_wait", 4000 ).toInt() );
+    settings.endGroup();
+    settings.beginGroup( "MENU" );
+    stationsMenu.setFlatLimit( settings.value( "flat_limit", 40 ).toInt() );
+    settings.endGroup();
     settings.beginGroup( "SHORTCUTS" );
     volumeDownHotkey  = settings.value( "VOLUME_DOWN_HOTKEY", "Alt+Q" ).toString();
     volumeUpHotkey = settings.value( "VOLUME_UP_HOTKEY", "Alt+W" ).toString();
     stopHotkey = settings.value( "STOP_HOTKEY", "Alt+Z" ).toString();
     pauseHotkey = settings.value( "PAUSE_HOTKEY", "Alt+S" ).toString();
     quitHotkey = settings.value( "QUIT_HOTKEY", "Alt+X" ).toString();
+    recordHotkey = settings.value( "RECORD_HOTKEY", "Alt+R" ).toString();
     settings.endGroup();
+
+    if ( catalog.exists() && catalog.load( stationList ) )
+        return true;
+
+    // First start or unreadable catalog: import stations from config file,
+    // save rewrites the catalog.
     settings.beginGroup( "STATIONS" );
     const int count = settings.beginReadArray( "station" );
     stationList.clear();
@@ -61,27 +206,19 @@ bool Application::loadSettings()
     }
     settings.endArray();
     settings.endGroup();
+    if ( catalog.save( stationList ) )
+        LOG_INFO( "application", tr( "%1 stations imported from %2 into %3." )
+                                 .arg( stationList.count() ).arg( CONFIG_FILE ).arg( CATALOG_FILE ) );
 
     return true;
 }
 
 void Application::storeSettings()
 {
-    QSettings settings( CONFIG_FILE, QSettings::IniFormat );
-    settings.beginGroup( "STATIONS" );
-    settings.remove( "" );
-    settings.beginWriteArray( "station" );
-    for ( int i = 0; i < stationList.count(); ++i )
-    {
-        const Station & station = stationList[ i ];
-        settings.setArrayIndex( i );
-        settings.setValue( "name", station.name );
-        settings.setValue( "description", station.description );
-        settings.setValue( "url", station.url );
-        settings.setValue( "encoding", station.encoding );
-    }
-    settings.endArray();
-    settings.endGroup();
+    TRACE_SCOPE( "Application::storeSettings" );
+    // Only changed stations are written.
+    if ( !catalog.save( stationList ) )
+        QMessageBox::critical( 0, tr( "Error" ), tr( "Can't save stations!" ) );
 }
 
 bool Application::configure()
@@ -100,22 +237,38 @@ bool Application::configure()
         return false;
     }
 
-    // Tray icons set.
-    trayIconList.append( ":/images/radio-active-2.png" );
-    trayIconList.append( ":/images/radio-active-1.png" );
-    trayIconList.append( ":/images/radio-active.png"   );
-    currTrayIcon = 0;
+    // Tray item goes first, everything else is built behind it.
+    if ( !fastStart )
+        player.initialize();
+    trayAnimator.setState( TrayAnimator::Passive );
+    trayItem.show();
+    reportStartup( tr( "tray visible" ) );
 
     // Setup player.
-    connect( &player, SIGNAL( playerTick( quint64 ) ), SLOT( animateIcon( quint64 ) ) );
+    player.setHostResolver( &resolver );
     connect( &player, SIGNAL( playing() ), SLOT( onPlayerPlay() ) );
+    connect( &player, SIGNAL( audioStarted() ), SLOT( onPlayerAudioStarted() ) );
     connect( &player, SIGNAL( paused() ), SLOT( onPlayerPause() ) );
     connect( &player, SIGNAL( stopped() ), SLOT( onPlayerStop() ) );
     connect( &player, SIGNAL( errorOccured() ), SLOT( onPlayerError() ) );
+    connect( &player, SIGNAL( reconnecting( int, int ) ), SLOT( onPlayerReconnecting( int, int ) ) );
+    connect( &player, SIGNAL( reconnected( int, int ) ), SLOT( onPlayerReconnected( int, int ) ) );
     connect( &player, SIGNAL( buffering( int ) ), SLOT( onPlayerBuffering( int ) ) );
     connect( &player, SIGNAL( volumeChanged( int ) ), SLOT( onPlayerVolumeChanged( int ) ) );
+    connect( &player, SIGNAL( timeshiftChanged( int ) ), SLOT( onPlayerTimeshift( int ) ) );
     connect( &player, SIGNAL( metaDataChanged( const QMultiMap< QString, QString > ) ),
-                      SLOT ( onMetaDataChange( const QMultiMap< QString, QString > ) ) );
+             &metaDataFilter, SLOT( process( const QMultiMap< QString, QString > ) ) );
+    connect( &metaDataFilter, SIGNAL( trackChanged( const QString & ) ), SLOT( onTrackChange( const QString & ) ) );
+
+    // Setup recorder, fed by own stream client.
+    connect( &player, SIGNAL( streamData( const QByteArray &, int, int ) ),
+             &recorder, SLOT( write( const QByteArray &, int, int ) ) );
+    connect( &player, SIGNAL( streamOpened( const QByteArray & ) ),
+             &recorder, SLOT( setContentType( const QByteArray & ) ) );
+    connect( &player, SIGNAL( metaDataChanged( const QMultiMap< QString, QString > ) ),
+             &recorder, SLOT( setMetaData( const QMultiMap< QString, QString > ) ) );
+    connect( &recorder, SIGNAL( stats( qint64, int, int ) ), SLOT( onRecorderStats( qint64, int, int ) ) );
+    connect( &recorder, SIGNAL( failed( const QString & ) ), SLOT( onRecorderFailed( const QString & ) ) );
 
     // Setup global shortcuts.
     QxtGlobalShortcut * globalShortcut;
@@ -149,18 +302,20 @@ bool Application::configure()
         globalShortcut->setShortcut( QKeySequence( quitHotkey ) );
         connect( globalShortcut, SIGNAL( activated() ), this, SLOT( quit()) );
     }
+    globalShortcut = new QxtGlobalShortcut( &trayItem );
+    if ( globalShortcut )
+    {
+        globalShortcut->setShortcut( QKeySequence( recordHotkey ) );
+        connect( globalShortcut, SIGNAL( activated() ), this, SLOT( toggleRecording() ) );
+    }
 
     // Create stations menu.
     stationsMenu.setTitle( tr( "Stations" ) );
-    stationsMenu.setIcon( QIcon( ":/images/radio-passive.png" ) );
-    stationsGroup = new QActionGroup( &stationsMenu );
-    if ( stationsGroup )
-    {
-        stationsGroup->setExclusive( true );
-        updateStationsMenu();
-        connect( stationsGroup, SIGNAL( triggered( QAction * ) ),
-                                SLOT( processStationAction( QAction * ) ) );
-    }
+    stationsMenu.setIcon( trayAnimator.frame( "passive" ) );
+    updateStationsMenu();
+    connect( &stationsMenu, SIGNAL( stationTriggered( quint32 ) ),
+                            SLOT( processStationAction( quint32 ) ) );
+    connect( &stationsMenu, SIGNAL( stationHovered( quint32 ) ), SLOT( onStationHovered( quint32 ) ) );
 
     // Create base menu.
     trayMenu.addMenu( &stationsMenu );
@@ -203,6 +358,42 @@ bool Application::configure()
         connect( action, SIGNAL( triggered() ), &player, SLOT( stopPlay() ) );
         trayMenu.addAction( action );
     }
+    recordAction = new QAction( &trayMenu );
+    if ( recordAction )
+    {
+        recordAction->setText( tr( "Record" ) );
+        recordAction->setCheckable( true );
+        recordAction->setShortcut( QKeySequence( recordHotkey ) );
+        connect( recordAction, SIGNAL( triggered() ), this, SLOT( toggleRecording() ) );
+        trayMenu.addAction( recordAction );
+    }
+    meterAction = new QAction( &trayMenu );
+    if ( meterAction )
+    {
+        meterAction->setText( tr( "Level meter" ) );
+        meterAction->setCheckable( true );
+        meterAction->setChecked( meterEnabled );
+        connect( meterAction, SIGNAL( triggered() ), this, SLOT( toggleLevelMeter() ) );
+        connect( &levelMeter, SIGNAL( updated() ), SLOT( onLevelsUpdated() ) );
+        trayMenu.addAction( meterAction );
+        toggleLevelMeter();
+    }
+    action = new QAction( &trayMenu );
+    if ( action )
+    {
+        action->setIcon( QIcon( ":/images/list-up.png" ) );
+        action->setText( tr( "Back 30 seconds" ) );
+        connect( action, SIGNAL( triggered() ), &player, SLOT( jumpBack() ) );
+        trayMenu.addAction( action );
+    }
+    action = new QAction( &trayMenu );
+    if ( action )
+    {
+        action->setIcon( QIcon( ":/images/list-down.png" ) );
+        action->setText( tr( "Live" ) );
+        connect( action, SIGNAL( triggered() ), &player, SLOT( goLive() ) );
+        trayMenu.addAction( action );
+    }
     trayMenu.addSeparator();
     action = new QAction( &trayMenu );
     if ( action )
@@ -236,6 +427,21 @@ bool Application::configure()
     }
     action = new QAction( &trayMenu );
     if ( action )
+    {
+        action->setIcon( QIcon( ":/images/list-add.png" ) );
+        action->setText( tr( "Import stations..." ) );
+        connect( action, SIGNAL( triggered() ), this, SLOT( importStations() ) );
+        settingsMenu.addAction( action );
+    }
+    action = new QAction( &trayMenu );
+    if ( action )
+    {
+        action->setText( tr( "Export stations..." ) );
+        connect( action, SIGNAL( triggered() ), this, SLOT( exportStations() ) );
+        settingsMenu.addAction( action );
+    }
+    action = new QAction( &trayMenu );
+    if ( action )
     {
         action->setIcon( QIcon( ":/images/application-exit.png" ) );
         action->setText( tr( "Exit" ) );
@@ -246,104 +452,311 @@ bool Application::configure()
     }
 
     // Setup tray item.
-    trayItem.setIcon( QIcon( ":/images/radio-passive.png" ) );
-    trayItem.show();
     trayItem.showMessage( tr( "QRadioTray" ), tr( "Program started!" ), QSystemTrayIcon::Information );
     connect( &trayItem, SIGNAL( activated( QSystemTrayIcon::ActivationReason ) ),
                         SLOT( processTrayActivation( QSystemTrayIcon::ActivationReason ) ) );
+    reportStartup( tr( "menu ready" ) );
+
+    // Load backend when event loop is idle.
+    if ( fastStart )
+        QTimer::singleShot( 0, &player, SLOT( initialize() ) );
     return true;
 }
 
-void Application::processStationAction( QAction * action )
+void Application::reportStartup( const QString & milestone )
 {
-    if ( !action )
-        return;
+    LOG_INFO( "startup", tr( "Startup: %1 at %2 ms." ).arg( milestone ).arg( startupTimer.elapsed() ) );
+}
 
-    const int num = action->data().toInt();
-    if ( ( num < 0 ) || ( num >= stationList.count() ) )
+void Application::processStationAction( quint32 id )
+{
+    TRACE_SCOPE( "Application::processStationAction" );
+    int num = 0;
+    while ( ( num < stationList.count() ) && ( stationList[ num ].id != id ) )
+        ++num;
+    if ( num >= stationList.count() )
         return;
 
+    TRACE_INSTANT( "station selected" );
     lastStation = stationList[ num ];
+    metaDataFilter.setEncoding( lastStation.encoding );
+    recorder.setEncoding( lastStation.encoding );
+    recorder.setStation( lastStation.name );
     if ( lastStation.url != player.getSource() )
     {
-        if ( player.isPlaying() || player.isPaused() )
+        metaDataFilter.reset();
+        currentTrack.clear();
+        player.switchTo( QUrl( lastStation.url ) );
+        LOG_INFO( "application", tr( "Station #%1 selected." ).arg( num ) );
+    }
+
+    // Neighbours in menu and most played stations are likely next.
+    ++playCounts[ id ];
+    QList< QUrl > likely;
+    if ( num + 1 < stationList.count() )
+        likely.append( QUrl( stationList[ num + 1 ].url ) );
+    if ( num > 0 )
+        likely.append( QUrl( stationList[ num - 1 ].url ) );
+    QMultiMap< int, quint32 > played;
+    QHash< quint32, int >::const_iterator it = playCounts.constBegin();
+    for ( ; it != playCounts.constEnd(); ++it )
+        played.insert( -it.value(), it.key() );
+    foreach ( quint32 playedId, played.values() )
+    {
+        foreach ( const Station & station, stationList )
         {
-            player.stopPlay();
-            player.setUrl( QUrl( lastStation.url ) );
-            player.startPlay();
+            if ( ( station.id == playedId ) && ( playedId != id ) )
+                likely.append( QUrl( station.url ) );
         }
-        else
-            player.setUrl( QUrl( lastStation.url ) );
-        LOG_INFO( "application", tr( "Station #%1 selected." ).arg( num ) );
     }
+    player.warmUp( likely );
 }
 
-void Application::about()
+void Application::onStationHovered( quint32 id )
 {
-    AboutDialog dialog;
-    dialog.exec();
+    foreach ( const Station & station, stationList )
+    {
+        if ( ( station.id == id ) && ( station.url != player.getSource() ) )
+            resolver.preconnect( QUrl( station.url ) );
+    }
 }
 
-void Application::manageSettings()
+void Application::onStationHealth( const QString & url, StationMonitor::Health health )
 {
-    if ( settingsDialog.isVisible() )
-        return;
+    // Same url may be listed under several names.
+    foreach ( const Station & station, stationList )
+    {
+        if ( station.url == url )
+            stationsMenu.setHealth( station.id, health, monitor.summary( url ) );
+    }
+}
 
-    settingsDialog.setStationList( stationList );
-    if ( settingsDialog.exec() == QDialog::Accepted )
+void Application::onControlCommand( const QString & command, const QString & argument, QString * reply )
+{
+    TRACE_SCOPE( "Application::onControlCommand" );
+    if ( command == "STATUS" )
     {
-        stationList = settingsDialog.getStationList();
-        storeSettings();
-        updateStationsMenu();
+        QString state = "stopped";
+        if ( player.isReconnecting() )
+            state = "reconnecting";
+        else if ( player.isBuffering() )
+            state = "buffering";
+        else if ( player.isPlaying() )
+            state = "playing";
+        else if ( player.isPaused() )
+            state = "paused";
+        else if ( player.isError() )
+            state = "error";
+
+        QStringList fields;
+        fields << state << QString::number( qRound( 100.0 * player.getVolume() ) )
+               << QString::number( lastStation.id ) << lastStation.name << currentTrack;
+        fields.replaceInStrings( "\t", " " );
+        *reply = "OK\t" + fields.join( "\t" );
     }
+    else if ( command == "PLAY" )
+    {
+        if ( player.getSource().isEmpty() )
+            *reply = "ERR " + tr( "no station selected" );
+        else
+            player.startPlay();
+    }
+    else if ( command == "PAUSE" )
+        player.pausePlay();
+    else if ( command == "STOP" )
+        player.stopPlay();
+    else if ( command == "STATION" )
+    {
+        // Id, exact name or first name containing argument.
+        bool isId = false;
+        const quint32 wanted = argument.toUInt( &isId );
+        int found = -1;
+        for ( int i = 0; i < stationList.count(); ++i )
+        {
+            const Station & station = stationList[ i ];
+            if ( ( isId && ( station.id == wanted ) ) ||
+                 ( station.name.compare( argument, Qt::CaseInsensitive ) == 0 ) )
+            {
+                found = i;
+                break;
+            }
+            if ( ( found < 0 ) && !argument.isEmpty() && station.name.contains( argument, Qt::CaseInsensitive ) )
+                found = i;
+        }
+
+        if ( found < 0 )
+        {
+            *reply = "ERR " + tr( "no station \"%1\"" ).arg( argument );
+            return;
+        }
+        const quint32 id = stationList[ found ].id;
+        stationsMenu.setCurrent( id );
+        processStationAction( id );
+        if ( !player.isPlaying() && !player.isBuffering() )
+            player.startPlay();
+    }
+    else if ( command == "VOLUME" )
+    {
+        bool valid = false;
+        const int value = argument.toInt( &valid );
+        if ( !valid )
+        {
+            *reply = "ERR " + tr( "bad volume \"%1\"" ).arg( argument );
+            return;
+        }
+        // Signed value is a step from current volume.
+        const bool relative = argument.startsWith( '+' ) || argument.startsWith( '-' );
+        player.setVolume( ( relative ? player.getVolume() : 0.0 ) + value / 100.0 );
+    }
+    else
+        *reply = "ERR " + tr( "unknown command %1" ).arg( command );
 }
 
-void Application::updateStationsMenu()
+void Application::importStations()
 {
-    if ( !stationsGroup )
+    if ( importer.isRunning() )
+        return;
+
+    const QString fileName = QFileDialog::getOpenFileName( 0, tr( "Import stations" ), QString(),
+                                                           Playlist::fileFilter() );
+    if ( fileName.isEmpty() )
         return;
 
-    stationsGroup->actions().clear();
-    stationsMenu.clear();
-    for ( int i = 0; i < stationList.count(); ++i )
+    if ( !importer.start( fileName, stationList ) )
     {
-        QAction * action = new QAction( stationsGroup );
-        if ( action )
+        QMessageBox::critical( 0, tr( "Error" ), tr( "Can't read playlist %1!" ).arg( fileName ) );
+        return;
+    }
+
+    if ( importer.isRunning() )
+    {
+        if ( !importProgress )
         {
-            const Station & station = stationList[ i ];
-            action->setText( station.name );
-            action->setData( i );
-            action->setToolTip( station.description );
-            action->setCheckable( true );
-            stationsMenu.addAction( action );
+            importProgress = new QProgressDialog;
+            importProgress->setWindowTitle( tr( "Import stations" ) );
+            importProgress->setLabelText( tr( "Checking stations..." ) );
+            importProgress->setWindowModality( Qt::NonModal );
+            importProgress->setAutoClose( false );
+            importProgress->setAutoReset( false );
+            connect( importProgress, SIGNAL( canceled() ), SLOT( cancelImport() ) );
         }
+        importProgress->setRange( 0, 0 );
+        importProgress->setValue( 0 );
+        importProgress->show();
+    }
+}
+
+void Application::exportStations()
+{
+    const QString fileName = QFileDialog::getSaveFileName( 0, tr( "Export stations" ), QString(),
+                                                           Playlist::fileFilter() );
+    if ( fileName.isEmpty() )
+        return;
+
+    if ( !Playlist::write( fileName, stationList ) )
+        QMessageBox::critical( 0, tr( "Error" ), tr( "Can't write playlist %1!" ).arg( fileName ) );
+}
+
+void Application::onImportProgress( int done, int total )
+{
+    if ( !importProgress )
+        return;
+
+    importProgress->setRange( 0, total );
+    importProgress->setValue( done );
+}
+
+void Application::onImportFinished( const QList< Station > & stations, int rejected )
+{
+    if ( importProgress )
+        importProgress->hide();
+
+    // Commit whole batch at once.
+    if ( !stations.isEmpty() )
+    {
+        const int oldCount = stationList.count();
+        stationList += stations;
+        storeSettings();
+        updateStationsMenu();
+        // Dialog gets copies with ids given by catalog.
+        if ( settingsDialog && settingsDialog->isVisible() )
+            settingsDialog->appendStations( stationList.mid( oldCount ) );
     }
+
+    trayItem.showMessage( tr( "QRadioTray" ),
+                          tr( "Imported %1 stations, rejected %2." )
+                          .arg( stations.count() ).arg( rejected ),
+                          QSystemTrayIcon::Information );
 }
 
-void Application::animateIcon( quint64 tick )
+void Application::cancelImport()
 {
-    Q_UNUSED( tick );
+    importer.cancel();
+    if ( importProgress )
+        importProgress->hide();
+    LOG_INFO( "application", tr( "Import cancelled." ) );
+}
+
+void Application::about()
+{
+    AboutDialog dialog;
+    dialog.exec();
+}
 
-    if ( !player.isPlaying() )
+void Application::manageSettings()
+{
+    if ( !settingsDialog )
+    {
+        settingsDialog = new SettingsDialog;
+        settingsDialog->setProber( &prober );
+    }
+
+    if ( settingsDialog->isVisible() )
         return;
 
-    if ( currTrayIcon >= trayIconList.count() )
-        currTrayIcon = 0;
-    trayItem.setIcon( QIcon( trayIconList[ currTrayIcon ] ) );
-    currTrayIcon++;
+    settingsDialog->setStationList( stationList );
+    if ( settingsDialog->exec() == QDialog::Accepted )
+    {
+        stationList = settingsDialog->getStationList();
+        storeSettings();
+        updateStationsMenu();
+    }
+}
+
+void Application::updateStationsMenu()
+{
+    TRACE_SCOPE( "Application::updateStationsMenu" );
+    stationsMenu.setStations( stationList );
+    // New or edited hosts are looked up in background.
+    resolver.prefetch( stationList );
+    monitor.setStations( stationList );
+    foreach ( const Station & station, stationList )
+    {
+        if ( monitor.health( station.url ) != StationMonitor::Unknown )
+            stationsMenu.setHealth( station.id, monitor.health( station.url ), monitor.summary( station.url ) );
+    }
 }
 
 void Application::onPlayerPlay()
 {
-    trayItem.setIcon( QIcon( ":/images/radio-active.png" ) );
+    trayAnimator.setState( TrayAnimator::Playing );
     trayItem.showMessage( tr( "QRadioTray" ), tr( "Radio is playing." ),
                           QSystemTrayIcon::Information );
     trayItem.setToolTip( tr( "Radio is playing." ) );
 }
 
+void Application::onPlayerAudioStarted()
+{
+    if ( firstAudio )
+        return;
+
+    firstAudio = true;
+    reportStartup( tr( "first audio" ) );
+}
+
 void Application::onPlayerPause()
 {
-    trayItem.setIcon( QIcon( ":/images/radio-passive.png" ) );
+    trayAnimator.setState( TrayAnimator::Passive );
     trayItem.showMessage( tr( "QRadioTray" ), tr( "Radio is paused." ),
                           QSystemTrayIcon::Information );
     trayItem.setToolTip( tr( "Radio is paused." ) );
@@ -351,7 +764,7 @@ void Application::onPlayerPause()
 
 void Application::onPlayerStop()
 {
-    trayItem.setIcon( QIcon( ":/images/radio-passive.png" ) );
+    trayAnimator.setState( TrayAnimator::Passive );
     trayItem.showMessage( tr( "QRadioTray" ), tr( "Radio stopped." ),
                           QSystemTrayIcon::Information );
     trayItem.setToolTip( tr( "Radio stopped." ) );
@@ -359,17 +772,48 @@ void Application::onPlayerStop()
 
 void Application::onPlayerError()
 {
-    trayItem.setIcon( QIcon( ":/images/radio-passive.png" ) );
+    trayAnimator.setState( TrayAnimator::Error );
     trayItem.showMessage( tr( "QRadioTray" ), tr( "Error occured!" ),
                           QSystemTrayIcon::Critical );
     trayItem.setToolTip( tr( "Error occured!" ) );
 }
 
+void Application::onPlayerReconnecting( int attempt, int delay )
+{
+    // Quiet while buffered audio plays, balloon only when it is heard.
+    trayAnimator.setState( TrayAnimator::Buffering );
+    trayItem.setToolTip( tr( "Stream lost, reconnecting ( attempt %1 in %2 s )..." )
+                         .arg( attempt ).arg( ( delay + 999 ) / 1000 ) );
+    if ( ( attempt == 1 ) && !player.isPlaying() )
+        trayItem.showMessage( tr( "QRadioTray" ), tr( "Reconnecting..." ), QSystemTrayIcon::Warning );
+}
+
+void Application::onPlayerReconnected( int attempts, int outage )
+{
+    LOG_INFO( "application", tr( "Stream restored after %1 attempts, outage %2 msec ( %3 outages, %4 msec total )." )
+                             .arg( attempts ).arg( outage ).arg( player.outageCount() ).arg( player.outageTime() ) );
+    if ( player.isPlaying() )
+        trayAnimator.setState( TrayAnimator::Playing );
+    trayItem.setToolTip( lastStation.name );
+}
+
 void Application::onPlayerBuffering( int state )
 {
-    trayItem.showMessage( tr( "QRadioTray" ), tr( "Buffering: %1\%..." ).arg( state ),
-                          QSystemTrayIcon::Information );
-    trayItem.setToolTip( tr( "Stream buffering." ) );
+    trayAnimator.setBufferLevel( state );
+    if ( state < 100 )
+        trayAnimator.setState( TrayAnimator::Buffering );
+    else if ( player.isPlaying() )
+        trayAnimator.setState( TrayAnimator::Playing );
+    trayItem.setToolTip( tr( "Stream buffering: %1\%." ).arg( state ) );
+
+    // One balloon per buffering run, progress is shown by icon and tooltip.
+    if ( state >= 100 )
+        bufferingShown = false;
+    else if ( !bufferingShown )
+    {
+        bufferingShown = true;
+        trayItem.showMessage( tr( "QRadioTray" ), tr( "Buffering..." ), QSystemTrayIcon::Information );
+    }
 }
 
 void Application::onPlayerVolumeChanged( int volume )
@@ -378,24 +822,89 @@ void Application::onPlayerVolumeChanged( int volume )
                           QSystemTrayIcon::Information );
 }
 
-void Application::onMetaDataChange( const QMultiMap< QString, QString > & data )
+void Application::onTrackChange( const QString & text )
+{
+    TRACE_SCOPE( "Application::onTrackChange" );
+    if ( text.isEmpty() )
+        return;
+
+    currentTrack = text;
+    trayItem.showMessage( tr( "QRadioTray" ), text, QSystemTrayIcon::Information );
+    trayItem.setToolTip( text );
+}
+
+void Application::toggleLevelMeter()
 {
-    QString metaInfo;
-    foreach ( const QString & key, data.keys() )
+    // Switched off meter has no audio tap and no worker thread.
+    const bool enabled = meterAction && meterAction->isChecked();
+    levelMeter.setEnabled( enabled );
+    player.setLevelMeter( enabled ? &levelMeter : 0 );
+    if ( !enabled )
+        trayAnimator.setLevels( QVector< int >() );
+}
+
+void Application::onLevelsUpdated()
+{
+    // Late update from stopped meter has no bands and restores animation.
+    trayAnimator.setLevels( levelMeter.levels().bands );
+}
+
+void Application::toggleRecording()
+{
+    if ( recorder.isRecording() )
     {
-        if ( ( ( key == "ARTIST" ) || ( key == "ALBUM" ) || ( key == "TITLE" ) ) &&
-             ( data.value( key ) != "" ) )
+        recorder.stop();
+        player.setCapture( false );
+        if ( recordAction )
         {
-            QTextCodec * codec = QTextCodec::codecForName( lastStation.encoding.toAscii() );
-            if ( codec )
-                metaInfo += QString( "%1:\r\n%2\r\n\r\n" )
-                            .arg( key )
-                            .arg( codec->toUnicode( data.value( key ).toAscii() ) );
+            recordAction->setChecked( false );
+            recordAction->setText( tr( "Record" ) );
         }
+        trayItem.showMessage( tr( "QRadioTray" ), tr( "Recording stopped." ), QSystemTrayIcon::Information );
+        return;
+    }
+
+    // Type is known if own stream runs already, else it comes with stream start.
+    recorder.setEncoding( lastStation.encoding );
+    recorder.setContentType( player.streamType() );
+    recorder.start( lastStation.name );
+    player.setCapture( true );
+    if ( recordAction )
+        recordAction->setChecked( true );
+    trayItem.showMessage( tr( "QRadioTray" ), tr( "Recording started." ), QSystemTrayIcon::Information );
+}
+
+void Application::onRecorderStats( qint64 written, int backlog, int diskRate )
+{
+    if ( recordAction && recorder.isRecording() )
+        recordAction->setText( tr( "Record ( %1 MB written, %2 KB waiting, disk %3 MB/s )" )
+                               .arg( written / 1048576.0, 0, 'f', 1 ).arg( backlog / 1024 )
+                               .arg( diskRate / 1048576.0, 0, 'f', 1 ) );
+}
+
+void Application::onRecorderFailed( const QString & reason )
+{
+    player.setCapture( false );
+    if ( recordAction )
+    {
+        recordAction->setChecked( false );
+        recordAction->setText( tr( "Record" ) );
     }
-    metaInfo = metaInfo.trimmed();
-    trayItem.showMessage( tr( "QRadioTray" ), metaInfo, QSystemTrayIcon::Information );
-    trayItem.setToolTip( metaInfo );
+    trayItem.showMessage( tr( "QRadioTray" ), tr( "Recording failed: %1" ).arg( reason ),
+                          QSystemTrayIcon::Critical );
+}
+
+void Application::onPlayerTimeshift( int delay )
+{
+    if ( delay <= 0 )
+    {
+        trayItem.setToolTip( lastStation.name );
+        return;
+    }
+
+    const int seconds = delay / 1000;
+    trayItem.setToolTip( tr( "%1: %2:%3 behind live." ).arg( lastStation.name ).arg( seconds / 60 )
+                         .arg( seconds % 60, 2, 10, QChar( '0' ) ) );
 }
 
 void Application::processTrayActivation( QSystemTrayIcon::ActivationReason activationReason )
@@ -8,10 +8,25 @@
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QMultiMap>
+#include <QHash>
+#include <QElapsedTimer>
 
-#include "settingsdialog.h"
 #include "station.h"
+#include "stationcatalog.h"
 #include "player.h"
+#include "stationprober.h"
+#include "stationimporter.h"
+#include "stationsmenu.h"
+#include "trayanimator.h"
+#include "metadatafilter.h"
+#include "recorder.h"
+#include "hostresolver.h"
+#include "stationmonitor.h"
+#include "controlserver.h"
+#include "levelmeter.h"
+
+class QProgressDialog;
+class SettingsDialog;
 
 class Application : public QApplication
 {
@@ -21,43 +36,96 @@ class Application : public QApplication
         explicit Application( int & argc, char ** argv );
         ~Application();
 
+        // Take single instance role and open control socket, false if
+        // another instance runs.
+        bool claimInstance();
         bool loadSettings();
         void storeSettings();
         bool configure();
+        // Timer started at process start, for startup report.
+        void setStartupTimer( const QElapsedTimer & timer );
 
     private slots:
         void onPlayerPlay();
+        void onPlayerAudioStarted();
         void onPlayerPause();
         void onPlayerStop();
         void onPlayerError();
+        void onPlayerReconnecting( int attempt, int delay );
+        void onPlayerReconnected( int attempts, int outage );
         void onPlayerBuffering( int state );
         void onPlayerVolumeChanged( int volume );
-        void onMetaDataChange( const QMultiMap< QString, QString > & data );
-        void processStationAction( QAction * action );
-        void animateIcon( quint64 tick );
+        void onTrackChange( const QString & text );
+        // Start or stop stream recording.
+        void toggleRecording();
+        void onRecorderStats( qint64 written, int backlog, int diskRate );
+        void onRecorderFailed( const QString & reason );
+        void onPlayerTimeshift( int delay );
+        // Start or stop level meter in tray.
+        void toggleLevelMeter();
+        void onLevelsUpdated();
+        void processStationAction( quint32 id );
+        // Connect to host of highlighted station ahead.
+        void onStationHovered( quint32 id );
+        // Mark stations of url in menu.
+        void onStationHealth( const QString & url, StationMonitor::Health health );
+        // Request of control client.
+        void onControlCommand( const QString & command, const QString & argument, QString * reply );
+        void importStations();
+        void exportStations();
+        void onImportProgress( int done, int total );
+        void onImportFinished( const QList< Station > & stations, int rejected );
+        void cancelImport();
         void about();
         void manageSettings();
         void updateStationsMenu();
         void processTrayActivation( QSystemTrayIcon::ActivationReason actvationReason );
 
     private:
-        SettingsDialog settingsDialog;
+        // Log startup milestone time.
+        void reportStartup( const QString & milestone );
+
+        // Created on first use.
+        SettingsDialog * settingsDialog;
+        StationCatalog catalog;
         QSystemTrayIcon trayItem;
         QMenu trayMenu;
         QMenu settingsMenu;
-        QStringList trayIconList;
-        int currTrayIcon;
-        QMenu stationsMenu;
+        TrayAnimator trayAnimator;
+        StationsMenu stationsMenu;
+        HostResolver resolver;
         Player player;
+        MetaDataFilter metaDataFilter;
+        Recorder recorder;
+        LevelMeter levelMeter;
+        QAction * recordAction;
+        QAction * meterAction;
+        StationProber prober;
+        StationMonitor monitor;
+        ControlServer control;
+        StationImporter importer;
+        QProgressDialog * importProgress;
+        // Load backend after tray is shown.
+        bool fastStart;
+        // Level meter is on at start.
+        bool meterEnabled;
+        QElapsedTimer startupTimer;
+        bool firstAudio;
+        // Buffering balloon is shown for current buffering run.
+        bool bufferingShown;
         QList< Station > stationList;
+        // Times station was selected ( this session ).
+        QHash< quint32, int > playCounts;
         Station lastStation;
-        QActionGroup * stationsGroup;
+        // Track info of current station ( for status requests ).
+        QString currentTrack;
 
         QString stopHotkey;
         QString pauseHotkey;
         QString volumeUpHotkey;
         QString volumeDownHotkey;
         QString quitHotkey;
+        QString recordHotkey;
 };
 
 #endif
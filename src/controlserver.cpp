@@ -0,0 +1,241 @@
+//
+// Control server: single instance guard and local socket control API.
+//
+#include "controlserver.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QDir>
+#include <QFile>
+#include <QLocalSocket>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Wait for running instance ( msec ).
+#define CONTROL_TIMEOUT 2000
+// Longest request line ( bytes ), longer ones are rejected.
+#define CONTROL_MAX_LINE 1024
+
+ControlServer::ControlServer( QObject * parent )
+    :QObject( parent ),
+     lockHandle( -1 )
+{
+    connect( &server, SIGNAL( newConnection() ), SLOT( onNewConnection() ) );
+}
+
+ControlServer::~ControlServer()
+{
+    server.close();
+    if ( lockHandle >= 0 )
+    {
+#ifdef Q_OS_WIN
+        CloseHandle( reinterpret_cast< HANDLE >( quintptr( lockHandle ) ) );
+#else
+        ::close( int( lockHandle ) );
+#endif
+    }
+}
+
+bool ControlServer::listen()
+{
+    TRACE_SCOPE( "ControlServer::listen" );
+    const QString name = serverName();
+
+    // Lock holder is the running instance ( or one still starting ).
+    if ( !lockInstance() )
+        return false;
+
+    // Socket file may be left by crashed instance.
+    QLocalServer::removeServer( name );
+    if ( !server.listen( name ) )
+    {
+        // Player works without remote control.
+        LOG_ERROR( "control", tr( "Can't listen on %1: %2" ).arg( name ).arg( server.errorString() ) );
+        return true;
+    }
+
+    LOG_INFO( "control", tr( "Control socket %1 is ready." ).arg( server.fullServerName() ) );
+    return true;
+}
+
+QStringList ControlServer::commandsFromArguments( int argc, char ** argv )
+{
+    QStringList commands;
+    for ( int i = 1; i < argc; ++i )
+    {
+        const QString word = QString::fromLocal8Bit( argv[ i ] );
+        if ( word == "--trace" )
+        {
+            ++i;
+            continue;
+        }
+
+        const QString command = word.toUpper();
+        if ( ( command == "PLAY" ) || ( command == "PAUSE" ) || ( command == "STOP" ) || ( command == "STATUS" ) )
+            commands.append( command );
+        else if ( ( command == "STATION" ) || ( command == "VOLUME" ) )
+        {
+            QString request = command;
+            if ( i + 1 < argc )
+                request += " " + QString::fromLocal8Bit( argv[ ++i ] );
+            commands.append( request );
+        }
+    }
+    return commands;
+}
+
+int ControlServer::send( const QStringList & commands )
+{
+    QLocalSocket socket;
+    socket.connectToServer( serverName() );
+    if ( !socket.waitForConnected( CONTROL_TIMEOUT ) )
+    {
+        fprintf( stderr, "QRadioTray is not running.\n" );
+        return 2;
+    }
+
+    // Whole batch goes in one write, replies come in request order.
+    QByteArray request;
+    foreach ( const QString & command, commands )
+    {
+        QString line = command;
+        line.replace( '\n', ' ' );
+        request += line.toUtf8() + '\n';
+    }
+    socket.write( request );
+    socket.waitForBytesWritten( CONTROL_TIMEOUT );
+
+    int result = 0;
+    for ( int i = 0; i < commands.count(); ++i )
+    {
+        while ( !socket.canReadLine() )
+        {
+            if ( !socket.waitForReadyRead( CONTROL_TIMEOUT ) )
+            {
+                fprintf( stderr, "QRadioTray does not answer.\n" );
+                return 2;
+            }
+        }
+
+        const QByteArray reply = socket.readLine().trimmed();
+        if ( reply.startsWith( "ERR" ) )
+        {
+            fprintf( stderr, "%s: %s\n", commands[ i ].toLocal8Bit().constData(), reply.mid( 4 ).constData() );
+            result = 1;
+        }
+        else if ( reply.length() > 3 )
+            printf( "%s\n", reply.mid( 3 ).constData() );
+    }
+    return result;
+}
+
+void ControlServer::onNewConnection()
+{
+    while ( QLocalSocket * socket = server.nextPendingConnection() )
+    {
+        connect( socket, SIGNAL( readyRead() ), SLOT( onReadyRead() ) );
+        connect( socket, SIGNAL( disconnected() ), socket, SLOT( deleteLater() ) );
+    }
+}
+
+void ControlServer::onReadyRead()
+{
+    TRACE_SCOPE( "ControlServer::onReadyRead" );
+    QLocalSocket * socket = qobject_cast< QLocalSocket * >( sender() );
+    if ( !socket )
+        return;
+
+    QByteArray replies;
+    while ( socket->canReadLine() )
+    {
+        // Whole line is taken, so an over-long one is not split into requests.
+        const QByteArray request = socket->readLine();
+        if ( request.size() > CONTROL_MAX_LINE )
+        {
+            LOG_WARN( "control", tr( "Control request too long ( %1 bytes ), rejected." ).arg( request.size() ) );
+            replies += "ERR " + tr( "request too long" ).toUtf8() + '\n';
+            continue;
+        }
+
+        const QString line = QString::fromUtf8( request ).trimmed();
+        const int space = line.indexOf( ' ' );
+        const QString command = line.left( space ).toUpper();
+        const QString argument = ( space < 0 ) ? QString() : line.mid( space + 1 ).trimmed();
+
+        QString reply = "OK";
+        if ( command.isEmpty() )
+            reply = "ERR " + tr( "empty request" );
+        else
+            emit commandReceived( command, argument, &reply );
+        reply.replace( '\n', ' ' );
+        reply.replace( '\r', ' ' );
+        replies += reply.toUtf8() + '\n';
+    }
+
+    if ( !replies.isEmpty() )
+        socket->write( replies );
+
+    // Client not sending line ends is cut off.
+    if ( socket->bytesAvailable() > CONTROL_MAX_LINE )
+    {
+        LOG_WARN( "control", tr( "Control request too long, connection closed." ) );
+        socket->abort();
+    }
+}
+
+bool ControlServer::lockInstance()
+{
+    const QString fileName = QDir::temp().filePath( serverName() + ".lock" );
+#ifdef Q_OS_WIN
+    // File opened without sharing can't be opened by another process.
+    const HANDLE handle = CreateFileW( reinterpret_cast< const wchar_t * >( fileName.utf16() ),
+                                       GENERIC_WRITE, 0, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0 );
+    if ( handle != INVALID_HANDLE_VALUE )
+    {
+        lockHandle = qint64( reinterpret_cast< quintptr >( handle ) );
+        return true;
+    }
+    if ( GetLastError() == ERROR_SHARING_VIOLATION )
+        return false;
+#else
+    // Record lock is dropped by the system when process ends.
+    const int fd = open( QFile::encodeName( fileName ).constData(), O_RDWR | O_CREAT, 0600 );
+    if ( fd >= 0 )
+    {
+        struct flock region;
+        memset( &region, 0, sizeof( region ) );
+        region.l_type = F_WRLCK;
+        region.l_whence = SEEK_SET;
+        if ( fcntl( fd, F_SETLK, &region ) == 0 )
+        {
+            lockHandle = fd;
+            return true;
+        }
+        ::close( fd );
+        return false;
+    }
+#endif
+
+    // Can't lock: fall back to asking the socket.
+    LOG_WARN( "control", tr( "Can't create lock file %1." ).arg( fileName ) );
+    QLocalSocket running;
+    running.connectToServer( serverName() );
+    return !running.waitForConnected( CONTROL_TIMEOUT );
+}
+
+QString ControlServer::serverName()
+{
+    QString user = QString::fromLocal8Bit( getenv( "USER" ) );
+    if ( user.isEmpty() )
+        user = QString::fromLocal8Bit( getenv( "USERNAME" ) );
+    return "qradiotray-" + user;
+}
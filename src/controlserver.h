@@ -0,0 +1,65 @@
+//
+// Control server: single instance guard and local socket control API.
+//
+// First instance takes per-user lock file and listens on per-user local
+// socket, later starts find the lock taken and exit. Lock is held by the
+// system for the process, so a crashed instance leaves no stale lock.
+// Only lock holder removes socket file left by a crashed instance. Protocol is line based ( UTF-8 ), client may send
+// any number of requests without waiting, each gets one reply line in
+// request order:
+//
+//   PLAY | PAUSE | STOP           -> OK
+//   STATION <id or name>          -> OK | ERR <reason>
+//   VOLUME <0-100 | +N | -N>      -> OK | ERR <reason>
+//   STATUS                        -> OK <state> <volume> <id> <name> <track>
+//
+// Status fields are separated by tabs. Command line client sends commands
+// given as arguments ( "qradiotray station Jazz status" ) without starting
+// GUI or audio backend.
+//
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QLocalServer>
+
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit ControlServer( QObject * parent = 0 );
+        ~ControlServer();
+
+        // Become the running instance, false if another one answers.
+        bool listen();
+
+        // Control commands in command line ( empty if none ).
+        static QStringList commandsFromArguments( int argc, char ** argv );
+        // Send commands to running instance and print replies, returns
+        // exit code: 0 - done, 1 - command failed, 2 - no running instance.
+        static int send( const QStringList & commands );
+
+    signals:
+        // Request of client, reply is "OK" unless handler changes it.
+        void commandReceived( const QString & command, const QString & argument, QString * reply );
+
+    private slots:
+        void onNewConnection();
+        // Answer all complete requests at once.
+        void onReadyRead();
+
+    private:
+        // Per-user socket name.
+        static QString serverName();
+        // Take instance lock, false if another instance holds it.
+        bool lockInstance();
+
+        QLocalServer server;
+        // Lock file descriptor ( handle on Windows ), -1 - not locked.
+        qint64 lockHandle;
+};
+
+#endif
@@ -0,0 +1,263 @@
+//
+// Host resolver: address cache and early connections for station hosts.
+//
+#include "hostresolver.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QUrl>
+#include <QSet>
+#include <QStringList>
+#include <QHostInfo>
+#include <QTcpSocket>
+
+// Lookups running at once.
+#define MAX_LOOKUPS 6
+// Cache check interval ( msec ).
+#define REFRESH_INTERVAL 5000
+// Entries are looked up again this long before expiry, failed ones after it ( msec ).
+#define REFRESH_AHEAD 30000
+// Unused early connection is closed after ( msec ), servers drop idle clients.
+#define PRECONNECT_LIFETIME 10000
+
+HostResolver::HostResolver( QObject * parent )
+    :QObject( parent ),
+     lifetime( 300000 ),
+     preconnectLimit( 2 )
+{
+    clock.start();
+    refreshTimer.setInterval( REFRESH_INTERVAL );
+    connect( &refreshTimer, SIGNAL( timeout() ), SLOT( refresh() ) );
+}
+
+HostResolver::~HostResolver()
+{
+    foreach ( int id, lookups.keys() )
+        QHostInfo::abortHostLookup( id );
+}
+
+void HostResolver::setLifetime( int msec )
+{
+    lifetime = qMax( REFRESH_AHEAD, msec );
+}
+
+void HostResolver::setPreconnectLimit( int count )
+{
+    preconnectLimit = qMax( 0, count );
+    while ( connections.count() > preconnectLimit )
+        closeConnection( 0 );
+}
+
+void HostResolver::prefetch( const QList< Station > & stations )
+{
+    TRACE_SCOPE( "HostResolver::prefetch" );
+    QSet< QString > used;
+    foreach ( const Station & station, stations )
+    {
+        const QString host = QUrl( station.url ).host().toLower();
+        if ( !host.isEmpty() )
+            used.insert( host );
+    }
+
+    foreach ( const QString & host, hosts.keys() )
+    {
+        if ( !used.contains( host ) )
+            hosts.remove( host );
+    }
+
+    const qint64 now = clock.elapsed();
+    foreach ( const QString & host, used )
+    {
+        QHash< QString, Entry >::const_iterator it = hosts.constFind( host );
+        if ( ( it == hosts.constEnd() ) || ( it.value().expires <= now ) )
+            lookup( host );
+    }
+
+    if ( !hosts.isEmpty() )
+        refreshTimer.start();
+    else
+        refreshTimer.stop();
+}
+
+QHostAddress HostResolver::address( const QString & host ) const
+{
+    QHash< QString, Entry >::const_iterator it = hosts.constFind( host.toLower() );
+    if ( ( it == hosts.constEnd() ) || it.value().addresses.isEmpty() || ( it.value().expires <= clock.elapsed() ) )
+        return QHostAddress();
+
+    return it.value().addresses.first();
+}
+
+void HostResolver::preconnect( const QUrl & url )
+{
+    const QString host = url.host().toLower();
+    const quint16 port = quint16( url.port( 80 ) );
+    if ( ( preconnectLimit <= 0 ) || host.isEmpty() )
+        return;
+
+    foreach ( const Connection & connection, connections )
+    {
+        if ( ( connection.host == host ) && ( connection.port == port ) )
+            return;
+    }
+
+    // Oldest early connection makes room.
+    if ( connections.count() >= preconnectLimit )
+        closeConnection( 0 );
+
+    Connection connection;
+    connection.socket = new QTcpSocket( this );
+    connection.host = host;
+    connection.port = port;
+    connection.age.start();
+    connect( connection.socket, SIGNAL( connected() ), SLOT( onPreconnected() ) );
+    connections.append( connection );
+
+    const QHostAddress cached = address( host );
+    if ( cached.isNull() )
+        connection.socket->connectToHost( host, port );
+    else
+        connection.socket->connectToHost( cached, port );
+    refreshTimer.start();
+    LOG_DEBUG( "resolver", tr( "Connecting to %1:%2 ahead." ).arg( host ).arg( port ) );
+}
+
+QTcpSocket * HostResolver::takeConnection( const QString & host, quint16 port )
+{
+    for ( int i = 0; i < connections.count(); ++i )
+    {
+        const Connection & connection = connections[ i ];
+        if ( ( connection.host != host.toLower() ) || ( connection.port != port ) ||
+             ( connection.socket->state() != QAbstractSocket::ConnectedState ) )
+            continue;
+
+        QTcpSocket * socket = connection.socket;
+        connections.removeAt( i );
+        socket->disconnect( this );
+        socket->setParent( 0 );
+        LOG_DEBUG( "resolver", tr( "Connection to %1:%2 taken over." ).arg( host ).arg( port ) );
+        return socket;
+    }
+
+    return 0;
+}
+
+void HostResolver::reportConnect( const QString & host, int msec )
+{
+    QHash< QString, Entry >::iterator it = hosts.find( host.toLower() );
+    if ( it != hosts.end() )
+        it.value().connectTime = msec;
+    TRACE_COUNTER( "connect time", msec );
+    LOG_INFO( "resolver", tr( "Connected to %1 in %2 msec." ).arg( host ).arg( msec ) );
+}
+
+int HostResolver::lookupTime( const QString & host ) const
+{
+    return hosts.value( host.toLower() ).lookupTime;
+}
+
+int HostResolver::connectTime( const QString & host ) const
+{
+    return hosts.value( host.toLower() ).connectTime;
+}
+
+void HostResolver::startLookups()
+{
+    while ( ( lookups.count() < MAX_LOOKUPS ) && !waiting.isEmpty() )
+    {
+        const QString host = waiting.dequeue();
+        if ( !hosts.contains( host ) )
+            continue;
+
+        const int id = QHostInfo::lookupHost( host, this, SLOT( onLookup( const QHostInfo & ) ) );
+        lookups.insert( id, host );
+        lookupStart.insert( id, clock.elapsed() );
+    }
+}
+
+void HostResolver::onLookup( const QHostInfo & info )
+{
+    TRACE_SCOPE( "HostResolver::onLookup" );
+    const QString host = lookups.take( info.lookupId() );
+    const int msec = int( clock.elapsed() - lookupStart.take( info.lookupId() ) );
+
+    QHash< QString, Entry >::iterator it = hosts.find( host );
+    if ( it != hosts.end() )
+    {
+        Entry & entry = it.value();
+        entry.pending = false;
+        entry.lookupTime = msec;
+        if ( ( info.error() == QHostInfo::NoError ) && !info.addresses().isEmpty() )
+        {
+            entry.addresses = info.addresses();
+            entry.expires = clock.elapsed() + lifetime;
+            entry.retry = entry.expires - REFRESH_AHEAD;
+            LOG_INFO( "resolver", tr( "Host %1 resolved in %2 msec ( %3 addresses )." )
+                                  .arg( host ).arg( msec ).arg( entry.addresses.count() ) );
+        }
+        else
+        {
+            // Old addresses stay usable until they expire.
+            entry.retry = clock.elapsed() + REFRESH_AHEAD;
+            LOG_WARN( "resolver", tr( "Host %1 not resolved in %2 msec: %3" )
+                                  .arg( host ).arg( msec ).arg( info.errorString() ) );
+        }
+        emit resolved( host, msec );
+    }
+
+    startLookups();
+}
+
+void HostResolver::refresh()
+{
+    TRACE_SCOPE( "HostResolver::refresh" );
+    const qint64 now = clock.elapsed();
+    QStringList due;
+    QHash< QString, Entry >::const_iterator it = hosts.constBegin();
+    for ( ; it != hosts.constEnd(); ++it )
+    {
+        if ( !it.value().pending && ( it.value().retry <= now ) )
+            due.append( it.key() );
+    }
+    foreach ( const QString & host, due )
+        lookup( host );
+
+    for ( int i = connections.count() - 1; i >= 0; --i )
+    {
+        const QAbstractSocket::SocketState state = connections[ i ].socket->state();
+        if ( ( connections[ i ].age.elapsed() > PRECONNECT_LIFETIME ) ||
+             ( state == QAbstractSocket::UnconnectedState ) )
+            closeConnection( i );
+    }
+}
+
+void HostResolver::onPreconnected()
+{
+    foreach ( const Connection & connection, connections )
+    {
+        if ( connection.socket == sender() )
+            reportConnect( connection.host, int( connection.age.elapsed() ) );
+    }
+}
+
+void HostResolver::lookup( const QString & host )
+{
+    Entry & entry = hosts[ host ];
+    if ( entry.pending )
+        return;
+
+    entry.pending = true;
+    waiting.enqueue( host );
+    startLookups();
+}
+
+void HostResolver::closeConnection( int index )
+{
+    if ( ( index < 0 ) || ( index >= connections.count() ) )
+        return;
+
+    QTcpSocket * socket = connections.takeAt( index ).socket;
+    socket->disconnect( this );
+    socket->abort();
+    socket->deleteLater();
+}
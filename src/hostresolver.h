@@ -0,0 +1,108 @@
+//
+// Host resolver: address cache and early connections for station hosts.
+//
+// Hosts of all stations are looked up in background ( several at once ) and
+// kept for cache lifetime, entries are looked up again shortly before they
+// expire. Stream clients connect to cached address, skipping DNS. Hosts of
+// stations about to be played can be connected ahead, such connection is
+// handed to the stream client or closed when unused for a few seconds.
+//
+#ifndef HOST_RESOLVER_H
+#define HOST_RESOLVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHostAddress>
+
+#include "station.h"
+
+class QUrl;
+class QHostInfo;
+class QTcpSocket;
+
+class HostResolver : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit HostResolver( QObject * parent = 0 );
+        ~HostResolver();
+
+        // Cache lifetime of lookup result ( msec ).
+        void setLifetime( int msec );
+        // Maximum connections opened ahead ( 0 - none ).
+        void setPreconnectLimit( int count );
+
+        // Look up hosts of stations, hosts no longer used are forgotten.
+        void prefetch( const QList< Station > & stations );
+        // Cached address of host ( null if unknown or expired ).
+        QHostAddress address( const QString & host ) const;
+        // Open connection to host of url ahead of use.
+        void preconnect( const QUrl & url );
+        // Take connection opened ahead ( 0 if none ), caller becomes owner.
+        QTcpSocket * takeConnection( const QString & host, quint16 port );
+        // Connect latency measured by client.
+        void reportConnect( const QString & host, int msec );
+
+        // Last latencies of host ( msec, -1 - not measured ).
+        int lookupTime( const QString & host ) const;
+        int connectTime( const QString & host ) const;
+
+    signals:
+        // Lookup finished ( addresses may be empty on failure ).
+        void resolved( const QString & host, int msec );
+
+    private slots:
+        // Start waiting lookups while below concurrency limit.
+        void startLookups();
+        void onLookup( const QHostInfo & info );
+        // Look up entries about to expire, close stale connections.
+        void refresh();
+        void onPreconnected();
+
+    private:
+        // Cached host.
+        struct Entry
+        {
+            Entry() : expires( 0 ), retry( 0 ), lookupTime( -1 ), connectTime( -1 ), pending( false ) {}
+
+            QList< QHostAddress > addresses;
+            // Expiry ( msec since clock start ).
+            qint64 expires;
+            // Next lookup time.
+            qint64 retry;
+            int lookupTime;
+            int connectTime;
+            bool pending;
+        };
+
+        // Connection opened ahead.
+        struct Connection
+        {
+            QTcpSocket * socket;
+            QString host;
+            quint16 port;
+            QElapsedTimer age;
+        };
+
+        // Queue lookup of host if not running already.
+        void lookup( const QString & host );
+        void closeConnection( int index );
+
+        QHash< QString, Entry > hosts;
+        QQueue< QString > waiting;
+        // Running lookups: id to host and start time.
+        QHash< int, QString > lookups;
+        QHash< int, qint64 > lookupStart;
+        QList< Connection > connections;
+        QElapsedTimer clock;
+        QTimer refreshTimer;
+        int lifetime;
+        int preconnectLimit;
+};
+
+#endif
@@ -0,0 +1,492 @@
+//
+// ICY client: HTTP / Icecast / Shoutcast stream reader.
+//
+#include "icyclient.h"
+#include "streambuffer.h"
+#include "hostresolver.h"
+#include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
+
+#include <QTcpSocket>
+#include <QList>
+
+// Maximum redirects followed.
+#define MAX_REDIRECTS 5
+// Maximum size of response head.
+#define MAX_HEAD_SIZE 16384
+// Delivery interval of delayed data ( msec ).
+#define FAULT_TICK 20
+// Data held back by faults, more is left to TCP flow control ( bytes ).
+#define FAULT_QUEUE_LIMIT 65536
+
+IcyClient::IcyClient( StreamBuffer * streamBuffer, QObject * parent )
+    :QObject( parent ),
+     socket( 0 ),
+     buffer( streamBuffer ),
+     resolver( 0 ),
+     redirects( 0 ),
+     streaming( false ),
+     refused( false ),
+     code( 0 ),
+     kbps( 0 ),
+     interval( 0 ),
+     audioLeft( 0 ),
+     metaLeft( -1 ),
+     received( 0 ),
+     faulty( false ),
+     delayedBytes( 0 ),
+     serverClosed( false ),
+     allowance( 0 ),
+     lastDelivery( 0 ),
+     connectedAt( 0 )
+{
+    attach( new QTcpSocket( this ) );
+    faultClock.start();
+    faultTimer.setInterval( FAULT_TICK );
+    connect( &faultTimer, SIGNAL( timeout() ), SLOT( deliverDelayed() ) );
+}
+
+void IcyClient::setFaults( const Faults & simulated )
+{
+    faults = simulated;
+    faulty = ( faults.latency > 0 ) || ( faults.bandwidth > 0 ) ||
+             ( ( faults.stallEvery > 0 ) && ( faults.stallLength > 0 ) ) || ( faults.dropAfter > 0 );
+    if ( faulty )
+        LOG_WARN( "icy", tr( "Simulated faults: latency %1 msec, bandwidth %2 kbit/s, stall %3 of %4 msec, "
+                             "drop after %5 msec." ).arg( faults.latency ).arg( faults.bandwidth )
+                             .arg( faults.stallLength ).arg( faults.stallEvery ).arg( faults.dropAfter ) );
+
+    socket->setReadBufferSize( faulty ? FAULT_QUEUE_LIMIT : 0 );
+    if ( !isOpen() )
+        return;
+
+    if ( faulty )
+    {
+        if ( !faultTimer.isActive() )
+        {
+            connectedAt = lastDelivery = faultClock.elapsed();
+            allowance = 0;
+            faultTimer.start();
+        }
+        return;
+    }
+
+    // Faults are off: data held back goes on in order, then socket is read.
+    faultTimer.stop();
+    while ( !delayed.isEmpty() )
+        process( delayed.dequeue().second );
+    delayedBytes = 0;
+    const bool closed = serverClosed;
+    serverClosed = false;
+    if ( socket->bytesAvailable() )
+        onReadyRead();
+    if ( closed )
+        onDisconnected();
+}
+
+void IcyClient::open( const QUrl & streamUrl )
+{
+    redirects = 0;
+    connectTo( streamUrl );
+}
+
+void IcyClient::close()
+{
+    streaming = false;
+    faultTimer.stop();
+    delayed.clear();
+    delayedBytes = 0;
+    serverClosed = false;
+    socket->blockSignals( true );
+    socket->abort();
+    socket->blockSignals( false );
+}
+
+void IcyClient::setResolver( HostResolver * hostResolver )
+{
+    resolver = hostResolver;
+}
+
+void IcyClient::setBuffer( StreamBuffer * streamBuffer )
+{
+    buffer = streamBuffer;
+}
+
+bool IcyClient::isOpen() const
+{
+    return socket->state() != QAbstractSocket::UnconnectedState;
+}
+
+bool IcyClient::isStreaming() const
+{
+    return streaming;
+}
+
+bool IcyClient::isRefused() const
+{
+    return refused;
+}
+
+int IcyClient::statusCode() const
+{
+    return code;
+}
+
+QByteArray IcyClient::contentType() const
+{
+    return type;
+}
+
+QByteArray IcyClient::stationName() const
+{
+    return name;
+}
+
+int IcyClient::bitrate() const
+{
+    return kbps;
+}
+
+int IcyClient::metaInterval() const
+{
+    return interval;
+}
+
+qint64 IcyClient::bytesReceived() const
+{
+    return received;
+}
+
+void IcyClient::connectTo( const QUrl & target )
+{
+    url = target;
+    head.clear();
+    streaming = false;
+    refused = false;
+    code = 0;
+    type.clear();
+    name.clear();
+    kbps = 0;
+    interval = 0;
+    metaLeft = -1;
+    metaBlock.clear();
+
+    close();
+    LOG_INFO( "icy", tr( "Connecting to %1." ).arg( url.toString() ) );
+    connectTimer.start();
+    if ( faulty )
+    {
+        connectedAt = lastDelivery = faultClock.elapsed();
+        allowance = 0;
+        faultTimer.start();
+    }
+    const quint16 port = quint16( url.port( 80 ) );
+    if ( resolver )
+    {
+        // Connection opened ahead skips DNS and handshake.
+        QTcpSocket * ready = resolver->takeConnection( url.host(), port );
+        if ( ready )
+        {
+            socket->disconnect( this );
+            socket->deleteLater();
+            attach( ready );
+            onConnected();
+            return;
+        }
+
+        const QHostAddress address = resolver->address( url.host() );
+        if ( !address.isNull() )
+        {
+            socket->connectToHost( address, port );
+            return;
+        }
+    }
+    socket->connectToHost( url.host(), port );
+}
+
+void IcyClient::attach( QTcpSocket * connection )
+{
+    socket = connection;
+    socket->setParent( this );
+    // Unread data must stay in kernel, so the server is slowed down.
+    socket->setReadBufferSize( faulty ? FAULT_QUEUE_LIMIT : 0 );
+    connect( socket, SIGNAL( connected() ), SLOT( onConnected() ) );
+    connect( socket, SIGNAL( readyRead() ), SLOT( onReadyRead() ) );
+    connect( socket, SIGNAL( disconnected() ), SLOT( onDisconnected() ) );
+    connect( socket, SIGNAL( error( QAbstractSocket::SocketError ) ),
+                     SLOT( onError( QAbstractSocket::SocketError ) ) );
+}
+
+void IcyClient::onConnected()
+{
+    if ( resolver )
+        resolver->reportConnect( url.host(), int( connectTimer.elapsed() ) );
+
+    QByteArray path = url.toEncoded( QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment );
+    if ( path.isEmpty() )
+        path = "/";
+
+    QByteArray host = url.toEncoded( QUrl::RemoveScheme | QUrl::RemoveUserInfo | QUrl::RemovePath |
+                                     QUrl::RemoveQuery | QUrl::RemoveFragment );
+    while ( host.startsWith( '/' ) )
+        host.remove( 0, 1 );
+
+    QByteArray request;
+    request += "GET " + path + " HTTP/1.0\r\n";
+    request += "Host: " + host + "\r\n";
+    request += "User-Agent: QRadioTray\r\n";
+    request += "Accept: */*\r\n";
+    request += "Icy-MetaData: 1\r\n";
+    request += "Connection: close\r\n\r\n";
+    socket->write( request );
+}
+
+void IcyClient::onReadyRead()
+{
+    TRACE_SCOPE( "IcyClient::onReadyRead" );
+    if ( faulty && ( delayedBytes >= FAULT_QUEUE_LIMIT ) )
+        return;
+
+    const QByteArray data = socket->readAll();
+    METRIC_ADD( StreamBytes, data.size() );
+    if ( faulty )
+    {
+        delayed.enqueue( qMakePair( faultClock.elapsed() + faults.latency, data ) );
+        delayedBytes += data.size();
+        return;
+    }
+    process( data );
+}
+
+void IcyClient::deliverDelayed()
+{
+    const qint64 now = faultClock.elapsed();
+    if ( ( faults.dropAfter > 0 ) && ( now - connectedAt >= faults.dropAfter ) )
+    {
+        fail( tr( "Simulated disconnect." ) );
+        return;
+    }
+
+    const qint64 elapsed = now - lastDelivery;
+    lastDelivery = now;
+    if ( ( faults.stallEvery > 0 ) && ( now % faults.stallEvery < faults.stallLength ) )
+        return;
+
+    // Token bucket, at most two ticks of data saved up.
+    if ( faults.bandwidth > 0 )
+    {
+        const qint64 rate = qint64( faults.bandwidth ) * 125;
+        allowance = qMin( allowance + rate * elapsed / 1000, rate * FAULT_TICK * 2 / 1000 );
+    }
+
+    while ( !delayed.isEmpty() && ( delayed.head().first <= now ) )
+    {
+        QByteArray data = delayed.head().second;
+        if ( faults.bandwidth > 0 )
+        {
+            if ( allowance <= 0 )
+                break;
+            if ( data.size() > allowance )
+            {
+                delayed.head().second = data.mid( int( allowance ) );
+                data.truncate( int( allowance ) );
+            }
+            else
+                delayed.dequeue();
+            allowance -= data.size();
+        }
+        else
+            delayed.dequeue();
+
+        delayedBytes -= data.size();
+        process( data );
+        // Processing may close or redirect the stream.
+        if ( !faultTimer.isActive() )
+            return;
+    }
+
+    // Data left in socket while queue was full.
+    if ( ( delayedBytes < FAULT_QUEUE_LIMIT ) && socket->bytesAvailable() )
+        onReadyRead();
+    else if ( serverClosed && delayed.isEmpty() )
+        onDisconnected();
+}
+
+void IcyClient::process( const QByteArray & data )
+{
+    if ( streaming )
+    {
+        demux( data, 0 );
+        return;
+    }
+
+    head += data;
+    int end = head.indexOf( "\r\n\r\n" );
+    int separator = 4;
+    if ( end < 0 )
+    {
+        end = head.indexOf( "\n\n" );
+        separator = 2;
+    }
+    if ( end < 0 )
+    {
+        if ( head.size() > MAX_HEAD_SIZE )
+            fail( tr( "Response head is too long." ) );
+        return;
+    }
+
+    // Body part of this read stays in the same array.
+    const QByteArray response = head;
+    head.clear();
+    if ( parseHead( response.left( end ) ) )
+        demux( response, end + separator );
+}
+
+void IcyClient::onDisconnected()
+{
+    // Data held back by faults is delivered first.
+    serverClosed = !delayed.isEmpty() || ( faultTimer.isActive() && socket->bytesAvailable() );
+    if ( serverClosed )
+        return;
+
+    if ( streaming )
+        fail( tr( "Server closed stream." ) );
+    else
+        fail( tr( "Server closed connection before response." ) );
+}
+
+void IcyClient::onError( QAbstractSocket::SocketError socketError )
+{
+    // Server closing is reported by onDisconnected.
+    if ( socketError != QAbstractSocket::RemoteHostClosedError )
+        fail( socket->errorString() );
+}
+
+bool IcyClient::parseHead( const QByteArray & response )
+{
+    const QList< QByteArray > lines = response.split( '\n' );
+    const QList< QByteArray > status = lines.value( 0 ).simplified().split( ' ' );
+    // "HTTP/1.x 200 OK" or Shoutcast "ICY 200 OK".
+    code = status.value( 1 ).toInt();
+
+    QByteArray location;
+    for ( int i = 1; i < lines.count(); ++i )
+    {
+        const int colon = lines[ i ].indexOf( ':' );
+        if ( colon <= 0 )
+            continue;
+
+        const QByteArray key = lines[ i ].left( colon ).trimmed().toLower();
+        const QByteArray value = lines[ i ].mid( colon + 1 ).trimmed();
+        if ( key == "content-type" )
+            type = value;
+        else if ( key == "icy-name" )
+            name = value;
+        else if ( key == "icy-br" )
+            kbps = value.split( ',' ).value( 0 ).toInt();
+        else if ( key == "icy-metaint" )
+            interval = value.toInt();
+        else if ( key == "location" )
+            location = value;
+    }
+
+    if ( ( code >= 300 ) && ( code < 400 ) && !location.isEmpty() )
+    {
+        if ( ++redirects > MAX_REDIRECTS )
+        {
+            fail( tr( "Too many redirects." ) );
+            return false;
+        }
+        connectTo( url.resolved( QUrl::fromEncoded( location ) ) );
+        return false;
+    }
+
+    if ( code != 200 )
+    {
+        refused = ( code >= 400 ) && ( code < 500 );
+        fail( tr( "Server answered \"%1\"." ).arg( QString::fromLatin1( lines.value( 0 ).trimmed() ) ) );
+        return false;
+    }
+
+    streaming = true;
+    audioLeft = interval;
+    metaLeft = -1;
+    LOG_INFO( "icy", tr( "Stream started: %1, %2 kbit/s, meta data every %3 bytes." )
+                     .arg( QString::fromLatin1( type ) ).arg( kbps ).arg( interval ) );
+    emit streamStarted();
+    return true;
+}
+
+void IcyClient::demux( const QByteArray & data, int offset )
+{
+    received += data.size() - offset;
+    int pos = offset;
+    while ( streaming && ( pos < data.size() ) )
+    {
+        if ( ( interval == 0 ) || ( audioLeft > 0 ) )
+        {
+            // Audio: reference to received array.
+            const int count = ( interval == 0 ) ? ( data.size() - pos ) : qMin( audioLeft, data.size() - pos );
+            if ( buffer )
+                buffer->append( data, pos, count );
+            emit audioReceived( data, pos, count );
+            pos += count;
+            if ( interval > 0 )
+                audioLeft -= count;
+        }
+        else if ( metaLeft < 0 )
+        {
+            metaLeft = quint8( data.at( pos++ ) ) * 16;
+            metaBlock.clear();
+            if ( metaLeft == 0 )
+            {
+                metaLeft = -1;
+                audioLeft = interval;
+            }
+        }
+        else
+        {
+            const int count = qMin( metaLeft, data.size() - pos );
+            metaBlock.append( data.constData() + pos, count );
+            pos += count;
+            metaLeft -= count;
+            if ( metaLeft == 0 )
+            {
+                parseMetaData( metaBlock );
+                metaLeft = -1;
+                audioLeft = interval;
+            }
+        }
+    }
+}
+
+void IcyClient::parseMetaData( const QByteArray & block )
+{
+    // StreamTitle='Artist - Title';StreamUrl='...';
+    const QByteArray key = "StreamTitle='";
+    const int start = block.indexOf( key );
+    if ( start < 0 )
+        return;
+
+    const int from = start + key.size();
+    int end = block.indexOf( "';", from );
+    if ( end < 0 )
+        end = block.lastIndexOf( '\'' );
+    if ( end < from )
+        return;
+
+    const QByteArray title = block.mid( from, end - from );
+    if ( title == lastTitle )
+        return;
+
+    lastTitle = title;
+    emit titleReceived( title );
+}
+
+void IcyClient::fail( const QString & reason )
+{
+    LOG_WARN( "icy", tr( "Stream %1: %2" ).arg( url.toString() ).arg( reason ) );
+    close();
+    emit failed( reason );
+}
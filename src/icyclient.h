@@ -0,0 +1,151 @@
+//
+// ICY client: HTTP / Icecast / Shoutcast stream reader.
+//
+// Asks server for interleaved meta data ( "Icy-MetaData: 1" ) and splits
+// the body: audio goes to stream buffer as references to received chunks,
+// meta data blocks are parsed and their raw bytes reported.
+//
+// For offline measurements received data can be delayed, throttled,
+// stalled and the connection cut ( simulated faults ), so reconnect and
+// buffering behaviour is reproducible against any stream. Faults belong to
+// the client and apply to its open connection as soon as they are set.
+//
+#ifndef ICY_CLIENT_H
+#define ICY_CLIENT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QByteArray>
+#include <QPair>
+#include <QQueue>
+#include <QTimer>
+#include <QAbstractSocket>
+#include <QElapsedTimer>
+
+class QTcpSocket;
+class StreamBuffer;
+class HostResolver;
+
+class IcyClient : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Simulated network trouble ( all zero - none ).
+        struct Faults
+        {
+            Faults() : latency( 0 ), bandwidth( 0 ), stallEvery( 0 ), stallLength( 0 ), dropAfter( 0 ) {}
+
+            // Delay of received data ( msec ).
+            int latency;
+            // Delivery cap ( kbit/s ).
+            int bandwidth;
+            // Delivery stops for stallLength at start of every stallEvery period ( msec ).
+            int stallEvery;
+            int stallLength;
+            // Connection is cut after this long ( msec ).
+            int dropAfter;
+        };
+
+        explicit IcyClient( StreamBuffer * streamBuffer, QObject * parent = 0 );
+
+        // Faults of this client ( open connection follows at once ).
+        void setFaults( const Faults & simulated );
+
+        // Connect and start reading ( redirects are followed ).
+        void open( const QUrl & streamUrl );
+        void close();
+        // Cached addresses and early connections ( 0 - plain connect ).
+        void setResolver( HostResolver * hostResolver );
+        // Buffer fed with audio ( 0 - audio is only reported ).
+        void setBuffer( StreamBuffer * streamBuffer );
+        // Connection is open or being opened.
+        bool isOpen() const;
+        // Headers are received, audio is flowing.
+        bool isStreaming() const;
+        // Server refused stream ( 4xx answer ), retry won't help.
+        bool isRefused() const;
+        // Status code of last response ( 0 - no response head yet ).
+        int statusCode() const;
+
+        // Stream properties from response headers.
+        QByteArray contentType() const;
+        QByteArray stationName() const;
+        // Bitrate ( kbit/s, 0 - unknown ).
+        int bitrate() const;
+        // Audio bytes between meta data blocks ( 0 - no meta data ).
+        int metaInterval() const;
+        // Body bytes received.
+        qint64 bytesReceived() const;
+
+    signals:
+        // Response accepted, audio follows.
+        void streamStarted();
+        // Audio part of received chunk ( shared with stream buffer ).
+        void audioReceived( const QByteArray & chunk, int offset, int length );
+        // New StreamTitle value ( raw bytes, encoding is station's ).
+        void titleReceived( const QByteArray & title );
+        // Connection failed or stream broke.
+        void failed( const QString & reason );
+
+    private slots:
+        void onConnected();
+        void onReadyRead();
+        void onDisconnected();
+        void onError( QAbstractSocket::SocketError socketError );
+        // Pass delayed data on as faults allow.
+        void deliverDelayed();
+
+    private:
+        // Reset state and connect to url.
+        void connectTo( const QUrl & target );
+        // Use socket, connect its signals.
+        void attach( QTcpSocket * connection );
+        // Handle received data ( response head, then body ).
+        void process( const QByteArray & data );
+        // Parse response head, returns false if stream can't continue.
+        bool parseHead( const QByteArray & head );
+        // Split body into audio and meta data.
+        void demux( const QByteArray & data, int offset );
+        void parseMetaData( const QByteArray & block );
+        void fail( const QString & reason );
+
+        QTcpSocket * socket;
+        StreamBuffer * buffer;
+        HostResolver * resolver;
+        QElapsedTimer connectTimer;
+        QUrl url;
+        int redirects;
+        // Response head collected so far.
+        QByteArray head;
+        bool streaming;
+        bool refused;
+        int code;
+        QByteArray type;
+        QByteArray name;
+        int kbps;
+        int interval;
+        // Audio bytes left before next meta data length byte.
+        int audioLeft;
+        // Meta data bytes left ( -1 - length byte is next ).
+        int metaLeft;
+        QByteArray metaBlock;
+        QByteArray lastTitle;
+        qint64 received;
+
+        Faults faults;
+        bool faulty;
+        // Data held back by faults: release time and data.
+        QQueue< QPair< qint64, QByteArray > > delayed;
+        int delayedBytes;
+        // Server closed while data was held back.
+        bool serverClosed;
+        // Bytes bandwidth cap allows now.
+        qint64 allowance;
+        qint64 lastDelivery;
+        qint64 connectedAt;
+        QElapsedTimer faultClock;
+        QTimer faultTimer;
+};
+
+#endif
@@ -0,0 +1,292 @@
+//
+// Level meter: RMS, peak and octave spectrum of played audio.
+//
+#include "levelmeter.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QThread>
+#include <QMutexLocker>
+
+#include <math.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+#define METER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Analysed samples ( power of two ), spectrum gets log2( size ) - 1 octave bands.
+#define METER_SIZE 512
+#define METER_BANDS 8
+// Blocks are analysed at most this often ( msec ).
+#define METER_INTERVAL 100
+// Bottom of meter scale ( dB ).
+#define METER_RANGE 60.0
+// Band fall per update ( percents ), peaks stay readable.
+#define METER_DECAY 8
+// 2 * pi ( M_PI is not portable ).
+#define METER_TWO_PI 6.283185307179586
+
+//
+// Analysis thread.
+//
+class MeterWorker : public QThread
+{
+    public:
+        explicit MeterWorker( LevelMeter * owner )
+            :QThread( 0 ),
+             meter( owner ),
+             stopping( 0 )
+        {
+        }
+
+        void stop()
+        {
+            meter->mutex.lock();
+            stopping = 1;
+            meter->wakeup.wakeOne();
+            meter->mutex.unlock();
+            wait();
+        }
+
+    protected:
+        void run()
+        {
+            forever
+            {
+                LevelMeter::Block block;
+                {
+                    QMutexLocker locker( &meter->mutex );
+                    while ( !stopping && meter->waiting.isEmpty() )
+                        meter->wakeup.wait( &meter->mutex );
+                    if ( stopping )
+                        return;
+                    qSwap( block, meter->waiting );
+                }
+                meter->analyse( block );
+            }
+        }
+
+    private:
+        LevelMeter * meter;
+        QAtomicInt stopping;
+};
+
+// Percents of meter scale for ratio to full scale.
+static int scaled( double ratio )
+{
+    if ( ratio <= 0.0 )
+        return 0;
+
+    const double db = 20.0 * log10( ratio );
+    return qBound( 0, int( ( db + METER_RANGE ) * 100.0 / METER_RANGE ), 100 );
+}
+
+// Window samples into output, sum of squares and peak of raw samples.
+static void windowBlock( const qint16 * samples, const float * window, float * output, int count,
+                         float & squares, int & peak )
+{
+    int i = 0;
+    squares = 0.0f;
+    peak = 0;
+#ifdef METER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i top = zero;
+    __m128 sum = _mm_setzero_ps();
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        const __m128i x = _mm_loadu_si128( reinterpret_cast< const __m128i * >( samples + i ) );
+        // Saturating negation keeps -32768 in range.
+        top = _mm_max_epi16( top, _mm_max_epi16( x, _mm_subs_epi16( zero, x ) ) );
+        const __m128 low = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 ) );
+        const __m128 high = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 ) );
+        sum = _mm_add_ps( sum, _mm_add_ps( _mm_mul_ps( low, low ), _mm_mul_ps( high, high ) ) );
+        _mm_storeu_ps( output + i, _mm_mul_ps( low, _mm_loadu_ps( window + i ) ) );
+        _mm_storeu_ps( output + i + 4, _mm_mul_ps( high, _mm_loadu_ps( window + i + 4 ) ) );
+    }
+
+    float lanes[ 4 ];
+    _mm_storeu_ps( lanes, sum );
+    squares = lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+    qint16 tops[ 8 ];
+    _mm_storeu_si128( reinterpret_cast< __m128i * >( tops ), top );
+    for ( int j = 0; j < 8; ++j )
+        peak = qMax( peak, int( tops[ j ] ) );
+#endif
+    for ( ; i < count; ++i )
+    {
+        const float value = samples[ i ];
+        squares += value * value;
+        peak = qMax( peak, qAbs( int( samples[ i ] ) ) );
+        output[ i ] = value * window[ i ];
+    }
+}
+
+LevelMeter::LevelMeter( QObject * parent )
+    :QObject( parent ),
+     worker( 0 ),
+     lastBlock( -METER_INTERVAL ),
+     window( METER_SIZE ),
+     cosTable( METER_SIZE / 2 ),
+     sinTable( METER_SIZE / 2 ),
+     reversed( METER_SIZE ),
+     windowed( METER_SIZE ),
+     re( METER_SIZE ),
+     im( METER_SIZE )
+{
+    for ( int i = 0; i < METER_SIZE; ++i )
+    {
+        window[ i ] = float( 0.5 - 0.5 * cos( METER_TWO_PI * i / ( METER_SIZE - 1 ) ) );
+        int bits = 0;
+        for ( int bit = 1, mirror = METER_SIZE / 2; bit < METER_SIZE; bit <<= 1, mirror >>= 1 )
+        {
+            if ( i & bit )
+                bits |= mirror;
+        }
+        reversed[ i ] = bits;
+    }
+    for ( int i = 0; i < METER_SIZE / 2; ++i )
+    {
+        cosTable[ i ] = float( cos( METER_TWO_PI * i / METER_SIZE ) );
+        sinTable[ i ] = float( sin( METER_TWO_PI * i / METER_SIZE ) );
+    }
+    clock.start();
+}
+
+LevelMeter::~LevelMeter()
+{
+    setEnabled( false );
+}
+
+void LevelMeter::setEnabled( bool enabled )
+{
+    if ( enabled == isEnabled() )
+        return;
+
+    if ( enabled )
+    {
+        worker = new MeterWorker( this );
+        worker->start( QThread::LowPriority );
+        LOG_INFO( "meter", tr( "Level meter started." ) );
+        return;
+    }
+
+    worker->stop();
+    delete worker;
+    worker = 0;
+
+    QMutexLocker locker( &mutex );
+    waiting.clear();
+    result = Levels();
+    LOG_INFO( "meter", tr( "Level meter stopped." ) );
+}
+
+bool LevelMeter::isEnabled() const
+{
+    return worker != 0;
+}
+
+int LevelMeter::blockSize()
+{
+    return METER_SIZE;
+}
+
+LevelMeter::Levels LevelMeter::levels() const
+{
+    QMutexLocker locker( &mutex );
+    return result;
+}
+
+void LevelMeter::addData( const QMap< Phonon::AudioDataOutput::Channel, QVector< qint16 > > & data )
+{
+    // Decimation: one block per interval, copy is shared, not deep.
+    const qint64 now = clock.elapsed();
+    if ( !worker || ( now - lastBlock < METER_INTERVAL ) || data.isEmpty() )
+        return;
+
+    lastBlock = now;
+    QMutexLocker locker( &mutex );
+    waiting = data;
+    wakeup.wakeOne();
+}
+
+void LevelMeter::analyse( const Block & block )
+{
+    TRACE_SCOPE( "LevelMeter::analyse" );
+
+    // Channels are mixed to mono, short blocks are padded with silence.
+    int mixed[ METER_SIZE ] = { 0 };
+    int channels = 0;
+    foreach ( const QVector< qint16 > & samples, block )
+    {
+        const int count = qMin( samples.count(), METER_SIZE );
+        const qint16 * data = samples.constData();
+        for ( int i = 0; i < count; ++i )
+            mixed[ i ] += data[ i ];
+        ++channels;
+    }
+    if ( channels == 0 )
+        return;
+
+    qint16 mono[ METER_SIZE ];
+    for ( int i = 0; i < METER_SIZE; ++i )
+        mono[ i ] = qint16( mixed[ i ] / channels );
+
+    float squares = 0.0f;
+    int peak = 0;
+    windowBlock( mono, window.constData(), windowed.data(), METER_SIZE, squares, peak );
+
+    // Iterative radix-2 FFT of real input.
+    float * x = re.data();
+    float * y = im.data();
+    for ( int i = 0; i < METER_SIZE; ++i )
+    {
+        x[ i ] = windowed[ reversed[ i ] ];
+        y[ i ] = 0.0f;
+    }
+    for ( int length = 2; length <= METER_SIZE; length <<= 1 )
+    {
+        const int half = length / 2;
+        const int step = METER_SIZE / length;
+        for ( int start = 0; start < METER_SIZE; start += length )
+        {
+            for ( int k = 0; k < half; ++k )
+            {
+                const float c = cosTable[ k * step ];
+                const float s = sinTable[ k * step ];
+                const int a = start + k;
+                const int b = a + half;
+                const float tr = x[ b ] * c + y[ b ] * s;
+                const float ti = y[ b ] * c - x[ b ] * s;
+                x[ b ] = x[ a ] - tr;
+                y[ b ] = y[ a ] - ti;
+                x[ a ] += tr;
+                y[ a ] += ti;
+            }
+        }
+    }
+
+    // Octave bands: bins [ 1, 2 ), [ 2, 4 ) ... [ size / 4, size / 2 ).
+    // Full scale sine through Hann window peaks at size / 4 * 32768.
+    const double fullScale = METER_SIZE / 4.0 * 32768.0;
+    QVector< int > bands( METER_BANDS );
+    for ( int band = 0, bin = 1; band < METER_BANDS; ++band )
+    {
+        float strongest = 0.0f;
+        for ( ; bin < ( 2 << band ); ++bin )
+            strongest = qMax( strongest, x[ bin ] * x[ bin ] + y[ bin ] * y[ bin ] );
+        bands[ band ] = scaled( sqrt( strongest ) / fullScale );
+    }
+
+    QMutexLocker locker( &mutex );
+    if ( result.bands.count() == METER_BANDS )
+    {
+        for ( int i = 0; i < METER_BANDS; ++i )
+            bands[ i ] = qMax( bands[ i ], result.bands[ i ] - METER_DECAY );
+    }
+    result.rms = scaled( sqrt( squares / METER_SIZE ) / 32768.0 );
+    result.peak = scaled( peak / 32768.0 );
+    result.bands = bands;
+    locker.unlock();
+    emit updated();
+}
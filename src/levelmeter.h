@@ -0,0 +1,86 @@
+//
+// Level meter: RMS, peak and octave spectrum of played audio.
+//
+// Backend delivers audio blocks on GUI thread, the meter keeps at most one
+// block per update interval and drops the rest, analysis ( window, FFT )
+// runs on worker thread. Worker exists only while meter is enabled, so a
+// disabled meter costs nothing.
+//
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#include <phonon/audiodataoutput.h>
+
+class MeterWorker;
+
+class LevelMeter : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Audio block as delivered by backend.
+        typedef QMap< Phonon::AudioDataOutput::Channel, QVector< qint16 > > Block;
+
+        // Levels in percents of -60 .. 0 dB scale.
+        struct Levels
+        {
+            Levels() : rms( 0 ), peak( 0 ) {}
+
+            int rms;
+            int peak;
+            // Octave bands, lowest first.
+            QVector< int > bands;
+        };
+
+        explicit LevelMeter( QObject * parent = 0 );
+        ~LevelMeter();
+
+        // Start or stop analysis.
+        void setEnabled( bool enabled );
+        bool isEnabled() const;
+        // Samples per channel wanted from backend.
+        static int blockSize();
+        // Last analysed levels.
+        Levels levels() const;
+
+    public slots:
+        // Audio from backend, blocks coming faster than update interval are dropped.
+        void addData( const QMap< Phonon::AudioDataOutput::Channel, QVector< qint16 > > & data );
+
+    signals:
+        // New levels ( sent from worker thread ).
+        void updated();
+
+    private:
+        friend class MeterWorker;
+
+        // Analyse block, called by worker.
+        void analyse( const Block & block );
+
+        MeterWorker * worker;
+        // Guards waiting block and result.
+        mutable QMutex mutex;
+        QWaitCondition wakeup;
+        Block waiting;
+        Levels result;
+        QElapsedTimer clock;
+        qint64 lastBlock;
+        // Hann window, twiddles and bit reversed indexes of FFT.
+        QVector< float > window;
+        QVector< float > cosTable;
+        QVector< float > sinTable;
+        QVector< int > reversed;
+        // Worker's work area.
+        QVector< float > windowed;
+        QVector< float > re;
+        QVector< float > im;
+};
+
+#endif
@@ -2,26 +2,144 @@
 // Logger.
 //
 #include "logger.h"
+#include "tracer.h"
 
 #include <QDebug>
+#include <QThread>
 #include <QDateTime>
 #include <QTextStream>
 
+#include <signal.h>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Ring size ( power of 2 ).
+#define LOG_RING_SIZE 4096
+#define LOG_RING_MASK ( LOG_RING_SIZE - 1 )
+// Writer flush interval ( in msec ).
+#define LOG_FLUSH_INTERVAL 100
+
+// Distance from position a to b, correct across counter wrap.
+static inline int distance( int a, int b )
+{
+    return int( uint( b ) - uint( a ) );
+}
+
+// Append text as ASCII ( others as '?' ) while it fits, returns new length.
+static int appendAscii( char * text, int length, int size, const QString & value )
+{
+    const QChar * c = value.constData();
+    const int count = qMin( value.size(), size - length );
+    for ( int i = 0; i < count; ++i )
+        text[ length++ ] = ( c[ i ].unicode() < 128 ) ? char( c[ i ].unicode() ) : '?';
+    return length;
+}
+
+// Write whole buffer from signal handler, gives up on error.
+static void crashWrite( int fd, const char * data, int length )
+{
+    while ( length > 0 )
+    {
+        const int done = int( write( fd, data, length ) );
+        if ( done <= 0 )
+            return;
+        data += done;
+        length -= done;
+    }
+}
+
+//
+// Writer thread.
+//
+class LogWriter : public QThread
+{
+    public:
+        explicit LogWriter( Logger * owner )
+            :QThread( 0 ),
+             logger( owner ),
+             stopping( 0 )
+        {
+        }
+
+        void stop()
+        {
+            stopping = 1;
+            logger->wakeup.wakeOne();
+            wait();
+        }
+
+    protected:
+        void run()
+        {
+            QMutex sleepMutex;
+            while ( !stopping )
+            {
+                sleepMutex.lock();
+                logger->wakeup.wait( &sleepMutex, LOG_FLUSH_INTERVAL );
+                sleepMutex.unlock();
+                logger->drain();
+            }
+            logger->drain();
+        }
+
+    private:
+        Logger * logger;
+        QAtomicInt stopping;
+};
+
 Logger * Logger::logger;
+volatile int Logger::crashFd = -1;
 
 Logger::Logger()
-    :QObject( 0 )
+    :QObject( 0 ),
+     minLevel( Debug ),
+     lowestLevel( Debug ),
+     ring( new Slot[ LOG_RING_SIZE ] ),
+     enqueuePos( 0 ),
+     dequeuePos( 0 ),
+     dropped( 0 ),
+     queued( 0 ),
+     written( 0 ),
+     reportedDrops( 0 ),
+     overflowPolicy( Drop ),
+     writer( 0 )
 {
     if ( logger )
     {
         delete logger;
         logger = 0;
     }
+
+    for ( int i = 0; i < LOG_RING_SIZE; ++i )
+    {
+        ring[ i ].sequence = i;
+        ring[ i ].crashLength = 0;
+    }
+
+    writer = new LogWriter( this );
+    writer->start( QThread::LowPriority );
     logger = this;
+
+    signal( SIGSEGV, crashHandler );
+    signal( SIGABRT, crashHandler );
+    signal( SIGFPE, crashHandler );
+    signal( SIGILL, crashHandler );
 }
 
 Logger::~Logger()
 {
+    if ( logger == this )
+        logger = 0;
+
+    // Writer drains the ring before exit.
+    writer->stop();
+    delete writer;
+    delete [] ring;
+
+    crashFd = -1;
     if ( file.isOpen() )
     {
         file.flush();
@@ -31,42 +149,281 @@ Logger::~Logger()
 
 void Logger::add( Type type, const QString & source, const QString & message )
 {
-    QString logMessage;
-    switch ( type )
-    {
-        case Debug      : logMessage = "[ DEBUG ] "; break;
-        case Information: logMessage = "[ INFO. ] "; break;
-        case Warning    : logMessage = "[ WARN. ] "; break;
-        case Error      : logMessage = "[ ERROR ] "; break;
-    }
+    TRACE_SCOPE( "Logger::add" );
+    levelCounts[ type ].ref();
 
-    logMessage += QString( "%1: %2 - %3" )
-                  .arg( QDateTime::currentDateTime().toString( "hh:mm:ss" ) )
-                  .arg( source )
-                  .arg( message );
-    qDebug() << logMessage;
-    if ( file.isOpen() )
+    int pos = enqueuePos;
+    Slot * slot = 0;
+    forever
     {
-        QTextStream out( &file );
-        out << logMessage << "\r\n";
+        slot = &ring[ pos & LOG_RING_MASK ];
+        const int dif = distance( pos, slot->sequence.fetchAndAddAcquire( 0 ) );
+        if ( dif == 0 )
+        {
+            if ( enqueuePos.testAndSetRelaxed( pos, int( uint( pos ) + 1 ) ) )
+                break;
+        }
+        else if ( dif < 0 )
+        {
+            // Ring is full.
+            if ( ( overflowPolicy == Drop ) || !writer->isRunning() ||
+                 ( QThread::currentThread() == writer ) )
+            {
+                dropped.ref();
+                return;
+            }
+            wakeup.wakeOne();
+            QThread::yieldCurrentThread();
+        }
+        pos = enqueuePos;
     }
+
+    slot->record.type = type;
+    slot->record.time = QDateTime::currentMSecsSinceEpoch();
+    slot->record.source = source;
+    slot->record.message = message;
+    // Plain-text copy for crash handler.
+    static const char * const tags[] = { "[ DEBUG ] ", "[ INFO. ] ", "[ WARN. ] ", "[ ERROR ] " };
+    const int size = int( sizeof( slot->crashText ) );
+    int length = 0;
+    for ( const char * c = tags[ type ]; *c; ++c )
+        slot->crashText[ length++ ] = *c;
+    length = appendAscii( slot->crashText, length, size, source );
+    for ( const char * c = " - "; *c && ( length < size ); ++c )
+        slot->crashText[ length++ ] = *c;
+    slot->crashLength = appendAscii( slot->crashText, length, size, message );
+    slot->sequence.fetchAndStoreRelease( int( uint( pos ) + 1 ) );
+    queued.ref();
+
+    // Don't wait for flush interval when ring fills up.
+    if ( distance( dequeuePos, pos ) >= LOG_RING_SIZE / 2 )
+        wakeup.wakeOne();
 }
 
 void Logger::setLogFile( const QString & fileName )
 {
+    QMutexLocker locker( &mutex );
     logFile = fileName;
     if ( !fileName.isEmpty() )
     {
+        crashFd = -1;
         if ( file.isOpen() )
         {
             file.flush();
             file.close();
         }
         file.setFileName( fileName );
-        file.open( QFile::WriteOnly );
+        if ( file.open( QFile::WriteOnly ) )
+            crashFd = file.handle();
     }
 }
 
+void Logger::setLevel( Type level )
+{
+    minLevel = level;
+    updateLowestLevel();
+}
+
+void Logger::setSourceLevel( const QString & source, Type level )
+{
+    const QByteArray name = source.toLatin1();
+    for ( int i = 0; i < sourceLevels.count(); ++i )
+    {
+        if ( sourceLevels[ i ].first == name )
+        {
+            sourceLevels[ i ].second = level;
+            updateLowestLevel();
+            return;
+        }
+    }
+    sourceLevels.append( qMakePair( name, static_cast< int >( level ) ) );
+    updateLowestLevel();
+}
+
+Logger::Type Logger::levelFromString( const QString & name, Type defaultLevel )
+{
+    const QString level = name.trimmed().toLower();
+    if ( level == "debug" )
+        return Debug;
+    else if ( ( level == "info" ) || ( level == "information" ) )
+        return Information;
+    else if ( ( level == "warn" ) || ( level == "warning" ) )
+        return Warning;
+    else if ( level == "error" )
+        return Error;
+
+    return defaultLevel;
+}
+
+bool Logger::sourceEnabled( Type type, const char * source ) const
+{
+    for ( int i = 0; i < sourceLevels.count(); ++i )
+    {
+        if ( sourceLevels[ i ].first == source )
+            return type >= sourceLevels[ i ].second;
+    }
+
+    return type >= minLevel;
+}
+
+void Logger::updateLowestLevel()
+{
+    int level = minLevel;
+    for ( int i = 0; i < sourceLevels.count(); ++i )
+        level = qMin( level, sourceLevels[ i ].second );
+    lowestLevel = level;
+}
+
+void Logger::setOverflowPolicy( OverflowPolicy policy )
+{
+    overflowPolicy = policy;
+}
+
+void Logger::flush()
+{
+    drain();
+}
+
+int Logger::droppedCount() const
+{
+    return dropped;
+}
+
+int Logger::queuedCount() const
+{
+    return queued;
+}
+
+int Logger::writtenCount() const
+{
+    return written;
+}
+
+int Logger::recordCount( Type type ) const
+{
+    return levelCounts[ type ];
+}
+
+bool Logger::take( Record & record )
+{
+    const int pos = dequeuePos;
+    Slot & slot = ring[ pos & LOG_RING_MASK ];
+    if ( distance( pos, slot.sequence.fetchAndAddAcquire( 0 ) ) != 1 )
+        return false;
+
+    record = slot.record;
+    slot.record.source.clear();
+    slot.record.message.clear();
+    slot.sequence.fetchAndStoreRelease( int( uint( pos ) + LOG_RING_SIZE ) );
+    // Single consumer, no other writer of dequeue position.
+    dequeuePos.fetchAndStoreRelease( int( uint( pos ) + 1 ) );
+    return true;
+}
+
+void Logger::writeQueued()
+{
+    QTextStream out( &file );
+    Record record;
+    int count = 0;
+    while ( take( record ) )
+    {
+        QString logMessage;
+        switch ( record.type )
+        {
+            case Debug      : logMessage = "[ DEBUG ] "; break;
+            case Information: logMessage = "[ INFO. ] "; break;
+            case Warning    : logMessage = "[ WARN. ] "; break;
+            case Error      : logMessage = "[ ERROR ] "; break;
+        }
+
+        logMessage += QString( "%1: %2 - %3" )
+                      .arg( QDateTime::fromMSecsSinceEpoch( record.time ).toString( "hh:mm:ss" ) )
+                      .arg( record.source )
+                      .arg( record.message );
+        qDebug() << logMessage;
+        if ( file.isOpen() )
+            out << logMessage << "\r\n";
+        ++count;
+    }
+
+    const int drops = dropped;
+    if ( drops != reportedDrops )
+    {
+        const QString logMessage = QString( "[ WARN. ] %1: logger - %2 records dropped." )
+                                   .arg( QDateTime::currentDateTime().toString( "hh:mm:ss" ) )
+                                   .arg( drops - reportedDrops );
+        qDebug() << logMessage;
+        if ( file.isOpen() )
+            out << logMessage << "\r\n";
+        reportedDrops = drops;
+    }
+
+    if ( file.isOpen() )
+    {
+        out.flush();
+        file.flush();
+    }
+    written.fetchAndAddRelaxed( count );
+}
+
+void Logger::drain()
+{
+    QMutexLocker locker( &mutex );
+    writeQueued();
+}
+
+void Logger::crashHandler( int sig )
+{
+    // Only async-signal-safe calls here: no locks, no allocation, no Qt.
+    // Published cells not taken by writer yet are written as plain text.
+    const int fd = ( crashFd >= 0 ) ? int( crashFd ) : 2;
+    int flushed = 0;
+    if ( logger )
+    {
+        const int first = logger->dequeuePos;
+        const int count = qMin( distance( first, logger->enqueuePos ), LOG_RING_SIZE );
+        for ( int i = 0; i < count; ++i )
+        {
+            const int pos = int( uint( first ) + uint( i ) );
+            const Slot & slot = logger->ring[ pos & LOG_RING_MASK ];
+            if ( distance( pos, slot.sequence ) != 1 )
+                continue;
+
+            crashWrite( fd, slot.crashText, slot.crashLength );
+            crashWrite( fd, "\r\n", 2 );
+            ++flushed;
+        }
+    }
+
+    char message[ 96 ] = "[ ERROR ] logger - fatal signal ";
+    int length = int( sizeof( "[ ERROR ] logger - fatal signal " ) ) - 1;
+    const char * const tail[ 2 ] = { ", ", " queued records written.\r\n" };
+    const int values[ 2 ] = { sig, flushed };
+    for ( int i = 0; i < 2; ++i )
+    {
+        char digits[ 12 ];
+        int count = 0;
+        uint value = uint( qMax( values[ i ], 0 ) );
+        do
+        {
+            digits[ count++ ] = char( '0' + value % 10 );
+            value /= 10;
+        }
+        while ( value );
+        while ( count )
+            message[ length++ ] = digits[ --count ];
+        for ( const char * c = tail[ i ]; *c; ++c )
+            message[ length++ ] = *c;
+    }
+
+    if ( fd != 2 )
+        crashWrite( fd, message, length );
+    crashWrite( 2, message, length );
+
+    signal( sig, SIG_DFL );
+    raise( sig );
+}
+
 Logger * Logger::instance()
 {
     return logger;
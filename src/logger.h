@@ -1,11 +1,31 @@
 //
 // Logger.
 //
+// Callers only enqueue records into a bounded lock-free ring, formatting and
+// file output are done by the writer thread. When the ring is full records
+// are dropped ( and counted ) or, with Block policy, caller waits for space.
+// Each record also keeps a short plain-text copy in its ring cell, so on a
+// fatal signal records not written yet are flushed without locks or
+// allocation.
+//
+// LOG_* macros check level before evaluating message, so disabled records cost
+// one comparison. LOG_MIN_LEVEL ( build define ) removes lower levels completely.
+// Source of LOG_* macros must be a string literal: per-source filter compares it
+// as C string, anything else is rejected at compile time.
+//
 #ifndef LOGGER_H
 #define LOGGER_H
 
 #include <QObject>
+#include <QList>
+#include <QPair>
+#include <QByteArray>
 #include <QFile>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QWaitCondition>
+
+class LogWriter;
 
 class Logger : public QObject
 {
@@ -13,25 +33,118 @@ class Logger : public QObject
 
     public:
         enum Type { Debug, Information, Warning, Error };
+        // Behaviour of add() on full ring.
+        enum OverflowPolicy { Drop, Block };
 
         explicit Logger();
         ~Logger();
 
         static Logger * instance();
 
+        // Is record of type from source ( C string ) passed by level filter.
+        inline bool isEnabled( Type type, const char * source ) const
+        {
+            if ( type < lowestLevel )
+                return false;
+
+            return sourceLevels.isEmpty() ? ( type >= minLevel ) : sourceEnabled( type, source );
+        }
+        // Minimum level of all sources.
+        void setLevel( Type level );
+        // Minimum level of source, overrides common level.
+        void setSourceLevel( const QString & source, Type level );
+        // Level by name ( debug, info, warning, error ).
+        static Type levelFromString( const QString & name, Type defaultLevel );
+
+        // Enqueue record, never touches file or console.
         void add( Type type, const QString & source, const QString & message );
         void setLogFile( const QString & fileName );
+        void setOverflowPolicy( OverflowPolicy policy );
+        // Write all queued records now.
+        void flush();
+        // Records lost on full ring.
+        int droppedCount() const;
+        // Records accepted into ring.
+        int queuedCount() const;
+        // Records written by writer.
+        int writtenCount() const;
+        // Records of type passed by level filter.
+        int recordCount( Type type ) const;
 
     private:
+        friend class LogWriter;
+
+        // Log record.
+        struct Record
+        {
+            int type;
+            qint64 time;
+            QString source;
+            QString message;
+        };
+
+        // Ring cell, sequence tells whose turn it is ( producer or writer ).
+        struct Slot
+        {
+            QAtomicInt sequence;
+            Record record;
+            // Record as plain text for crash handler ( truncated, no line end ).
+            char crashText[ 160 ];
+            int crashLength;
+        };
+
+        // Per-source part of level filter.
+        bool sourceEnabled( Type type, const char * source ) const;
+        // Recalculate lowest enabled level.
+        void updateLowestLevel();
+        // Take next record from ring ( single consumer ).
+        bool take( Record & record );
+        // Format and write queued records, mutex must be locked.
+        void writeQueued();
+        // Lock and write queued records.
+        void drain();
+        // Write records not written yet and note fatal signal, async-signal-safe.
+        static void crashHandler( int sig );
+
         static Logger * logger;
+        int minLevel;
+        // Lowest level enabled for any source.
+        int lowestLevel;
+        QList< QPair< QByteArray, int > > sourceLevels;
         QString logFile;
         QFile file;
+        // Descriptor of open log file for crash handler ( -1 - none ).
+        static volatile int crashFd;
+        // Guards file and consumer side of ring.
+        QMutex mutex;
+        Slot * ring;
+        // Positions wrap, compare them as unsigned differences only.
+        QAtomicInt enqueuePos;
+        QAtomicInt dequeuePos;
+        QAtomicInt dropped;
+        QAtomicInt queued;
+        QAtomicInt written;
+        QAtomicInt levelCounts[ Error + 1 ];
+        // Drops already reported in log.
+        int reportedDrops;
+        OverflowPolicy overflowPolicy;
+        LogWriter * writer;
+        // Wakes writer before its flush interval.
+        QWaitCondition wakeup;
 };
 
-#define LOG_DEBUG( s, m ) { if ( Logger::instance() ) Logger::instance()->add( Logger::Debug      , ( s ), ( m ) ); }
-#define LOG_INFO( s, m )  { if ( Logger::instance() ) Logger::instance()->add( Logger::Information, ( s ), ( m ) ); }
-#define LOG_WARN( s, m )  { if ( Logger::instance() ) Logger::instance()->add( Logger::Warning    , ( s ), ( m ) ); }
-#define LOG_ERROR( s, m ) { if ( Logger::instance() ) Logger::instance()->add( Logger::Error      , ( s ), ( m ) ); }
+// Build time minimum level ( 0 - debug, 1 - info, 2 - warning, 3 - error ).
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// Literal concatenation ( "" s ) only compiles for string literal source.
+#define LOG_ENABLED( t, s ) ( ( ( t ) >= LOG_MIN_LEVEL ) && Logger::instance() && Logger::instance()->isEnabled( ( t ), "" s ) )
+
+#define LOG_DEBUG( s, m ) { if ( LOG_ENABLED( Logger::Debug      , s ) ) Logger::instance()->add( Logger::Debug      , ( s ), ( m ) ); }
+#define LOG_INFO( s, m )  { if ( LOG_ENABLED( Logger::Information, s ) ) Logger::instance()->add( Logger::Information, ( s ), ( m ) ); }
+#define LOG_WARN( s, m )  { if ( LOG_ENABLED( Logger::Warning    , s ) ) Logger::instance()->add( Logger::Warning    , ( s ), ( m ) ); }
+#define LOG_ERROR( s, m ) { if ( LOG_ENABLED( Logger::Error      , s ) ) Logger::instance()->add( Logger::Error      , ( s ), ( m ) ); }
 
 
 #endif // LOGGER_H
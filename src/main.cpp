@@ -3,29 +3,60 @@
 //
 #include <QLocale>
 #include <QTranslator>
+#include <QElapsedTimer>
 
 #include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
 #include "application.h"
+#include "controlserver.h"
 
 int main( int argc, char * argv[] )
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    // Commands for running instance: sent without GUI and audio backend.
+    const QStringList commands = ControlServer::commandsFromArguments( argc, argv );
+    if ( !commands.isEmpty() )
+    {
+        QCoreApplication client( argc, argv );
+        return ControlServer::send( commands );
+    }
+
     Application app( argc, argv );
     QTranslator translator;
     Logger logger;
+    Tracer tracer;
+    Metrics metrics;
 
 #ifdef DEBUG
     logger.setLogFile( "debug.log" );
 #endif
 
+    // Trace file from command line: --trace <file> or --trace=<file>.
+    const QStringList arguments = app.arguments();
+    for ( int i = 1; i < arguments.count(); ++i )
+    {
+        if ( arguments[ i ].startsWith( "--trace=" ) )
+            tracer.start( arguments[ i ].mid( 8 ) );
+        else if ( ( arguments[ i ] == "--trace" ) && ( i + 1 < arguments.count() ) )
+            tracer.start( arguments[ ++i ] );
+    }
+
     QString locale = QLocale::system().name();
     locale.truncate( 2 );
     const QString codecName = ":/translations/qradiotray_" + locale;
     translator.load( codecName );
 
+    app.setStartupTimer( startupTimer );
     app.installTranslator( &translator );
     app.setApplicationName( QT_TRANSLATE_NOOP( "main", "QRadioTray" ) );
     app.setQuitOnLastWindowClosed( false );
     app.setWindowIcon( QIcon( ":/images/radio-active.png" ) );
+    // One player per user, second start just exits.
+    if ( !app.claimInstance() )
+        return 0;
     if ( !app.loadSettings() || !app.configure() )
         return -1;
 
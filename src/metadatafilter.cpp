@@ -0,0 +1,145 @@
+//
+// Meta data filter: turns stream meta data events into track changes.
+//
+#include "metadatafilter.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QHash>
+#include <QTextCodec>
+
+// Shown keys, in display order.
+static const char * const META_KEYS[] = { "ALBUM", "ARTIST", "TITLE" };
+#define META_KEY_COUNT 3
+// Default maximum wait of burst ( in msec ).
+#define META_MAX_WAIT 4000
+
+MetaDataFilter::MetaDataFilter( QObject * parent )
+    :QObject( parent ),
+     codec( 0 ),
+     window( 1000 ),
+     maxWait( META_MAX_WAIT ),
+     pendingPrint( 0 ),
+     lastPrint( 0 ),
+     hasPending( false ),
+     hasLast( false ),
+     received( 0 ),
+     duplicates( 0 ),
+     published( 0 )
+{
+    timer.setSingleShot( true );
+    connect( &timer, SIGNAL( timeout() ), SLOT( publish() ) );
+}
+
+void MetaDataFilter::setEncoding( const QString & encoding )
+{
+    codec = encoding.isEmpty() ? 0 : QTextCodec::codecForName( encoding.toLatin1() );
+    if ( !codec && !encoding.isEmpty() )
+        LOG_WARN( "metadata", tr( "Unknown encoding %1." ).arg( encoding ) );
+}
+
+void MetaDataFilter::setWindow( int msec )
+{
+    window = qMax( 0, msec );
+}
+
+void MetaDataFilter::setMaxWait( int msec )
+{
+    maxWait = qMax( 0, msec );
+}
+
+void MetaDataFilter::reset()
+{
+    timer.stop();
+    hasPending = false;
+    hasLast = false;
+    LOG_DEBUG( "metadata", tr( "Meta data events: %1 received, %2 duplicate, %3 published." )
+                           .arg( received ).arg( duplicates ).arg( published ) );
+}
+
+quint64 MetaDataFilter::receivedCount() const
+{
+    return received;
+}
+
+quint64 MetaDataFilter::duplicateCount() const
+{
+    return duplicates;
+}
+
+quint64 MetaDataFilter::publishedCount() const
+{
+    return published;
+}
+
+void MetaDataFilter::process( const QMultiMap< QString, QString > & data )
+{
+    TRACE_SCOPE( "MetaDataFilter::process" );
+    ++received;
+
+    QStringList values;
+    QString joined;
+    for ( int i = 0; i < META_KEY_COUNT; ++i )
+    {
+        QMultiMap< QString, QString >::const_iterator it = data.constFind( META_KEYS[ i ] );
+        const QString value = ( it != data.constEnd() ) ? it.value() : QString();
+        values.append( value );
+        joined += value;
+        joined += QChar( 0x1f );
+    }
+
+    // Same as shown track or as the one already waiting.
+    const quint32 print = qHash( joined );
+    if ( ( hasLast && !hasPending && ( print == lastPrint ) ) ||
+         ( hasPending && ( print == pendingPrint ) ) )
+    {
+        ++duplicates;
+        TRACE_COUNTER( "metadata duplicates", duplicates );
+        return;
+    }
+
+    if ( !hasPending )
+        pendingClock.start();
+    pending = values;
+    pendingPrint = print;
+    hasPending = true;
+
+    // Window restarts on every event, but not past maximum wait of burst.
+    const int left = int( maxWait - pendingClock.elapsed() );
+    if ( ( window > 0 ) && ( left > 0 ) )
+        timer.start( qMin( window, left ) );
+    else
+        publish();
+}
+
+void MetaDataFilter::publish()
+{
+    if ( !hasPending )
+        return;
+
+    timer.stop();
+    hasPending = false;
+    if ( hasLast && ( pendingPrint == lastPrint ) )
+    {
+        // Burst ended on the track already shown.
+        ++duplicates;
+        return;
+    }
+
+    QString text;
+    for ( int i = 0; i < META_KEY_COUNT; ++i )
+    {
+        if ( pending[ i ].isEmpty() )
+            continue;
+
+        // Backend gives raw bytes as Latin-1 characters.
+        const QString value = codec ? codec->toUnicode( pending[ i ].toLatin1() ) : pending[ i ];
+        text += QString( "%1:\r\n%2\r\n\r\n" ).arg( META_KEYS[ i ] ).arg( value );
+    }
+
+    lastPrint = pendingPrint;
+    hasLast = true;
+    ++published;
+    TRACE_COUNTER( "metadata published", published );
+    emit trackChanged( text.trimmed() );
+}
@@ -0,0 +1,70 @@
+//
+// Meta data filter: turns stream meta data events into track changes.
+//
+// Values are decoded with the codec of current station ( resolved once per
+// station ). Events repeating the last track are dropped by fingerprint,
+// bursts are collapsed into the last event of debounce window. A burst
+// longer than maximum wait is published anyway, so meta data changing
+// faster than the window still reaches the UI.
+//
+#ifndef META_DATA_FILTER_H
+#define META_DATA_FILTER_H
+
+#include <QObject>
+#include <QMultiMap>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QTextCodec;
+
+class MetaDataFilter : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit MetaDataFilter( QObject * parent = 0 );
+
+        // Station text encoding ( empty or unknown - no conversion ).
+        void setEncoding( const QString & encoding );
+        // Debounce window ( in msec, 0 - publish at once ).
+        void setWindow( int msec );
+        // Longest delay of first waiting event ( in msec ).
+        void setMaxWait( int msec );
+        // Forget last track ( station changed ).
+        void reset();
+
+        // Counters.
+        quint64 receivedCount() const;
+        quint64 duplicateCount() const;
+        quint64 publishedCount() const;
+
+    public slots:
+        void process( const QMultiMap< QString, QString > & data );
+
+    signals:
+        // Track text changed.
+        void trackChanged( const QString & text );
+
+    private slots:
+        void publish();
+
+    private:
+        QTextCodec * codec;
+        QTimer timer;
+        int window;
+        int maxWait;
+        // Age of waiting burst.
+        QElapsedTimer pendingClock;
+        // Raw values of waiting event ( one per shown key ).
+        QStringList pending;
+        quint32 pendingPrint;
+        quint32 lastPrint;
+        bool hasPending;
+        bool hasLast;
+        quint64 received;
+        quint64 duplicates;
+        quint64 published;
+};
+
+#endif
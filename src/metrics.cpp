@@ -0,0 +1,376 @@
+//
+// Metrics: runtime counters exported in Prometheus text format.
+//
+#include "metrics.h"
+#include "logger.h"
+
+#include <QFile>
+#include <QThread>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QMutexLocker>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Event loop check interval ( msec ).
+#define METRICS_LOOP_INTERVAL 100
+// Server checks stop flag this often ( msec ).
+#define METRICS_POLL_INTERVAL 500
+// Slow scraper is dropped after ( msec ).
+#define METRICS_CLIENT_TIMEOUT 2000
+// Longest accepted request head ( bytes ).
+#define METRICS_MAX_REQUEST 8192
+
+// Upper bucket bounds ( msec ) of histograms, last bucket is +Inf.
+static const int bucketBounds[ Metrics::HistogramCount ][ METRIC_BUCKETS - 1 ] =
+{
+    { 250, 500, 1000, 2000, 5000, 10000, 30000 },
+    { 5, 10, 25, 50, 100, 250, 1000 }
+};
+
+static const char * const counterNames[ Metrics::CounterCount ][ 2 ] =
+{
+    { "qradiotray_buffering_events_total", "Times player entered buffering state." },
+    { "qradiotray_underruns_total", "Own stream ran dry while playing." },
+    { "qradiotray_reconnects_total", "Reconnect attempts after stream errors." },
+    { "qradiotray_outages_total", "Stream outages ( recovered or not )." },
+    { "qradiotray_switches_total", "Station switches that reached audio." },
+    { "qradiotray_metadata_events_total", "Meta data updates from stream." },
+    { "qradiotray_stream_bytes_total", "Bytes received by own stream clients." }
+};
+
+static const char * const gaugeNames[ Metrics::GaugeCount ][ 2 ] =
+{
+    { "qradiotray_buffering_percent", "Last buffering value reported by backend." },
+    { "qradiotray_buffer_fill_bytes", "Own stream buffer fill." },
+    { "qradiotray_buffer_target_bytes", "Own stream buffer prebuffer target." }
+};
+
+static const char * const histogramNames[ Metrics::HistogramCount ][ 2 ] =
+{
+    { "qradiotray_first_audio_seconds", "Time from station switch to audio." },
+    { "qradiotray_event_loop_latency_seconds", "Delay of GUI event loop." }
+};
+
+static const char * const stateNames[ Metrics::StateCount ] =
+{
+    "stopped", "playing", "paused", "buffering", "error"
+};
+
+static const char * const levelNames[ 4 ] =
+{
+    "debug", "info", "warning", "error"
+};
+
+//
+// Loopback HTTP server thread.
+//
+class MetricsServer : public QThread
+{
+    public:
+        MetricsServer( Metrics * owner, quint16 listenPort )
+            :QThread( 0 ),
+             metrics( owner ),
+             port( listenPort ),
+             stopping( 0 )
+        {
+        }
+
+        void stop()
+        {
+            stopping = 1;
+            wait();
+        }
+
+    protected:
+        void run()
+        {
+            QTcpServer listener;
+            if ( !listener.listen( QHostAddress::LocalHost, port ) )
+            {
+                LOG_ERROR( "metrics", QObject::tr( "Can't listen on port %1: %2" )
+                                      .arg( port ).arg( listener.errorString() ) );
+                return;
+            }
+
+            LOG_INFO( "metrics", QObject::tr( "Metrics on http://127.0.0.1:%1/metrics" ).arg( port ) );
+            while ( !stopping )
+            {
+                if ( !listener.waitForNewConnection( METRICS_POLL_INTERVAL ) )
+                    continue;
+
+                while ( QTcpSocket * socket = listener.nextPendingConnection() )
+                {
+                    serve( socket );
+                    delete socket;
+                }
+            }
+        }
+
+    private:
+        // Answer one request, scrapes are rare so one at a time is enough.
+        void serve( QTcpSocket * socket )
+        {
+            QByteArray request;
+            while ( !request.contains( "\r\n\r\n" ) && ( request.size() < METRICS_MAX_REQUEST ) )
+            {
+                if ( !socket->waitForReadyRead( METRICS_CLIENT_TIMEOUT ) )
+                    return;
+                request += socket->readAll();
+            }
+
+            const QList< QByteArray > line = request.left( request.indexOf( '\r' ) ).split( ' ' );
+            const QByteArray path = line.value( 1 );
+            QByteArray response;
+            if ( ( line.value( 0 ) == "GET" ) && ( ( path == "/metrics" ) || ( path == "/" ) ) )
+            {
+                const QByteArray body = metrics->exposition();
+                response = "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + QByteArray::number( body.size() ) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+            }
+            else
+                response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+            socket->write( response );
+            while ( socket->bytesToWrite() && socket->waitForBytesWritten( METRICS_CLIENT_TIMEOUT ) )
+                ;
+            socket->disconnectFromHost();
+            if ( socket->state() != QAbstractSocket::UnconnectedState )
+                socket->waitForDisconnected( METRICS_CLIENT_TIMEOUT );
+        }
+
+        Metrics * metrics;
+        quint16 port;
+        QAtomicInt stopping;
+};
+
+Metrics * Metrics::metrics;
+QAtomicInt Metrics::enabled;
+
+Metrics::Metrics()
+    :QObject( 0 ),
+     state( Stopped ),
+     server( 0 )
+{
+    if ( metrics )
+    {
+        delete metrics;
+        metrics = 0;
+    }
+
+    for ( int i = 0; i < CounterCount + HistogramCount; ++i )
+    {
+        totals[ i ] = 0;
+        folded[ i ] = 0;
+    }
+    for ( int i = 0; i < StateCount; ++i )
+        stateTimes[ i ] = 0;
+    stateClock.start();
+
+    loopTimer.setInterval( METRICS_LOOP_INTERVAL );
+    connect( &loopTimer, SIGNAL( timeout() ), SLOT( checkLoop() ) );
+    metrics = this;
+}
+
+Metrics::~Metrics()
+{
+    stop();
+    if ( metrics == this )
+        metrics = 0;
+}
+
+Metrics * Metrics::instance()
+{
+    return metrics;
+}
+
+void Metrics::start( quint16 port )
+{
+    stop();
+    if ( port == 0 )
+        return;
+
+    enabled.fetchAndStoreRelease( 1 );
+    loopClock.start();
+    loopTimer.start();
+    server = new MetricsServer( this, port );
+    server->start( QThread::LowPriority );
+}
+
+void Metrics::stop()
+{
+    enabled.fetchAndStoreRelease( 0 );
+    loopTimer.stop();
+    if ( server )
+    {
+        server->stop();
+        delete server;
+        server = 0;
+    }
+}
+
+void Metrics::observe( Histogram histogram, int msec )
+{
+    int bucket = 0;
+    while ( ( bucket < METRIC_BUCKETS - 1 ) && ( msec > bucketBounds[ histogram ][ bucket ] ) )
+        ++bucket;
+    buckets[ histogram ][ bucket ].ref();
+    sums[ histogram ].fetchAndAddRelaxed( msec );
+}
+
+void Metrics::setState( State newState )
+{
+    QMutexLocker locker( &mutex );
+    if ( newState == state )
+        return;
+
+    stateTimes[ state ] += stateClock.restart();
+    state = newState;
+}
+
+QByteArray Metrics::exposition()
+{
+    // Copy under lock, format without it.
+    qint64 counterValues[ CounterCount + HistogramCount ];
+    qint64 times[ StateCount ];
+    {
+        QMutexLocker locker( &mutex );
+        fold();
+        for ( int i = 0; i < CounterCount + HistogramCount; ++i )
+            counterValues[ i ] = totals[ i ];
+        for ( int i = 0; i < StateCount; ++i )
+            times[ i ] = stateTimes[ i ];
+        times[ state ] += stateClock.elapsed();
+    }
+
+    QByteArray text;
+    text.reserve( 4096 );
+    text += "# HELP qradiotray_player_state_seconds_total Time spent in player state.\n"
+            "# TYPE qradiotray_player_state_seconds_total counter\n";
+    for ( int i = 0; i < StateCount; ++i )
+    {
+        text += "qradiotray_player_state_seconds_total{state=\"" + QByteArray( stateNames[ i ] ) + "\"} " +
+                QByteArray::number( times[ i ] / 1000.0, 'f', 3 ) + "\n";
+    }
+
+    for ( int i = 0; i < CounterCount; ++i )
+    {
+        text += "# HELP " + QByteArray( counterNames[ i ][ 0 ] ) + " " + counterNames[ i ][ 1 ] + "\n"
+                "# TYPE " + counterNames[ i ][ 0 ] + " counter\n" +
+                counterNames[ i ][ 0 ] + " " + QByteArray::number( counterValues[ i ] ) + "\n";
+    }
+
+    for ( int i = 0; i < GaugeCount; ++i )
+    {
+        text += "# HELP " + QByteArray( gaugeNames[ i ][ 0 ] ) + " " + gaugeNames[ i ][ 1 ] + "\n"
+                "# TYPE " + gaugeNames[ i ][ 0 ] + " gauge\n" +
+                gaugeNames[ i ][ 0 ] + " " + QByteArray::number( int( gauges[ i ] ) ) + "\n";
+    }
+
+    for ( int i = 0; i < HistogramCount; ++i )
+    {
+        const QByteArray name = histogramNames[ i ][ 0 ];
+        text += "# HELP " + name + " " + histogramNames[ i ][ 1 ] + "\n"
+                "# TYPE " + name + " histogram\n";
+        qint64 count = 0;
+        for ( int j = 0; j < METRIC_BUCKETS; ++j )
+        {
+            count += int( buckets[ i ][ j ] );
+            const QByteArray bound = ( j < METRIC_BUCKETS - 1 ) ?
+                                     QByteArray::number( bucketBounds[ i ][ j ] / 1000.0 ) : QByteArray( "+Inf" );
+            text += name + "_bucket{le=\"" + bound + "\"} " + QByteArray::number( count ) + "\n";
+        }
+        text += name + "_sum " + QByteArray::number( counterValues[ CounterCount + i ] / 1000.0, 'f', 3 ) + "\n" +
+                name + "_count " + QByteArray::number( count ) + "\n";
+    }
+
+    if ( Logger::instance() )
+    {
+        const Logger * logger = Logger::instance();
+        text += "# HELP qradiotray_log_records_total Log records by level.\n"
+                "# TYPE qradiotray_log_records_total counter\n";
+        for ( int i = Logger::Debug; i <= Logger::Error; ++i )
+        {
+            text += "qradiotray_log_records_total{level=\"" + QByteArray( levelNames[ i ] ) + "\"} " +
+                    QByteArray::number( logger->recordCount( Logger::Type( i ) ) ) + "\n";
+        }
+        text += "# HELP qradiotray_log_dropped_total Log records lost on full ring.\n"
+                "# TYPE qradiotray_log_dropped_total counter\n"
+                "qradiotray_log_dropped_total " + QByteArray::number( logger->droppedCount() ) + "\n";
+    }
+
+    appendProcess( text );
+    return text;
+}
+
+void Metrics::checkLoop()
+{
+    // Timer lateness is time the loop was busy elsewhere.
+    const qint64 late = loopClock.restart() - METRICS_LOOP_INTERVAL;
+    observe( LoopLatency, int( qMax< qint64 >( 0, late ) ) );
+
+    // Scrape holds lock only to copy values, next tick folds.
+    if ( mutex.tryLock() )
+    {
+        fold();
+        mutex.unlock();
+    }
+}
+
+void Metrics::fold()
+{
+    for ( int i = 0; i < CounterCount + HistogramCount; ++i )
+    {
+        const quint32 value = quint32( int( ( i < CounterCount ) ? counters[ i ] : sums[ i - CounterCount ] ) );
+        // Unsigned difference survives one wrap of the atomic.
+        totals[ i ] += quint32( value - folded[ i ] );
+        folded[ i ] = value;
+    }
+}
+
+void Metrics::appendProcess( QByteArray & text )
+{
+    double cpu = -1;
+    qint64 resident = -1;
+#ifdef Q_OS_WIN
+    FILETIME creation, exited, kernel, user;
+    if ( GetProcessTimes( GetCurrentProcess(), &creation, &exited, &kernel, &user ) )
+    {
+        const quint64 ticks = ( quint64( kernel.dwHighDateTime ) << 32 ) + kernel.dwLowDateTime +
+                              ( quint64( user.dwHighDateTime ) << 32 ) + user.dwLowDateTime;
+        cpu = ticks / 1e7;
+    }
+#else
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+    {
+        cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+              ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1e6;
+    }
+#endif
+#ifdef Q_OS_LINUX
+    QFile statm( "/proc/self/statm" );
+    if ( statm.open( QIODevice::ReadOnly ) )
+        resident = statm.readAll().split( ' ' ).value( 1 ).toLongLong() * sysconf( _SC_PAGESIZE );
+#endif
+
+    if ( cpu >= 0 )
+    {
+        text += "# HELP process_cpu_seconds_total User and system CPU time.\n"
+                "# TYPE process_cpu_seconds_total counter\n"
+                "process_cpu_seconds_total " + QByteArray::number( cpu, 'f', 3 ) + "\n";
+    }
+    if ( resident >= 0 )
+    {
+        text += "# HELP process_resident_memory_bytes Resident memory size.\n"
+                "# TYPE process_resident_memory_bytes gauge\n"
+                "process_resident_memory_bytes " + QByteArray::number( resident ) + "\n";
+    }
+}
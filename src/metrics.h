@@ -0,0 +1,93 @@
+//
+// Metrics: runtime counters exported in Prometheus text format.
+//
+// Hot paths only do atomic adds ( METRIC_* macros, one test when metrics
+// are off ). Counters are folded into 64-bit totals on every event loop
+// check ( 100 msec ), so 32-bit atomics never wrap. Export runs on own
+// thread with loopback HTTP server, a scrape never waits for GUI thread.
+// Event loop latency is measured by timer lateness on GUI thread.
+//
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+// Histogram buckets ( last one is +Inf ).
+#define METRIC_BUCKETS 8
+
+class MetricsServer;
+
+class Metrics : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Monotonic counters.
+        enum Counter { BufferingEvents, Underruns, Reconnects, Outages, Switches, MetaDataEvents,
+                       StreamBytes, CounterCount };
+        // Current values.
+        enum Gauge { BufferingValue, BufferFill, BufferTarget, GaugeCount };
+        // Duration distributions ( msec ).
+        enum Histogram { FirstAudio, LoopLatency, HistogramCount };
+        // Player states with time spent in each.
+        enum State { Stopped, Playing, Paused, Buffering, Error, StateCount };
+
+        explicit Metrics();
+        ~Metrics();
+
+        static Metrics * instance();
+
+        // Serve metrics on loopback port ( 0 - off ).
+        void start( quint16 port );
+        void stop();
+        static inline bool isEnabled() { return enabled != 0; }
+
+        inline void add( Counter counter, int value ) { counters[ counter ].fetchAndAddRelaxed( value ); }
+        inline void set( Gauge gauge, int value ) { gauges[ gauge ] = value; }
+        void observe( Histogram histogram, int msec );
+        // Player entered state.
+        void setState( State state );
+
+        // Whole exposition text, callable from any thread.
+        QByteArray exposition();
+
+    private slots:
+        // Measure event loop delay, fold counters.
+        void checkLoop();
+
+    private:
+        // Add counter changes since last fold to totals, mutex must be locked.
+        void fold();
+        static void appendProcess( QByteArray & text );
+
+        static Metrics * metrics;
+        // Read by hot paths of any thread.
+        static QAtomicInt enabled;
+        QAtomicInt counters[ CounterCount ];
+        QAtomicInt gauges[ GaugeCount ];
+        // Bucket counts and sums ( msec ) of histograms.
+        QAtomicInt buckets[ HistogramCount ][ METRIC_BUCKETS ];
+        QAtomicInt sums[ HistogramCount ];
+        // Guards totals and state times.
+        QMutex mutex;
+        qint64 totals[ CounterCount + HistogramCount ];
+        quint32 folded[ CounterCount + HistogramCount ];
+        qint64 stateTimes[ StateCount ];
+        State state;
+        QElapsedTimer stateClock;
+        QTimer loopTimer;
+        QElapsedTimer loopClock;
+        MetricsServer * server;
+};
+
+#define METRIC_ADD( c, v ) { if ( Metrics::isEnabled() ) Metrics::instance()->add( Metrics::c, ( v ) ); }
+#define METRIC_SET( g, v ) { if ( Metrics::isEnabled() ) Metrics::instance()->set( Metrics::g, ( v ) ); }
+#define METRIC_OBSERVE( h, v ) { if ( Metrics::isEnabled() ) Metrics::instance()->observe( Metrics::h, ( v ) ); }
+#define METRIC_STATE( s ) { if ( Metrics::isEnabled() ) Metrics::instance()->setState( Metrics::s ); }
+
+#endif
@@ -2,25 +2,119 @@
 // Player.
 //
 #include "player.h"
+#include "icyclient.h"
+#include "streambuffer.h"
 #include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "levelmeter.h"
 
 #include <QUrl>
 #include <QTimer>
-#include <QApplication>
+#include <QDateTime>
 
-// Maximum timeout of station test ( in msec ).
-#define MAX_TEST_TIMEOUT 10000
+// Stream rate assumed until known ( 128 kbit/s ).
+#define DEFAULT_STREAM_RATE 16000
+// Time without underruns before prebuffer shrinks.
+#define HEALTHY_PERIOD 60000
+// Audio kept by standby stream ( in seconds ).
+#define STANDBY_SECONDS 2
+// First reconnect delay and backoff ceiling ( msec ).
+#define RECONNECT_MIN_DELAY 500
+#define RECONNECT_MAX_DELAY 30000
+// Open stream without data this long is reconnected ( msec ).
+#define STALL_TIMEOUT 10000
+// Timeshift jump and audio kept in stream buffer while shifted ( in seconds ).
+#define SHIFT_JUMP_SECONDS 30
+#define SHIFT_FEED_SECONDS 4
+// Bytes copied from timeshift ring at once.
+#define SHIFT_CHUNK 16384
 
 Player::Player( QObject * parent )
     :QObject( parent ),
-     volumeStep( 0.1 )
+     mediaObject( 0 ),
+     audioOutput( 0 ),
+     volume( 0.5 ),
+     volumeStep( 0.1 ),
+     nativeStream( false ),
+     capture( false ),
+     streamBufferSize( 262144 ),
+     streamClient( 0 ),
+     streamBuffer( 0 ),
+     resolver( 0 ),
+     prebufferMin( 500 ),
+     prebufferMax( 8000 ),
+     prebufferLevel( 0 ),
+     underruns( 0 ),
+     lastReceived( 0 ),
+     measuredRate( 0 ),
+     standbyCount( 2 ),
+     standbyKbps( 320 ),
+     switchPending( false ),
+     switchWarm( false ),
+     lastSwitch( -1 ),
+     reconnectAttempts( 8 ),
+     reconnectBudget( 120000 ),
+     reconnectAttempt( 0 ),
+     reconnects( 0 ),
+     outages( 0 ),
+     lastOutageTime( 0 ),
+     totalOutageTime( 0 ),
+     timeshiftMinutes( 0 ),
+     timeshiftLimit( 33554432 ),
+     timeshiftSize( 0 ),
+     shifted( false ),
+     shiftPos( 0 ),
+     levelMeter( 0 ),
+     dataOutput( 0 )
 {
+    statsTimer.setInterval( 1000 );
+    connect( &statsTimer, SIGNAL( timeout() ), SLOT( updateBufferPolicy() ) );
+    reconnectTimer.setSingleShot( true );
+    connect( &reconnectTimer, SIGNAL( timeout() ), SLOT( reconnect() ) );
+    shiftTimer.setInterval( 250 );
+    connect( &shiftTimer, SIGNAL( timeout() ), SLOT( feedShifted() ) );
+
+    // Backoff jitter must differ between running instances.
+    jitterSeed = quint32( QDateTime::currentMSecsSinceEpoch() ) ^ quint32( quintptr( this ) );
+}
+
+void Player::initialize()
+{
+    if ( mediaObject && audioOutput )
+        return;
+
+    // Backend is loaded here, not at program start.
     audioOutput = new Phonon::AudioOutput( Phonon::MusicCategory, this );
     mediaObject = new Phonon::MediaObject( this );
 
     if ( !audioOutput || !mediaObject )
         return;
 
+    connect( mediaObject, SIGNAL( stateChanged( Phonon::State, Phonon::State ) ),
+                          SLOT( stateChanged( Phonon::State, Phonon::State ) ) );
+    connect( mediaObject, SIGNAL( currentSourceChanged( Phonon::MediaSource ) ),
+                          SLOT( sourceChanged( Phonon::MediaSource ) ) );
+    connect( mediaObject, SIGNAL( aboutToFinish() ), SLOT( aboutToFinish() ) );
+    connect( mediaObject, SIGNAL( bufferStatus( int ) ),
+                          SLOT( setBufferingValue( int ) ) );
+    connect( mediaObject, SIGNAL( metaDataChanged() ),
+                          SLOT( processMetaData() ) );
+
+    audioOutput->setVolume( volume );
+
+    Phonon::createPath( mediaObject, audioOutput );
+    applyLevelMeter();
+
+    // Capabilities are only logged, so enumerate them when idle.
+    QTimer::singleShot( 0, this, SLOT( logCapabilities() ) );
+}
+
+void Player::logCapabilities()
+{
+    if ( !LOG_ENABLED( Logger::Information, "player" ) )
+        return;
+
     const QStringList & mimeTypes = Phonon::BackendCapabilities::availableMimeTypes();
     LOG_INFO( "player", tr( "Total MIME types = %1." ).arg( mimeTypes.count() ) );
     int i = 0;
@@ -47,52 +141,265 @@ Player::Player( QObject * parent )
         LOG_INFO( "player", tr( "Effect #%1: %2." ).arg( i ).arg( effect.name() ) );
         i++;
     }
-
-    mediaObject->setTickInterval( 1000 );
-
-    connect( mediaObject, SIGNAL( tick( qint64 ) ), SLOT( tick( qint64 ) ) );
-    connect( mediaObject, SIGNAL( stateChanged( Phonon::State, Phonon::State ) ),
-                          SLOT( stateChanged( Phonon::State, Phonon::State ) ) );
-    connect( mediaObject, SIGNAL( currentSourceChanged( Phonon::MediaSource ) ),
-                          SLOT( sourceChanged( Phonon::MediaSource ) ) );
-    connect( mediaObject, SIGNAL( aboutToFinish() ), SLOT( aboutToFinish() ) );
-    connect( mediaObject, SIGNAL( bufferStatus( int ) ),
-                          SLOT( setBufferingValue( int ) ) );
-    connect( mediaObject, SIGNAL( metaDataChanged() ),
-                          SLOT( processMetaData() ) );
-
-    audioOutput->setVolume( 0.5 );
-
-    Phonon::createPath( mediaObject, audioOutput );
 }
 
 void Player::setFile( const QString & file )
 {
     source = Phonon::MediaSource( file );
+    sourceUrl = QUrl::fromLocalFile( file );
 }
 
 void Player::setUrl( const QUrl & url )
 {
     source = Phonon::MediaSource( url );
+    sourceUrl = url;
+
+    // Buffer policy is per station.
+    prebufferLevel = 0;
+    underruns = 0;
+}
+
+void Player::setNativeStream( bool enabled, int bufferSize )
+{
+    nativeStream = enabled;
+    if ( bufferSize > 0 )
+        streamBufferSize = bufferSize;
+}
+
+void Player::setPrebuffer( int minMsec, int maxMsec )
+{
+    prebufferMin = qMax( 100, minMsec );
+    prebufferMax = qMax( prebufferMin, maxMsec );
+}
+
+// Closed stream's buffer lives on until next source replaces it in backend,
+// its stats are stale then.
+int Player::bufferFill() const
+{
+    return ( streamClient && streamBuffer ) ? int( streamBuffer->fill() ) : 0;
+}
+
+int Player::bufferTarget() const
+{
+    return ( streamClient && streamBuffer ) ? streamBuffer->prebuffer() : 0;
+}
+
+int Player::underrunCount() const
+{
+    return underruns;
+}
+
+int Player::throughput() const
+{
+    return qRound( measuredRate );
+}
+
+void Player::setStandbyLimits( int count, int kbps )
+{
+    standbyCount = qMax( 0, count );
+    standbyKbps = qMax( 0, kbps );
+    checkStandbyBandwidth();
+}
+
+void Player::warmUp( const QList< QUrl > & urls )
+{
+    TRACE_SCOPE( "Player::warmUp" );
+    // Only while own stream plays, stopped player keeps network quiet.
+    QStringList wanted;
+    if ( streamClient )
+    {
+        foreach ( const QUrl & url, urls )
+        {
+            if ( wanted.count() >= standbyCount )
+                break;
+            const QString key = url.toString();
+            if ( ( url != sourceUrl ) && ( url.scheme().toLower() == "http" ) && !wanted.contains( key ) )
+                wanted.append( key );
+        }
+    }
+
+    foreach ( const QString & key, standbyStreams.keys() )
+    {
+        if ( !wanted.contains( key ) )
+            dropStandby( key );
+    }
+
+    foreach ( const QString & key, wanted )
+    {
+        if ( standbyStreams.contains( key ) )
+            continue;
+
+        Standby standby;
+        standby.buffer = new StreamBuffer( DEFAULT_STREAM_RATE * STANDBY_SECONDS, this );
+        standby.client = new IcyClient( standby.buffer, this );
+        standby.client->setResolver( resolver );
+        standby.client->setFaults( faults );
+        connect( standby.client, SIGNAL( failed( const QString & ) ), SLOT( onStandbyFailed() ) );
+        connect( standby.client, SIGNAL( streamStarted() ), SLOT( checkStandbyBandwidth() ) );
+        standbyStreams.insert( key, standby );
+        standby.client->open( QUrl( key ) );
+        LOG_DEBUG( "player", tr( "Standby stream %1 opened." ).arg( key ) );
+    }
+    standbyOrder = wanted;
+}
+
+int Player::switchLatency() const
+{
+    return lastSwitch;
+}
+
+void Player::setReconnectPolicy( int attempts, int budgetMsec )
+{
+    reconnectAttempts = qMax( 0, attempts );
+    reconnectBudget = qMax( 0, budgetMsec );
+}
+
+void Player::setFaults( const IcyClient::Faults & simulated )
+{
+    faults = simulated;
+    if ( streamClient )
+        streamClient->setFaults( faults );
+    foreach ( const Standby & standby, standbyStreams )
+        standby.client->setFaults( faults );
+}
+
+bool Player::isReconnecting() const
+{
+    return reconnectAttempt > 0;
+}
+
+int Player::reconnectCount() const
+{
+    return reconnects;
+}
+
+int Player::outageCount() const
+{
+    return outages;
+}
+
+int Player::lastOutage() const
+{
+    return lastOutageTime;
+}
+
+qint64 Player::outageTime() const
+{
+    return totalOutageTime;
+}
+
+void Player::setCapture( bool enabled )
+{
+    capture = enabled;
+
+    // Backend reads the stream itself, switch to own client.
+    if ( capture && !streamClient && useNativeStream() && ( isPlaying() || isBuffering() ) )
+    {
+        LOG_INFO( "player", tr( "Restarting stream through own client for capture." ) );
+        startPlay();
+    }
+}
+
+void Player::setHostResolver( HostResolver * hostResolver )
+{
+    resolver = hostResolver;
+}
+
+QByteArray Player::streamType() const
+{
+    return streamClient ? streamClient->contentType() : QByteArray();
+}
+
+void Player::setTimeshift( int minutes, int memoryLimit, const QString & spillFile )
+{
+    timeshiftMinutes = qMax( 0, minutes );
+    timeshiftLimit = qMax( 0, memoryLimit );
+    timeshiftFile = spillFile;
+    timeshiftSize = -1;
+    if ( streamClient )
+        applyTimeshift();
+}
+
+bool Player::isShifted() const
+{
+    return shifted;
+}
+
+int Player::timeshiftDelay() const
+{
+    if ( !streamClient || !streamBuffer || ( timeshift.capacity() == 0 ) )
+        return 0;
+
+    // Stream buffer holds bytes just before feed position.
+    const qint64 played = ( shifted ? shiftPos : timeshift.end() ) - streamBuffer->fill();
+    return int( ( timeshift.end() - played ) * 1000 / byteRate() );
+}
+
+int Player::timeshiftLength() const
+{
+    return int( ( timeshift.end() - timeshift.begin() ) * 1000 / byteRate() );
+}
+
+qint64 Player::timeshiftMemory() const
+{
+    return timeshift.memoryUsage();
+}
+
+qint64 Player::timeshiftMapped() const
+{
+    return timeshift.mappedSize();
 }
 
 void Player::startPlay()
 {
+    initialize();
     if ( !mediaObject )
         return;
 
-    mediaObject->setCurrentSource( source );
+    // Own stream keeps running while paused, so just continue.
+    if ( !( streamClient && isPaused() && ( streamUrl == sourceUrl ) ) )
+    {
+        cancelReconnect();
+        switchTimer.start();
+        switchPending = true;
+        switchWarm = false;
+        closeStream();
+        if ( useNativeStream() )
+            openStream();
+        else
+            mediaObject->setCurrentSource( source );
+    }
     mediaObject->play();
+    if ( shifted )
+    {
+        // Continue from timeshift ring where pause left off.
+        feedShifted();
+        shiftTimer.start();
+    }
     emit playing();
     LOG_INFO( "player", tr( "Start play." ) );
 }
 
+void Player::switchTo( const QUrl & url )
+{
+    const bool active = isPlaying() || isPaused() || isBuffering();
+    setUrl( url );
+    if ( active )
+        startPlay();
+}
+
 void Player::pausePlay()
 {
     if ( !mediaObject )
         return;
 
+    // Own stream reconnects while paused, backend one would start playing.
+    if ( !streamClient )
+        cancelReconnect();
     mediaObject->pause();
+    // Live audio goes on into timeshift ring only.
+    enterShift();
+    shiftTimer.stop();
     emit paused();
     LOG_INFO( "player", tr( "Pause play." ) );
 }
@@ -115,42 +422,72 @@ void Player::stopPlay()
 
     mediaObject->stop();
     mediaObject->clearQueue();
+    closeStream();
+    clearStandby();
+    cancelReconnect();
+    switchPending = false;
     emit stopped();
     LOG_INFO( "player", tr( "Stop play." ) );
 }
 
 void Player::volumeUp()
 {
-    if ( !audioOutput )
-        return;
-
-    setVolume( audioOutput->volume() + volumeStep );
+    setVolume( ( audioOutput ? audioOutput->volume() : volume ) + volumeStep );
 }
 
 void Player::volumeDown()
 {
-    if ( !audioOutput )
-        return;
-
-    setVolume( audioOutput->volume() - volumeStep );
+    setVolume( ( audioOutput ? audioOutput->volume() : volume ) - volumeStep );
 }
 
 void Player::setVolume( qreal level )
 {
-    if ( !audioOutput )
-        return;
-
     if ( level < 0.0 )
         level = 0.0;
     else if ( level > 1.0 )
         level = 1.0;
-    audioOutput->setVolume( level );
+    volume = level;
+    if ( audioOutput )
+        audioOutput->setVolume( level );
     level = qRound( 100.0 * level );
     emit volumeChanged( level );
 
     LOG_INFO( "player", tr( "Volume changed to %1." ).arg( level ) );
 }
 
+void Player::setLevelMeter( LevelMeter * meter )
+{
+    levelMeter = meter;
+    if ( mediaObject )
+        applyLevelMeter();
+}
+
+void Player::applyLevelMeter()
+{
+    if ( levelMeter && !dataOutput )
+    {
+        dataOutput = new Phonon::AudioDataOutput( this );
+        dataOutput->setDataSize( LevelMeter::blockSize() );
+        connect( dataOutput, SIGNAL( dataReady( const QMap< Phonon::AudioDataOutput::Channel, QVector< qint16 > > & ) ),
+                 levelMeter, SLOT( addData( const QMap< Phonon::AudioDataOutput::Channel, QVector< qint16 > > & ) ) );
+        dataPath = Phonon::createPath( mediaObject, dataOutput );
+        if ( !dataPath.isValid() )
+            LOG_WARN( "player", tr( "Backend has no audio data output, level meter gets no audio." ) );
+    }
+    else if ( !levelMeter && dataOutput )
+    {
+        // Backend stops copying audio out.
+        dataPath.disconnect();
+        delete dataOutput;
+        dataOutput = 0;
+    }
+}
+
+qreal Player::getVolume() const
+{
+    return audioOutput ? audioOutput->volume() : volume;
+}
+
 void Player::setVolumeStep( qreal step )
 {
     if ( step <= 0 )
@@ -163,15 +500,18 @@ void Player::setVolumeStep( qreal step )
 
 void Player::stateChanged( Phonon::State newState, Phonon::State oldState )
 {
-    Q_UNUSED( oldState );
+    TRACE_SCOPE( "Player::stateChanged" );
 
     LOG_INFO( "player", tr( "Phonon state changed to %1." ).arg( newState ) );
     if ( newState == Phonon::ErrorState )
     {
         LOG_DEBUG( "player", tr( "Error state." ) );
+        METRIC_STATE( Error );
+        bool fatal = true;
         if ( mediaObject )
         {
-            if ( mediaObject->errorType() == Phonon::FatalError )
+            fatal = ( mediaObject->errorType() == Phonon::FatalError );
+            if ( fatal )
                 LOG_ERROR( "player", tr( "Fatal error \"%1\"!" ).arg( mediaObject->errorString() ) )
             else
                 LOG_ERROR( "player", tr( "Error \"%1\"!" ).arg( mediaObject->errorString() ) );
@@ -179,28 +519,54 @@ void Player::stateChanged( Phonon::State newState, Phonon::State oldState )
         else
             LOG_WARN( "player", tr( "No media object!" ) );
 
-        emit errorOccured();
+        // Normal errors ( network, server ) are worth another try.
+        if ( !scheduleReconnect( fatal ) )
+            emit errorOccured();
     }
     else if ( newState == Phonon::PlayingState )
     {
         LOG_DEBUG( "player", tr( "Playing state." ) );
+        TRACE_INSTANT( "playing" );
+        METRIC_STATE( Playing );
+        emit audioStarted();
+        finishReconnect();
+        if ( switchPending )
+        {
+            switchPending = false;
+            lastSwitch = int( switchTimer.elapsed() );
+            TRACE_COUNTER( "switch latency", lastSwitch );
+            METRIC_ADD( Switches, 1 );
+            METRIC_OBSERVE( FirstAudio, lastSwitch );
+            LOG_INFO( "player", tr( "Switched in %1 msec ( %2 )." ).arg( lastSwitch )
+                                .arg( switchWarm ? tr( "standby stream" ) : tr( "cold start" ) ) );
+            emit switched( lastSwitch, switchWarm );
+        }
     }
     else if ( newState == Phonon::StoppedState )
     {
         LOG_DEBUG( "player", tr( "Stopped state." ) );
+        METRIC_STATE( Stopped );
     }
     else if ( newState == Phonon::PausedState )
     {
         LOG_DEBUG( "player", tr( "Paused state." ) );
+        METRIC_STATE( Paused );
     }
     else if ( newState == Phonon::BufferingState )
     {
-        LOG_DEBUG( "player", tr( "Buffering state." ) );        
+        LOG_DEBUG( "player", tr( "Buffering state." ) );
+        METRIC_STATE( Buffering );
+        METRIC_ADD( BufferingEvents, 1 );
+        if ( oldState == Phonon::PlayingState )
+            onUnderrun();
     }
 }
 
 void Player::setBufferingValue( int value )
 {
+    TRACE_SCOPE( "Player::setBufferingValue" );
+    TRACE_COUNTER( "buffering", value );
+    METRIC_SET( BufferingValue, value );
     LOG_INFO( "player", tr( "Buffering %1." ).arg( value ) );
     emit buffering( value );
 }
@@ -210,27 +576,457 @@ void Player::sourceChanged( const Phonon::MediaSource & source )
     LOG_INFO( "player", tr( "Source changed %1." ).arg( source.fileName() ) );
 }
 
-void Player::tick( qint64 time )
-{
-    emit playerTick( time );
-}
-
 void Player::aboutToFinish()
 {
 }
 
 void Player::processMetaData()
 {
-    if ( !mediaObject )
+    TRACE_SCOPE( "Player::processMetaData" );
+    // Own stream has meta data stripped, titles come from ICY client.
+    if ( !mediaObject || streamClient )
         return;
 
     LOG_INFO( "player", tr( "New meta data." ) );
+    METRIC_ADD( MetaDataEvents, 1 );
     emit metaDataChanged( mediaObject->metaData() );
 }
 
+void Player::processStreamTitle( const QByteArray & title )
+{
+    TRACE_SCOPE( "Player::processStreamTitle" );
+    LOG_INFO( "player", tr( "New stream title." ) );
+    METRIC_ADD( MetaDataEvents, 1 );
+
+    // Raw bytes are kept as Latin-1 characters, decoded with station codec later.
+    QMultiMap< QString, QString > data;
+    const int separator = title.indexOf( " - " );
+    if ( separator > 0 )
+    {
+        data.insert( "ARTIST", QString::fromLatin1( title.left( separator ) ) );
+        data.insert( "TITLE", QString::fromLatin1( title.mid( separator + 3 ) ) );
+    }
+    else
+        data.insert( "TITLE", QString::fromLatin1( title ) );
+    emit metaDataChanged( data );
+}
+
+void Player::onStreamFailed( const QString & reason )
+{
+    LOG_ERROR( "player", tr( "Stream error \"%1\"!" ).arg( reason ) );
+
+    // Buffered audio keeps playing while the client reconnects.
+    if ( scheduleReconnect( streamClient && streamClient->isRefused() ) )
+        return;
+
+    if ( streamBuffer )
+        streamBuffer->finish();
+    emit errorOccured();
+}
+
+bool Player::useNativeStream() const
+{
+    // Recording and timeshift need stream bytes, only own client has them.
+    return ( nativeStream || capture || ( timeshiftMinutes > 0 ) ) && ( sourceUrl.scheme().toLower() == "http" );
+}
+
+void Player::openStream()
+{
+    TRACE_SCOPE( "Player::openStream" );
+    StreamBuffer * previous = streamBuffer;
+    streamUrl = sourceUrl;
+    const QString key = sourceUrl.toString();
+    if ( standbyStreams.contains( key ) )
+    {
+        // Connected and filled already, take it over.
+        const Standby standby = standbyStreams.take( key );
+        standbyOrder.removeAll( key );
+        standby.client->disconnect( this );
+        streamClient = standby.client;
+        streamBuffer = standby.buffer;
+        streamBuffer->setCapacity( streamBufferSize );
+        switchWarm = true;
+    }
+    else
+    {
+        streamBuffer = new StreamBuffer( streamBufferSize, this );
+        streamClient = new IcyClient( streamBuffer, this );
+        streamClient->setResolver( resolver );
+        streamClient->setFaults( faults );
+    }
+    connect( streamClient, SIGNAL( titleReceived( const QByteArray & ) ),
+                           SLOT( processStreamTitle( const QByteArray & ) ) );
+    connect( streamClient, SIGNAL( failed( const QString & ) ),
+                           SLOT( onStreamFailed( const QString & ) ) );
+    connect( streamClient, SIGNAL( streamStarted() ), SLOT( onStreamStarted() ) );
+    connect( streamClient, SIGNAL( audioReceived( const QByteArray &, int, int ) ),
+                           SIGNAL( streamData( const QByteArray &, int, int ) ) );
+    connect( streamClient, SIGNAL( audioReceived( const QByteArray &, int, int ) ),
+                           SLOT( storeAudio( const QByteArray &, int, int ) ) );
+    timeshift.clear();
+    applyTimeshift();
+    connect( streamBuffer, SIGNAL( priming( int ) ), SLOT( setBufferingValue( int ) ) );
+
+    lastReceived = streamClient->bytesReceived();
+    measuredRate = 0;
+    applyPrebuffer();
+    healthyTime.start();
+    stallTime.start();
+    statsTimer.start();
+    if ( !switchWarm )
+        streamClient->open( sourceUrl );
+    mediaObject->setCurrentSource( Phonon::MediaSource( streamBuffer ) );
+
+    // Backend has let the old buffer go now.
+    if ( previous )
+        previous->deleteLater();
+}
+
+void Player::closeStream()
+{
+    if ( !streamClient )
+        return;
+
+    statsTimer.stop();
+    shiftTimer.stop();
+    shifted = false;
+    streamClient->close();
+    streamClient->deleteLater();
+    streamClient = 0;
+    if ( streamBuffer )
+        streamBuffer->finish();
+    METRIC_SET( BufferFill, 0 );
+    METRIC_SET( BufferTarget, 0 );
+    emit bufferStats( 0, 0, underruns );
+}
+
+void Player::onStandbyFailed()
+{
+    foreach ( const QString & key, standbyStreams.keys() )
+    {
+        if ( standbyStreams.value( key ).client == sender() )
+            dropStandby( key );
+    }
+}
+
+void Player::checkStandbyBandwidth()
+{
+    int total = 0;
+    foreach ( const QString & key, standbyOrder )
+    {
+        const IcyClient * client = standbyStreams.value( key ).client;
+        total += ( client && ( client->bitrate() > 0 ) ) ? client->bitrate() : DEFAULT_STREAM_RATE * 8 / 1000;
+    }
+
+    // Least likely streams go first.
+    while ( ( ( total > standbyKbps ) || ( standbyOrder.count() > standbyCount ) ) && !standbyOrder.isEmpty() )
+    {
+        const QString key = standbyOrder.last();
+        const IcyClient * client = standbyStreams.value( key ).client;
+        total -= ( client && ( client->bitrate() > 0 ) ) ? client->bitrate() : DEFAULT_STREAM_RATE * 8 / 1000;
+        dropStandby( key );
+    }
+}
+
+void Player::dropStandby( const QString & url )
+{
+    if ( !standbyStreams.contains( url ) )
+        return;
+
+    const Standby standby = standbyStreams.take( url );
+    standbyOrder.removeAll( url );
+    standby.client->close();
+    standby.client->deleteLater();
+    standby.buffer->deleteLater();
+    LOG_DEBUG( "player", tr( "Standby stream %1 closed." ).arg( url ) );
+}
+
+void Player::clearStandby()
+{
+    foreach ( const QString & key, standbyStreams.keys() )
+        dropStandby( key );
+}
+
+void Player::onStreamStarted()
+{
+    applyPrebuffer();
+    applyTimeshift();
+    finishReconnect();
+    if ( streamClient )
+        emit streamOpened( streamClient->contentType() );
+}
+
+void Player::reconnect()
+{
+    TRACE_SCOPE( "Player::reconnect" );
+    if ( !mediaObject || ( reconnectAttempt == 0 ) )
+        return;
+
+    ++reconnects;
+    METRIC_ADD( Reconnects, 1 );
+    LOG_INFO( "player", tr( "Reconnecting to %1 ( attempt #%2 )." )
+                        .arg( sourceUrl.toString() ).arg( reconnectAttempt ) );
+    if ( streamClient && !isError() )
+    {
+        // Backend still plays buffered audio, only network is restarted.
+        streamClient->open( streamUrl );
+        return;
+    }
+
+    switchWarm = false;
+    closeStream();
+    if ( useNativeStream() )
+        openStream();
+    else
+        mediaObject->setCurrentSource( source );
+    mediaObject->play();
+}
+
+bool Player::scheduleReconnect( bool fatal )
+{
+    if ( reconnectAttempt == 0 )
+        outageTimer.start();
+
+    if ( fatal || ( reconnectAttempt >= reconnectAttempts ) || ( outageTimer.elapsed() >= reconnectBudget ) )
+    {
+        if ( reconnectAttempt > 0 )
+        {
+            lastOutageTime = int( outageTimer.elapsed() );
+            totalOutageTime += lastOutageTime;
+            ++outages;
+            METRIC_ADD( Outages, 1 );
+            LOG_ERROR( "player", tr( "Stream lost, gave up after %1 attempts ( %2 msec )." )
+                                 .arg( reconnectAttempt ).arg( lastOutageTime ) );
+        }
+        cancelReconnect();
+        return false;
+    }
+
+    // Exponential backoff, random half spreads clients hit by the same outage.
+    const int backoff = qMin( RECONNECT_MIN_DELAY << qMin( reconnectAttempt, 16 ), RECONNECT_MAX_DELAY );
+    // Own generator ( LCG ), global qrand() sequence is left alone.
+    jitterSeed = jitterSeed * 1664525u + 1013904223u;
+    const int delay = backoff / 2 + int( ( jitterSeed >> 8 ) % quint32( backoff / 2 + 1 ) );
+    ++reconnectAttempt;
+    reconnectTimer.start( delay );
+    TRACE_INSTANT( "reconnect scheduled" );
+    LOG_WARN( "player", tr( "Reconnect attempt #%1 in %2 msec." ).arg( reconnectAttempt ).arg( delay ) );
+    emit reconnecting( reconnectAttempt, delay );
+    return true;
+}
+
+void Player::finishReconnect()
+{
+    if ( reconnectAttempt == 0 )
+        return;
+
+    const int attempts = reconnectAttempt;
+    lastOutageTime = int( outageTimer.elapsed() );
+    totalOutageTime += lastOutageTime;
+    ++outages;
+    METRIC_ADD( Outages, 1 );
+    cancelReconnect();
+    TRACE_COUNTER( "outage", lastOutageTime );
+    LOG_INFO( "player", tr( "Stream is back after %1 msec ( %2 attempts )." ).arg( lastOutageTime ).arg( attempts ) );
+    emit reconnected( attempts, lastOutageTime );
+}
+
+void Player::cancelReconnect()
+{
+    reconnectTimer.stop();
+    reconnectAttempt = 0;
+}
+
+void Player::updateBufferPolicy()
+{
+    TRACE_SCOPE( "Player::updateBufferPolicy" );
+    if ( !streamClient || !streamBuffer )
+        return;
+
+    const qint64 received = streamClient->bytesReceived();
+    const qint64 delta = received - lastReceived;
+    lastReceived = received;
+    measuredRate = ( measuredRate > 0 ) ? ( 0.8 * measuredRate + 0.2 * delta ) : delta;
+
+    // Stalled connection ( no data, no close ) is never reported by socket.
+    if ( ( delta > 0 ) || !streamClient->isOpen() )
+        stallTime.restart();
+    else if ( stallTime.hasExpired( STALL_TIMEOUT ) )
+    {
+        streamClient->close();
+        onStreamFailed( tr( "No data for %1 msec." ).arg( STALL_TIMEOUT ) );
+        return;
+    }
+
+    if ( ( prebufferLevel > 0 ) && ( healthyTime.elapsed() > HEALTHY_PERIOD ) )
+    {
+        --prebufferLevel;
+        healthyTime.restart();
+        applyPrebuffer();
+        LOG_INFO( "player", tr( "Stream is stable, prebuffer lowered to %1 bytes." ).arg( streamBuffer->prebuffer() ) );
+    }
+
+    TRACE_COUNTER( "stream fill", streamBuffer->fill() );
+    METRIC_SET( BufferFill, bufferFill() );
+    METRIC_SET( BufferTarget, bufferTarget() );
+    emit bufferStats( bufferFill(), bufferTarget(), underruns );
+    if ( shifted )
+        emit timeshiftChanged( timeshiftDelay() );
+}
+
+void Player::onUnderrun()
+{
+    ++underruns;
+    METRIC_ADD( Underruns, 1 );
+    healthyTime.restart();
+    if ( ( prebufferMin << ( prebufferLevel + 1 ) ) <= prebufferMax )
+        ++prebufferLevel;
+    TRACE_INSTANT( "underrun" );
+
+    if ( streamBuffer && streamClient )
+    {
+        applyPrebuffer();
+        streamBuffer->rebuffer();
+        LOG_WARN( "player", tr( "Stream underrun #%1, prebuffer raised to %2 bytes." )
+                            .arg( underruns ).arg( streamBuffer->prebuffer() ) );
+    }
+}
+
+void Player::applyPrebuffer()
+{
+    if ( !streamBuffer )
+        return;
+
+    const int rate = byteRate();
+    int msec = qMin( prebufferMin << prebufferLevel, prebufferMax );
+
+    // Link barely faster than stream leaves no margin, keep more.
+    if ( ( measuredRate > 0 ) && ( measuredRate < rate * 1.1 ) )
+        msec = qMin( msec * 2, prebufferMax );
+
+    streamBuffer->setPrebuffer( int( qint64( rate ) * msec / 1000 ) );
+    TRACE_COUNTER( "prebuffer", streamBuffer->prebuffer() );
+}
+
+int Player::byteRate() const
+{
+    return ( streamClient && ( streamClient->bitrate() > 0 ) ) ?
+           streamClient->bitrate() * 1000 / 8 : DEFAULT_STREAM_RATE;
+}
+
+void Player::storeAudio( const QByteArray & chunk, int offset, int length )
+{
+    timeshift.append( chunk.constData() + offset, length );
+}
+
+void Player::enterShift()
+{
+    if ( shifted || !streamClient || ( timeshift.capacity() == 0 ) )
+        return;
+
+    shifted = true;
+    shiftPos = timeshift.end();
+    streamClient->setBuffer( 0 );
+    LOG_DEBUG( "player", tr( "Timeshift on." ) );
+}
+
+void Player::jumpBack()
+{
+    TRACE_SCOPE( "Player::jumpBack" );
+    if ( !streamClient || !streamBuffer || ( timeshift.capacity() == 0 ) )
+        return;
+
+    const qint64 played = ( shifted ? shiftPos : timeshift.end() ) - streamBuffer->fill();
+    enterShift();
+    shiftPos = qMax( timeshift.begin(), played - qint64( SHIFT_JUMP_SECONDS ) * byteRate() );
+    streamBuffer->clear();
+    feedShifted();
+    if ( shifted && !isPaused() )
+        shiftTimer.start();
+    LOG_INFO( "player", tr( "Jumped back, %1 msec behind live." ).arg( timeshiftDelay() ) );
+    emit timeshiftChanged( timeshiftDelay() );
+}
+
+void Player::goLive()
+{
+    TRACE_SCOPE( "Player::goLive" );
+    if ( !shifted || !streamClient || !streamBuffer )
+        return;
+
+    // Start from last prebuffer of live audio, so there is no wait.
+    shiftTimer.stop();
+    streamBuffer->clear();
+    shiftPos = qMax( timeshift.begin(), timeshift.end() - streamBuffer->prebuffer() );
+    while ( shiftPos < timeshift.end() )
+    {
+        const QByteArray chunk = timeshift.read( shiftPos, SHIFT_CHUNK );
+        if ( chunk.isEmpty() )
+            break;
+        streamBuffer->append( chunk, 0, chunk.size() );
+        shiftPos += chunk.size();
+    }
+    shifted = false;
+    streamClient->setBuffer( streamBuffer );
+    LOG_INFO( "player", tr( "Back to live." ) );
+    emit timeshiftChanged( 0 );
+
+    if ( isPaused() )
+        startPlay();
+}
+
+void Player::feedShifted()
+{
+    if ( !shifted || !streamClient || !streamBuffer )
+        return;
+
+    if ( shiftPos < timeshift.begin() )
+    {
+        LOG_WARN( "player", tr( "Paused longer than timeshift window, %1 bytes lost." )
+                            .arg( timeshift.begin() - shiftPos ) );
+        shiftPos = timeshift.begin();
+    }
+
+    const qint64 wanted = qMin< qint64 >( qint64( SHIFT_FEED_SECONDS ) * byteRate(), streamBuffer->capacity() / 2 );
+    while ( ( streamBuffer->fill() < wanted ) && ( shiftPos < timeshift.end() ) )
+    {
+        const QByteArray chunk = timeshift.read( shiftPos, SHIFT_CHUNK );
+        if ( chunk.isEmpty() )
+            break;
+        streamBuffer->append( chunk, 0, chunk.size() );
+        shiftPos += chunk.size();
+    }
+
+    // Ring is played out up to live edge, live feed takes over.
+    if ( shiftPos >= timeshift.end() )
+    {
+        shiftTimer.stop();
+        shifted = false;
+        streamClient->setBuffer( streamBuffer );
+        LOG_DEBUG( "player", tr( "Timeshift caught up with live." ) );
+        emit timeshiftChanged( 0 );
+    }
+}
+
+void Player::applyTimeshift()
+{
+    const qint64 bytes = qint64( timeshiftMinutes ) * 60 * byteRate();
+    if ( bytes == timeshiftSize )
+        return;
+
+    // Resizing drops content, done when bitrate becomes known.
+    timeshiftSize = bytes;
+    timeshift.setCapacity( bytes, timeshiftLimit, timeshiftFile );
+    if ( shifted )
+        shiftPos = timeshift.end();
+    if ( bytes > 0 )
+        LOG_INFO( "player", tr( "Timeshift: %1 msec, %2 bytes in memory, %3 bytes mapped." )
+                            .arg( timeshift.capacity() * 1000 / byteRate() )
+                            .arg( timeshift.memoryUsage() ).arg( timeshift.mappedSize() ) );
+}
+
 QString Player::getSource() const
 {
-    return source.url().toString();
+    return sourceUrl.toString();
 }
 
 bool Player::isPlaying()
@@ -272,39 +1068,3 @@ bool Player::isBuffering()
 
     return ( mediaObject->state() == Phonon::BufferingState );
 }
-
-bool Player::checkSource( const QString & source )
-{
-    if ( source.isEmpty() )
-        return false;
-
-    Player testPlayer;
-    QTimer timer;
-    bool ret = false;
-
-    LOG_DEBUG( "player", tr( "Testing url %1." ).arg( source ) );
-    testPlayer.setUrl( QUrl( source ) );
-    testPlayer.setVolume( 0 );
-    testPlayer.startPlay();
-    timer.start( MAX_TEST_TIMEOUT );
-    while( timer.isActive() )
-    {
-        qApp->processEvents();
-
-        if ( testPlayer.isError() )
-        {
-            ret = false;
-            break;
-        }
-        else if ( testPlayer.isPlaying() || testPlayer.isBuffering() )
-        {
-            testPlayer.stopPlay();
-            ret = true;
-            break;
-        }
-    }
-    timer.stop();
-    LOG_DEBUG( "player", tr( "Url check result: %1." ).arg( ret ) );
-
-    return ret;
-}
@@ -5,6 +5,11 @@
 #define PLAYER_H
 
 #include <QObject>
+#include <QUrl>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
 
 #include <phonon/audiooutput.h>
 #include <phonon/seekslider.h>
@@ -12,6 +17,15 @@
 #include <phonon/volumeslider.h>
 #include <phonon/backendcapabilities.h>
 #include <phonon/objectdescription.h>
+#include <phonon/audiodataoutput.h>
+#include <phonon/path.h>
+
+#include "timeshift.h"
+#include "icyclient.h"
+
+class StreamBuffer;
+class HostResolver;
+class LevelMeter;
 
 class Player : public QObject
 {
@@ -23,43 +37,231 @@ class Player : public QObject
         void setUrl( const QUrl & url );
         QString getSource() const;
         void setVolume( qreal level );
+        qreal getVolume() const;
         void setVolumeStep( qreal step );
         bool isPlaying();
         bool isPaused();
         bool isStopped();
         bool isError();
         bool isBuffering();
-        static bool checkSource( const QString & source );
+        // Read http streams with own ICY client ( buffer size in bytes ).
+        void setNativeStream( bool enabled, int bufferSize );
+        // Prebuffer bounds ( in msec of audio ) for own stream.
+        void setPrebuffer( int minMsec, int maxMsec );
+        // Stream buffer state ( bytes ).
+        int bufferFill() const;
+        int bufferTarget() const;
+        // Backend ran dry while playing.
+        int underrunCount() const;
+        // Measured stream throughput ( bytes/s ).
+        int throughput() const;
+        // Standby stream limits: count and total bitrate ( kbit/s ).
+        void setStandbyLimits( int count, int kbps );
+        // Keep streams of urls connected for fast switch ( most likely first ).
+        void warmUp( const QList< QUrl > & urls );
+        // Time from last switch start to audio ( msec ).
+        int switchLatency() const;
+        // Reconnect limits: attempts per outage and outage length ( msec ).
+        void setReconnectPolicy( int attempts, int budgetMsec );
+        // Simulated network faults of own and standby streams ( applied at once ).
+        void setFaults( const IcyClient::Faults & simulated );
+        bool isReconnecting() const;
+        // Reconnect attempts made and outages survived since start.
+        int reconnectCount() const;
+        int outageCount() const;
+        // Outage durations ( msec ): last one and sum of all.
+        int lastOutage() const;
+        qint64 outageTime() const;
+        // Play http streams through own client even if native stream is off,
+        // so stream data is available ( recording ).
+        void setCapture( bool enabled );
+        // Address cache and early connections for own stream client.
+        void setHostResolver( HostResolver * hostResolver );
+        // Content type of own stream ( empty if unknown ).
+        QByteArray streamType() const;
+        // Keep last minutes of own stream for pause and jump back
+        // ( memory limit in bytes, longer window is mapped from spill file ).
+        void setTimeshift( int minutes, int memoryLimit, const QString & spillFile );
+        // Playback is behind live edge.
+        bool isShifted() const;
+        // Delay behind live and audio available behind it ( msec ).
+        int timeshiftDelay() const;
+        int timeshiftLength() const;
+        // Timeshift ring: heap bytes and mapped bytes.
+        qint64 timeshiftMemory() const;
+        qint64 timeshiftMapped() const;
+        // Feed played audio to meter ( 0 - no audio tap ).
+        void setLevelMeter( LevelMeter * meter );
 
     public slots:
+        // Create media pipeline ( loads Phonon backend ), done on first play if not called.
+        void initialize();
         void startPlay();
+        // Change station, playing goes on with new one ( standby stream if warm ).
+        void switchTo( const QUrl & url );
         void pausePlay();
         void stopPlay();
         void playOrPause();
         void volumeUp();
         void volumeDown();
+        // Timeshift: 30 seconds back, back to live edge.
+        void jumpBack();
+        void goLive();
         void stateChanged( Phonon::State newState, Phonon::State oldState );
         void sourceChanged( const Phonon::MediaSource & source );
         void aboutToFinish();
         void setBufferingValue( int value );
-        void tick( qint64 time );
         void processMetaData();
 
+    private slots:
+        // Log backend capabilities.
+        void logCapabilities();
+        // Title from ICY client.
+        void processStreamTitle( const QByteArray & title );
+        void onStreamFailed( const QString & reason );
+        // Resize prebuffer to stream bitrate.
+        void onStreamStarted();
+        // Measure throughput, shrink prebuffer after healthy period.
+        void updateBufferPolicy();
+        void onStandbyFailed();
+        // Drop least likely standby streams over bandwidth limit.
+        void checkStandbyBandwidth();
+        // Backoff delay passed, try stream again.
+        void reconnect();
+        // Keep own stream audio in timeshift ring.
+        void storeAudio( const QByteArray & chunk, int offset, int length );
+        // Feed stream buffer from timeshift ring.
+        void feedShifted();
+
     signals:
-        void playerTick( quint64 time );
         void playing();
+        // Backend entered playing state ( audio is heard ).
+        void audioStarted();
         void paused();
         void stopped();
         void errorOccured();
         void buffering( int state );
         void volumeChanged( int volume );
         void metaDataChanged( const QMultiMap< QString, QString > & data );
+        // Buffer state, sent every second while own stream runs.
+        void bufferStats( int fill, int target, int underruns );
+        // Switch finished, audio is playing ( warm - standby stream used ).
+        void switched( int msec, bool warm );
+        // Stream lost, next attempt after delay ( msec ).
+        void reconnecting( int attempt, int delay );
+        // Stream is back after outage ( msec ).
+        void reconnected( int attempts, int outage );
+        // Own stream accepted by server.
+        void streamOpened( const QByteArray & contentType );
+        // Compressed audio of own stream as received.
+        void streamData( const QByteArray & chunk, int offset, int length );
+        // Playback delay behind live changed ( msec, 0 - live ).
+        void timeshiftChanged( int delay );
 
     private:
+        // Is source played through own ICY client.
+        bool useNativeStream() const;
+        // Start ICY client and set its buffer as current source.
+        void openStream();
+        // Stop ICY client ( buffer is kept until source is replaced ).
+        void closeStream();
+        // Backend ran dry: grow prebuffer.
+        void onUnderrun();
+        // Set prebuffer for current level, bitrate and throughput.
+        void applyPrebuffer();
+        // Stream bytes per second ( from bitrate ).
+        int byteRate() const;
+        // Stop live feed, stream buffer is fed from ring.
+        void enterShift();
+        // Size ring for stream bitrate.
+        void applyTimeshift();
+        // Close and forget standby stream.
+        void dropStandby( const QString & url );
+        void clearStandby();
+        // Plan next attempt, false if error is fatal or budget is spent.
+        bool scheduleReconnect( bool fatal );
+        // Stream is back, close outage.
+        void finishReconnect();
+        // User action overrides pending attempt.
+        void cancelReconnect();
+        // Create or remove audio tap for level meter.
+        void applyLevelMeter();
+
         Phonon::MediaObject * mediaObject;
         Phonon::AudioOutput * audioOutput;
         Phonon::MediaSource   source;
+        QUrl sourceUrl;
+        // Url of own stream ( may differ from source after switch ).
+        QUrl streamUrl;
+        // Volume to apply when pipeline is created.
+        qreal volume;
         qreal volumeStep;
+        bool nativeStream;
+        bool capture;
+        int streamBufferSize;
+        IcyClient * streamClient;
+        StreamBuffer * streamBuffer;
+        HostResolver * resolver;
+        IcyClient::Faults faults;
+        // Prebuffer is minimum doubled "level" times.
+        int prebufferMin;
+        int prebufferMax;
+        int prebufferLevel;
+        int underruns;
+        qint64 lastReceived;
+        // Averaged bytes per second.
+        qreal measuredRate;
+        QTimer statsTimer;
+        // Time since last underrun.
+        QElapsedTimer healthyTime;
+        // Time since open stream last received data.
+        QElapsedTimer stallTime;
+
+        // Connected stream waiting to be played.
+        struct Standby
+        {
+            Standby() : client( 0 ), buffer( 0 ) {}
+
+            IcyClient * client;
+            StreamBuffer * buffer;
+        };
+        QHash< QString, Standby > standbyStreams;
+        // Standby urls, most likely first.
+        QStringList standbyOrder;
+        int standbyCount;
+        int standbyKbps;
+        QElapsedTimer switchTimer;
+        bool switchPending;
+        bool switchWarm;
+        int lastSwitch;
+
+        int reconnectAttempts;
+        int reconnectBudget;
+        // Attempt of current outage ( 0 - no outage ).
+        int reconnectAttempt;
+        QTimer reconnectTimer;
+        // State of backoff jitter generator.
+        quint32 jitterSeed;
+        QElapsedTimer outageTimer;
+        int reconnects;
+        int outages;
+        int lastOutageTime;
+        qint64 totalOutageTime;
+
+        Timeshift timeshift;
+        int timeshiftMinutes;
+        int timeshiftLimit;
+        // Requested ring size ( bytes ).
+        qint64 timeshiftSize;
+        QString timeshiftFile;
+        bool shifted;
+        // Next ring position for stream buffer.
+        qint64 shiftPos;
+        QTimer shiftTimer;
+
+        LevelMeter * levelMeter;
+        Phonon::AudioDataOutput * dataOutput;
+        Phonon::Path dataPath;
 };
 
 #endif
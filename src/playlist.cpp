@@ -0,0 +1,291 @@
+//
+// Playlist files ( M3U, PLS, XSPF ) reading and writing.
+//
+#include "playlist.h"
+#include "logger.h"
+
+#include <QMap>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+// M3U extension tags for fields unknown to other players.
+#define M3U_DESCRIPTION_TAG "#QRADIOTRAY-DESCRIPTION:"
+#define M3U_ENCODING_TAG "#QRADIOTRAY-ENCODING:"
+// XSPF meta relation for station encoding.
+#define XSPF_ENCODING_REL "http://qradiotray/encoding"
+// Encoding of station without one.
+#define DEFAULT_ENCODING "UTF-8"
+
+Playlist::Format Playlist::formatOf( const QString & fileName )
+{
+    const QString suffix = QFileInfo( fileName ).suffix().toLower();
+    if ( ( suffix == "m3u" ) || ( suffix == "m3u8" ) )
+        return M3U;
+    else if ( suffix == "pls" )
+        return PLS;
+    else if ( suffix == "xspf" )
+        return XSPF;
+
+    return Unknown;
+}
+
+QString Playlist::fileFilter()
+{
+    return tr( "Playlists (*.m3u *.m3u8 *.pls *.xspf);;"
+               "M3U playlist (*.m3u *.m3u8);;"
+               "PLS playlist (*.pls);;"
+               "XSPF playlist (*.xspf)" );
+}
+
+bool Playlist::read( const QString & fileName, QList< Station > & stations )
+{
+    const Format format = formatOf( fileName );
+    if ( format == Unknown )
+    {
+        LOG_WARN( "playlist", tr( "Unknown playlist format of %1." ).arg( fileName ) );
+        return false;
+    }
+
+    QFile file( fileName );
+    if ( !file.open( QFile::ReadOnly ) )
+    {
+        LOG_WARN( "playlist", tr( "Can't open playlist %1." ).arg( fileName ) );
+        return false;
+    }
+
+    bool ret = true;
+    if ( format == XSPF )
+        ret = readXSPF( &file, stations );
+    else
+    {
+        QTextStream in( &file );
+        in.setCodec( "UTF-8" );
+        if ( format == M3U )
+            readM3U( in, stations );
+        else
+            readPLS( in, stations );
+    }
+
+    LOG_INFO( "playlist", tr( "Read %1 stations from %2." ).arg( stations.count() ).arg( fileName ) );
+    return ret;
+}
+
+bool Playlist::write( const QString & fileName, const QList< Station > & stations )
+{
+    const Format format = formatOf( fileName );
+    if ( format == Unknown )
+        return false;
+
+    QFile file( fileName );
+    if ( !file.open( QFile::WriteOnly | QFile::Truncate ) )
+    {
+        LOG_WARN( "playlist", tr( "Can't write playlist %1." ).arg( fileName ) );
+        return false;
+    }
+
+    if ( format == XSPF )
+        writeXSPF( &file, stations );
+    else
+    {
+        QTextStream out( &file );
+        out.setCodec( "UTF-8" );
+        if ( format == M3U )
+            writeM3U( out, stations );
+        else
+            writePLS( out, stations );
+    }
+
+    LOG_INFO( "playlist", tr( "Wrote %1 stations to %2." ).arg( stations.count() ).arg( fileName ) );
+    return file.error() == QFile::NoError;
+}
+
+void Playlist::readM3U( QTextStream & in, QList< Station > & stations )
+{
+    Station station;
+    while ( !in.atEnd() )
+    {
+        const QString line = in.readLine().trimmed();
+        if ( line.isEmpty() )
+            continue;
+
+        if ( line.startsWith( "#EXTINF:" ) )
+            station.name = line.section( ',', 1 ).trimmed();
+        else if ( line.startsWith( M3U_DESCRIPTION_TAG ) )
+            station.description = line.mid( qstrlen( M3U_DESCRIPTION_TAG ) );
+        else if ( line.startsWith( M3U_ENCODING_TAG ) )
+            station.encoding = line.mid( qstrlen( M3U_ENCODING_TAG ) );
+        else if ( !line.startsWith( '#' ) )
+        {
+            station.url = line;
+            complete( station );
+            stations.append( station );
+            station = Station();
+        }
+    }
+}
+
+void Playlist::readPLS( QTextStream & in, QList< Station > & stations )
+{
+    // Entries are numbered and keys may come in any order.
+    QMap< int, Station > entries;
+    while ( !in.atEnd() )
+    {
+        const QString line = in.readLine().trimmed();
+        const int eq = line.indexOf( '=' );
+        if ( eq <= 0 )
+            continue;
+
+        const QString key = line.left( eq ).trimmed().toLower();
+        const QString value = line.mid( eq + 1 ).trimmed();
+        int digit = 0;
+        while ( ( digit < key.length() ) && !key[ digit ].isDigit() )
+            ++digit;
+
+        bool ok = false;
+        const int num = key.mid( digit ).toInt( &ok );
+        if ( !ok )
+            continue;
+
+        const QString field = key.left( digit );
+        if ( field == "file" )
+            entries[ num ].url = value;
+        else if ( field == "title" )
+            entries[ num ].name = value;
+        else if ( field == "description" )
+            entries[ num ].description = value;
+        else if ( field == "encoding" )
+            entries[ num ].encoding = value;
+    }
+
+    foreach ( Station station, entries )
+    {
+        if ( station.url.isEmpty() )
+            continue;
+
+        complete( station );
+        stations.append( station );
+    }
+}
+
+bool Playlist::readXSPF( QIODevice * device, QList< Station > & stations )
+{
+    QXmlStreamReader xml( device );
+    Station station;
+    bool inTrack = false;
+    while ( !xml.atEnd() )
+    {
+        xml.readNext();
+        if ( xml.isStartElement() )
+        {
+            const QStringRef name = xml.name();
+            if ( name == QLatin1String( "track" ) )
+            {
+                station = Station();
+                inTrack = true;
+            }
+            else if ( !inTrack )
+                continue;
+            else if ( name == QLatin1String( "location" ) )
+                station.url = xml.readElementText().trimmed();
+            else if ( name == QLatin1String( "title" ) )
+                station.name = xml.readElementText().trimmed();
+            else if ( name == QLatin1String( "annotation" ) )
+                station.description = xml.readElementText().trimmed();
+            else if ( ( name == QLatin1String( "meta" ) ) &&
+                      ( xml.attributes().value( "rel" ) == QLatin1String( XSPF_ENCODING_REL ) ) )
+                station.encoding = xml.readElementText().trimmed();
+        }
+        else if ( xml.isEndElement() && ( xml.name() == QLatin1String( "track" ) ) )
+        {
+            inTrack = false;
+            if ( !station.url.isEmpty() )
+            {
+                complete( station );
+                stations.append( station );
+            }
+        }
+    }
+
+    if ( xml.hasError() )
+    {
+        LOG_WARN( "playlist", tr( "XSPF error at line %1: %2." )
+                              .arg( xml.lineNumber() ).arg( xml.errorString() ) );
+        return false;
+    }
+
+    return true;
+}
+
+void Playlist::writeM3U( QTextStream & out, const QList< Station > & stations )
+{
+    out << "#EXTM3U\n";
+    foreach ( const Station & station, stations )
+    {
+        out << "#EXTINF:-1," << station.name << '\n';
+        if ( !station.description.isEmpty() )
+            out << M3U_DESCRIPTION_TAG << station.description << '\n';
+        if ( !station.encoding.isEmpty() )
+            out << M3U_ENCODING_TAG << station.encoding << '\n';
+        out << station.url << '\n';
+    }
+}
+
+void Playlist::writePLS( QTextStream & out, const QList< Station > & stations )
+{
+    out << "[playlist]\n";
+    for ( int i = 0; i < stations.count(); ++i )
+    {
+        const Station & station = stations[ i ];
+        const int num = i + 1;
+        out << "File" << num << '=' << station.url << '\n';
+        out << "Title" << num << '=' << station.name << '\n';
+        out << "Length" << num << "=-1\n";
+        if ( !station.description.isEmpty() )
+            out << "Description" << num << '=' << station.description << '\n';
+        if ( !station.encoding.isEmpty() )
+            out << "Encoding" << num << '=' << station.encoding << '\n';
+    }
+    out << "NumberOfEntries=" << stations.count() << '\n';
+    out << "Version=2\n";
+}
+
+void Playlist::writeXSPF( QIODevice * device, const QList< Station > & stations )
+{
+    QXmlStreamWriter xml( device );
+    xml.setAutoFormatting( true );
+    xml.writeStartDocument();
+    xml.writeStartElement( "playlist" );
+    xml.writeAttribute( "version", "1" );
+    xml.writeDefaultNamespace( "http://xspf.org/ns/0/" );
+    xml.writeStartElement( "trackList" );
+    foreach ( const Station & station, stations )
+    {
+        xml.writeStartElement( "track" );
+        xml.writeTextElement( "location", station.url );
+        xml.writeTextElement( "title", station.name );
+        if ( !station.description.isEmpty() )
+            xml.writeTextElement( "annotation", station.description );
+        if ( !station.encoding.isEmpty() )
+        {
+            xml.writeStartElement( "meta" );
+            xml.writeAttribute( "rel", XSPF_ENCODING_REL );
+            xml.writeCharacters( station.encoding );
+            xml.writeEndElement();
+        }
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+}
+
+void Playlist::complete( Station & station )
+{
+    if ( station.name.isEmpty() )
+        station.name = station.url;
+    if ( station.encoding.isEmpty() )
+        station.encoding = DEFAULT_ENCODING;
+}
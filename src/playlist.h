@@ -0,0 +1,42 @@
+//
+// Playlist files ( M3U, PLS, XSPF ) reading and writing.
+//
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <QList>
+#include <QCoreApplication>
+
+#include "station.h"
+
+class QTextStream;
+class QIODevice;
+
+class Playlist
+{
+    Q_DECLARE_TR_FUNCTIONS( Playlist )
+
+    public:
+        enum Format { M3U, PLS, XSPF, Unknown };
+
+        // Format by file name suffix.
+        static Format formatOf( const QString & fileName );
+        // File dialog filter for supported formats.
+        static QString fileFilter();
+        // Read stations from file, returns false on open or format error.
+        static bool read( const QString & fileName, QList< Station > & stations );
+        // Write stations to file, format is taken from file name.
+        static bool write( const QString & fileName, const QList< Station > & stations );
+
+    private:
+        static void readM3U( QTextStream & in, QList< Station > & stations );
+        static void readPLS( QTextStream & in, QList< Station > & stations );
+        static bool readXSPF( QIODevice * device, QList< Station > & stations );
+        static void writeM3U( QTextStream & out, const QList< Station > & stations );
+        static void writePLS( QTextStream & out, const QList< Station > & stations );
+        static void writeXSPF( QIODevice * device, const QList< Station > & stations );
+        // Fill empty fields with defaults.
+        static void complete( Station & station );
+};
+
+#endif
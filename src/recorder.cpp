@@ -0,0 +1,454 @@
+//
+// Recorder: writes received stream to disk as is ( no re-encoding ).
+//
+#include "recorder.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QThread>
+#include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QTextCodec>
+#include <QMutexLocker>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Data collected before one write ( bytes ).
+#define RECORD_WRITE_SIZE 262144
+// Collected data is written at least this often ( msec ).
+#define RECORD_WRITE_DELAY 10000
+// File space reserved ahead of written data ( bytes ).
+#define RECORD_PREALLOCATE 8388608
+// Writer wakes this often to take queued data ( msec ).
+#define RECORD_DRAIN_INTERVAL 500
+// Default backlog limit ( bytes ).
+#define RECORD_BACKLOG_LIMIT 16777216
+// Maximum length of track part of file name.
+#define RECORD_NAME_LENGTH 120
+
+//
+// Writer thread.
+//
+class RecordWriter : public QThread
+{
+    public:
+        explicit RecordWriter( Recorder * owner )
+            :QThread( 0 ),
+             recorder( owner ),
+             stopping( 0 )
+        {
+        }
+
+        void stop()
+        {
+            recorder->mutex.lock();
+            stopping = 1;
+            recorder->wakeup.wakeOne();
+            recorder->mutex.unlock();
+            wait();
+        }
+
+    protected:
+        void run()
+        {
+            while ( !stopping )
+            {
+                // Queue is checked under the mutex wakers hold, no wake is lost.
+                recorder->mutex.lock();
+                if ( recorder->queue.isEmpty() && !stopping )
+                    recorder->wakeup.wait( &recorder->mutex, RECORD_DRAIN_INTERVAL );
+                recorder->mutex.unlock();
+                recorder->drain();
+            }
+            recorder->drain();
+        }
+
+    private:
+        Recorder * recorder;
+        QAtomicInt stopping;
+};
+
+Recorder::Recorder( QObject * parent )
+    :QObject( parent ),
+     split( true ),
+     codec( 0 ),
+     backlogLimit( RECORD_BACKLOG_LIMIT ),
+     recording( false ),
+     needFile( false ),
+     rate( 0 ),
+     dropReported( false ),
+     written( 0 ),
+     dropped( 0 ),
+     backlogBytes( 0 ),
+     writeTime( 0 ),
+     writer( 0 ),
+     allocated( 0 )
+{
+    directory = QDir::homePath() + "/QRadioTray";
+    statsTimer.setInterval( 1000 );
+    connect( &statsTimer, SIGNAL( timeout() ), SLOT( updateStats() ) );
+}
+
+Recorder::~Recorder()
+{
+    if ( recording )
+        stop();
+
+    // Writer finishes queued data before exit.
+    if ( writer )
+    {
+        writer->stop();
+        delete writer;
+    }
+}
+
+void Recorder::setDirectory( const QString & path )
+{
+    if ( !path.isEmpty() )
+        directory = QDir::fromNativeSeparators( path );
+}
+
+void Recorder::setSplitTracks( bool enabled )
+{
+    split = enabled;
+}
+
+void Recorder::setStation( const QString & name )
+{
+    if ( name == station )
+        return;
+
+    station = name;
+    track.clear();
+    if ( recording )
+        needFile = true;
+}
+
+void Recorder::setEncoding( const QString & encoding )
+{
+    codec = encoding.isEmpty() ? 0 : QTextCodec::codecForName( encoding.toLatin1() );
+}
+
+void Recorder::setContentType( const QByteArray & type )
+{
+    contentType = type.toLower();
+}
+
+void Recorder::setBacklogLimit( int bytes )
+{
+    backlogLimit = ( bytes > 0 ) ? bytes : RECORD_BACKLOG_LIMIT;
+}
+
+bool Recorder::isRecording() const
+{
+    return recording;
+}
+
+QString Recorder::fileName() const
+{
+    return currentFile;
+}
+
+qint64 Recorder::bytesWritten() const
+{
+    QMutexLocker locker( &mutex );
+    return written;
+}
+
+int Recorder::backlog() const
+{
+    QMutexLocker locker( &mutex );
+    return backlogBytes;
+}
+
+int Recorder::diskRate() const
+{
+    return rate;
+}
+
+qint64 Recorder::droppedBytes() const
+{
+    QMutexLocker locker( &mutex );
+    return dropped;
+}
+
+void Recorder::start( const QString & name )
+{
+    if ( recording )
+        return;
+
+    if ( !writer )
+    {
+        writer = new RecordWriter( this );
+        writer->start( QThread::LowPriority );
+    }
+
+    setStation( name );
+    recording = true;
+    // File is opened with first data, when stream type is known.
+    needFile = true;
+    dropReported = false;
+    statsTimer.start();
+    LOG_INFO( "recorder", tr( "Recording of \"%1\" started." ).arg( station ) );
+    emit started();
+}
+
+void Recorder::stop()
+{
+    if ( !recording )
+        return;
+
+    recording = false;
+    statsTimer.stop();
+    Item item;
+    item.kind = Item::Close;
+    item.offset = 0;
+    item.length = 0;
+    enqueue( item, true );
+    updateStats();
+    LOG_INFO( "recorder", tr( "Recording stopped, %1 bytes written, %2 bytes dropped." )
+                          .arg( bytesWritten() ).arg( droppedBytes() ) );
+    emit stopped();
+}
+
+void Recorder::write( const QByteArray & chunk, int offset, int length )
+{
+    if ( !recording || ( length <= 0 ) )
+        return;
+
+    if ( needFile )
+    {
+        needFile = false;
+        currentFile = nextFileName();
+        Item open;
+        open.kind = Item::Open;
+        open.offset = 0;
+        open.length = 0;
+        open.file = currentFile;
+        enqueue( open, false );
+        LOG_INFO( "recorder", tr( "Recording to %1." ).arg( currentFile ) );
+        emit fileChanged( currentFile );
+    }
+
+    {
+        QMutexLocker locker( &mutex );
+        if ( backlogBytes + length > backlogLimit )
+        {
+            // Disk can't keep up, losing audio beats stalling playback.
+            dropped += length;
+            if ( !dropReported )
+            {
+                dropReported = true;
+                locker.unlock();
+                LOG_WARN( "recorder", tr( "Disk is too slow, recorded data is dropped." ) );
+            }
+            return;
+        }
+    }
+
+    Item item;
+    item.kind = Item::Data;
+    item.chunk = chunk;
+    item.offset = offset;
+    item.length = length;
+    enqueue( item, false );
+}
+
+void Recorder::setMetaData( const QMultiMap< QString, QString > & data )
+{
+    QString text = data.value( "TITLE" );
+    if ( !data.value( "ARTIST" ).isEmpty() )
+        text = data.value( "ARTIST" ) + " - " + text;
+    if ( codec )
+        text = codec->toUnicode( text.toLatin1() );
+    text = text.simplified();
+    if ( text == track )
+        return;
+
+    // Next data belongs to new track.
+    track = text;
+    if ( recording && split )
+        needFile = true;
+}
+
+void Recorder::updateStats()
+{
+    QString reason;
+    qint64 total;
+    int waiting;
+    qint64 spent;
+    {
+        QMutexLocker locker( &mutex );
+        reason = error;
+        error.clear();
+        total = written;
+        waiting = backlogBytes;
+        spent = writeTime;
+    }
+
+    if ( spent > 0 )
+        rate = int( qMin( total * 1e9 / spent, 2147483647.0 ) );
+    if ( waiting < backlogLimit / 2 )
+        dropReported = false;
+
+    TRACE_COUNTER( "record backlog", waiting );
+    emit stats( total, waiting, rate );
+
+    if ( !reason.isEmpty() )
+    {
+        LOG_ERROR( "recorder", reason );
+        emit failed( reason );
+        stop();
+    }
+}
+
+void Recorder::enqueue( const Item & item, bool wake )
+{
+    QMutexLocker locker( &mutex );
+    queue.enqueue( item );
+    backlogBytes += item.length;
+    if ( wake )
+        wakeup.wakeOne();
+}
+
+QString Recorder::nextFileName() const
+{
+    QString extension = "mp3";
+    if ( contentType.contains( "aac" ) )
+        extension = "aac";
+    else if ( contentType.contains( "ogg" ) )
+        extension = "ogg";
+    else if ( contentType.contains( "flac" ) )
+        extension = "flac";
+
+    QString name = QDateTime::currentDateTime().toString( "yyyy-MM-dd hh-mm-ss" );
+    const QString title = sanitize( track ).left( RECORD_NAME_LENGTH );
+    if ( !title.isEmpty() )
+        name += " " + title;
+
+    QString folder = sanitize( station );
+    if ( folder.isEmpty() )
+        folder = "Radio";
+    return directory + "/" + folder + "/" + name + "." + extension;
+}
+
+QString Recorder::sanitize( const QString & text )
+{
+    QString result = text;
+    for ( int i = 0; i < result.length(); ++i )
+    {
+        const QChar c = result.at( i );
+        if ( ( c < QChar( ' ' ) ) || QString( "/\\:*?\"<>|" ).contains( c ) )
+            result[ i ] = '_';
+    }
+
+    // No hidden files or trailing dots.
+    result = result.simplified();
+    while ( result.startsWith( '.' ) )
+        result.remove( 0, 1 );
+    while ( result.endsWith( '.' ) )
+        result.chop( 1 );
+    return result;
+}
+
+void Recorder::drain()
+{
+    QQueue< Item > items;
+    {
+        QMutexLocker locker( &mutex );
+        qSwap( items, queue );
+    }
+
+    while ( !items.isEmpty() )
+    {
+        const Item item = items.dequeue();
+        if ( item.kind == Item::Open )
+        {
+            closeFile();
+            openFile( item.file );
+        }
+        else if ( item.kind == Item::Close )
+            closeFile();
+        else if ( file.isOpen() )
+        {
+            pending.append( item.chunk.constData() + item.offset, item.length );
+            if ( pending.size() >= RECORD_WRITE_SIZE )
+                flushPending();
+        }
+        else
+        {
+            QMutexLocker locker( &mutex );
+            backlogBytes -= item.length;
+            dropped += item.length;
+        }
+    }
+
+    if ( !pending.isEmpty() && ( lastFlush.elapsed() >= RECORD_WRITE_DELAY ) )
+        flushPending();
+}
+
+void Recorder::flushPending()
+{
+    TRACE_SCOPE( "Recorder::flushPending" );
+    if ( pending.isEmpty() )
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+#if defined( Q_OS_LINUX ) && defined( FALLOC_FL_KEEP_SIZE )
+    // Reserve space in big steps, file stays in few extents.
+    const qint64 end = file.pos() + pending.size();
+    if ( end > allocated )
+    {
+        allocated = end + RECORD_PREALLOCATE;
+        fallocate( file.handle(), FALLOC_FL_KEEP_SIZE, 0, allocated );
+    }
+#endif
+    const qint64 count = file.write( pending );
+    const qint64 spent = timer.nsecsElapsed();
+
+    QMutexLocker locker( &mutex );
+    backlogBytes -= pending.size();
+    writeTime += spent;
+    if ( count == pending.size() )
+        written += count;
+    else
+    {
+        dropped += pending.size();
+        error = tr( "Can't write %1: %2." ).arg( file.fileName() ).arg( file.errorString() );
+    }
+    pending.clear();
+    lastFlush.restart();
+}
+
+void Recorder::openFile( const QString & name )
+{
+    QDir().mkpath( QFileInfo( name ).absolutePath() );
+    file.setFileName( name );
+    allocated = 0;
+    lastFlush.start();
+    // Unbuffered: writes are large already, no extra copy.
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Unbuffered ) )
+    {
+        QMutexLocker locker( &mutex );
+        error = tr( "Can't create %1: %2." ).arg( name ).arg( file.errorString() );
+    }
+}
+
+void Recorder::closeFile()
+{
+    if ( !file.isOpen() )
+        return;
+
+    flushPending();
+#ifdef Q_OS_LINUX
+    // Give back space reserved past the end.
+    if ( ftruncate( file.handle(), file.size() ) != 0 )
+        LOG_WARN( "recorder", tr( "Can't trim %1." ).arg( file.fileName() ) );
+#endif
+    file.close();
+}
@@ -0,0 +1,143 @@
+//
+// Recorder: writes received stream to disk as is ( no re-encoding ).
+//
+// Audio chunks are queued as shared references, the writer thread collects
+// them into large sequential writes and preallocates file space ahead, so
+// GUI and playback never wait for disk. Queue over backlog limit is dropped
+// ( and counted ) rather than blocking. With track splitting a new file is
+// started at the stream byte where track meta data arrived.
+//
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <QObject>
+#include <QQueue>
+#include <QMultiMap>
+#include <QByteArray>
+#include <QString>
+#include <QTimer>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+class QTextCodec;
+class RecordWriter;
+
+class Recorder : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit Recorder( QObject * parent = 0 );
+        ~Recorder();
+
+        // Base directory, files go to station subdirectories.
+        void setDirectory( const QString & path );
+        // Start new file on every track change.
+        void setSplitTracks( bool enabled );
+        // Station of recorded stream, next data goes to new file.
+        void setStation( const QString & name );
+        // Station text encoding for file names from meta data.
+        void setEncoding( const QString & encoding );
+        // Stream content type, chooses file extension.
+        void setContentType( const QByteArray & type );
+        // Maximum bytes waiting for disk ( more is dropped ).
+        void setBacklogLimit( int bytes );
+
+        bool isRecording() const;
+        // File being written ( or last one ).
+        QString fileName() const;
+        // Stats: bytes on disk, bytes waiting, write speed ( bytes/s ), lost bytes.
+        qint64 bytesWritten() const;
+        int backlog() const;
+        int diskRate() const;
+        qint64 droppedBytes() const;
+
+    public slots:
+        void start( const QString & station );
+        void stop();
+        // Queue part of stream chunk ( chunk is shared, not copied ).
+        void write( const QByteArray & chunk, int offset, int length );
+        // Track change from stream meta data ( raw Latin-1 values ).
+        void setMetaData( const QMultiMap< QString, QString > & data );
+
+    signals:
+        void started();
+        void stopped();
+        // File opened ( first data or track split ).
+        void fileChanged( const QString & file );
+        void failed( const QString & reason );
+        // Sent every second while recording.
+        void stats( qint64 written, int backlog, int diskRate );
+
+    private slots:
+        // Publish stats, report writer errors.
+        void updateStats();
+
+    private:
+        friend class RecordWriter;
+
+        // Writer command.
+        struct Item
+        {
+            enum Kind { Data, Open, Close };
+
+            int kind;
+            QByteArray chunk;
+            int offset;
+            int length;
+            // File to open.
+            QString file;
+        };
+
+        // Queue item and wake writer if asked.
+        void enqueue( const Item & item, bool wake );
+        // Name of next file from station, time and track.
+        QString nextFileName() const;
+        // Strip characters not allowed in file names.
+        static QString sanitize( const QString & text );
+
+        // Writer side: run queued commands.
+        void drain();
+        // Writer side: write collected data.
+        void flushPending();
+        void openFile( const QString & name );
+        void closeFile();
+
+        QString directory;
+        bool split;
+        QTextCodec * codec;
+        QByteArray contentType;
+        int backlogLimit;
+        bool recording;
+        // Next data starts new file.
+        bool needFile;
+        QString station;
+        QString track;
+        QString currentFile;
+        QTimer statsTimer;
+        int rate;
+        // Drop run reported in log.
+        bool dropReported;
+
+        // Guards queue and stats shared with writer.
+        mutable QMutex mutex;
+        QWaitCondition wakeup;
+        QQueue< Item > queue;
+        qint64 written;
+        qint64 dropped;
+        int backlogBytes;
+        // Time spent in write calls ( nsec ).
+        qint64 writeTime;
+        QString error;
+        RecordWriter * writer;
+
+        // Owned by writer thread.
+        QFile file;
+        QByteArray pending;
+        qint64 allocated;
+        QElapsedTimer lastFlush;
+};
+
+#endif
@@ -0,0 +1,38 @@
+//
+// Safe file: sync and atomic replace of files written through a temporary.
+//
+#include "safefile.h"
+
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+bool SafeFile::sync( QFile & file )
+{
+    if ( !file.flush() )
+        return false;
+#ifdef Q_OS_WIN
+    return FlushFileBuffers( reinterpret_cast< HANDLE >( _get_osfhandle( file.handle() ) ) ) != 0;
+#else
+    return fsync( file.handle() ) == 0;
+#endif
+}
+
+bool SafeFile::replace( const QString & tempName, const QString & fileName )
+{
+#ifdef Q_OS_WIN
+    // Write through: move is on disk when call returns.
+    return MoveFileExW( reinterpret_cast< const wchar_t * >( tempName.utf16() ),
+                        reinterpret_cast< const wchar_t * >( fileName.utf16() ),
+                        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0;
+#else
+    return rename( QFile::encodeName( tempName ).constData(),
+                   QFile::encodeName( fileName ).constData() ) == 0;
+#endif
+}
@@ -0,0 +1,24 @@
+//
+// Safe file: sync and atomic replace of files written through a temporary.
+//
+// Callers write new content to "<file>.tmp", sync it if it must survive
+// power loss, then replace the old file in one step: a crash leaves either
+// old or new content, never a mix.
+//
+#ifndef SAFE_FILE_H
+#define SAFE_FILE_H
+
+#include <QString>
+
+class QFile;
+
+class SafeFile
+{
+    public:
+        // Flush written data of open file to disk, false on I/O error.
+        static bool sync( QFile & file );
+        // Replace file with temporary one in one step.
+        static bool replace( const QString & tempName, const QString & fileName );
+};
+
+#endif
@@ -3,20 +3,38 @@
 //
 #include "settingsdialog.h"
 #include "stationdialog.h"
+#include "stationmodel.h"
+#include "stationfiltermodel.h"
 #include "ui_settingsdialog.h"
-#include "player.h"
 #include "logger.h"
+#include "tracer.h"
 
-#include <QMessageBox>
+// Rows measured when sizing columns.
+#define SIZE_SAMPLE_ROWS 64
+// Cell padding added to text width ( pixels ).
+#define SIZE_CELL_MARGIN 12
 
 SettingsDialog::SettingsDialog( QWidget * parent )
     :QDialog( parent ),
      ui( new Ui::SettingsDialog ),
      selectedStation( -1 ),
-     isSelection( false )
+     isSelection( false ),
+     model( new StationModel( this ) ),
+     proxy( new StationFilterModel( model, this ) ),
+     prober( 0 )
 {
     ui->setupUi( this );
-    ui->stationTable->horizontalHeader()->setResizeMode( QHeaderView::ResizeToContents );
+
+    ui->stationTable->setModel( proxy );
+
+    // Sizing to contents would measure every row on each change.
+    QHeaderView * header = ui->stationTable->horizontalHeader();
+    header->setResizeMode( QHeaderView::Interactive );
+    header->setStretchLastSection( true );
+    header->setClickable( true );
+    connect( header, SIGNAL( sectionClicked( int ) ), SLOT( sortByColumn( int ) ) );
+    connect( ui->filterEdit, SIGNAL( textChanged( const QString & ) ), SLOT( setFilter( const QString & ) ) );
+    updateReorder();
 }
 
 SettingsDialog::~SettingsDialog()
@@ -26,47 +44,103 @@ SettingsDialog::~SettingsDialog()
 
 void SettingsDialog::setStationList( const QList< Station > & list )
 {
-    stationList = list;
-    updateStationsTable();
+    TRACE_SCOPE( "SettingsDialog::setStationList" );
+    if ( prober )
+    {
+        foreach ( int id, probeUrls.keys() )
+            prober->cancel( id );
+    }
+    probeUrls.clear();
+    model->clearStatus();
+
+    model->setStations( list );
+    resizeColumns();
+}
+
+void SettingsDialog::appendStations( const QList< Station > & list )
+{
+    model->appendStations( list );
+}
+
+void SettingsDialog::setProber( StationProber * stationProber )
+{
+    if ( prober )
+        prober->disconnect( this );
+
+    prober = stationProber;
+    if ( prober )
+        connect( prober, SIGNAL( probeFinished( int, StationProber::Result ) ),
+                         SLOT( onProbeFinished( int, StationProber::Result ) ) );
+}
+
+void SettingsDialog::resizeColumns()
+{
+    // resizeColumnsToContents() would measure every row of long lists.
+    QHeaderView * header = ui->stationTable->horizontalHeader();
+    const QFontMetrics metrics = ui->stationTable->fontMetrics();
+    const int rows = qMin( proxy->rowCount(), SIZE_SAMPLE_ROWS );
+    for ( int column = 0; column < proxy->columnCount() - 1; ++column )
+    {
+        int width = header->sectionSizeHint( column );
+        for ( int row = 0; row < rows; ++row )
+        {
+            const QString text = proxy->data( proxy->index( row, column ) ).toString();
+            width = qMax( width, metrics.width( text ) + SIZE_CELL_MARGIN );
+        }
+        header->resizeSection( column, width );
+    }
 }
 
 QList< Station > SettingsDialog::getStationList() const
 {
-    return stationList;
+    return model->stations();
 }
 
 void SettingsDialog::removeStation()
 {
     if ( getSelection() )
     {
-        stationList.removeAt( selectedStation );
-        updateStationsTable();
+        model->removeStations( selectedRows() );
+        restoreSelection();
     }
 }
 
 void SettingsDialog::moveUpStation()
 {
+    TRACE_SCOPE( "SettingsDialog::moveUpStation" );
     if ( getSelection() )
     {
-        if ( selectedStation > 0 )
+        QList< int > rows = selectedRows();
+        for ( int i = 0; i < rows.count(); ++i )
         {
-            stationList.swap( selectedStation, selectedStation - 1 );
-            selectedStation -= 1;
-            updateStationsTable();
+            // Row stays if it is first or follows selected row.
+            if ( ( rows[ i ] == 0 ) || ( ( i > 0 ) && ( rows[ i - 1 ] == rows[ i ] - 1 ) ) )
+                continue;
+
+            model->moveStation( rows[ i ], rows[ i ] - 1 );
+            rows[ i ] -= 1;
         }
+        ui->stationTable->scrollTo( proxy->mapFromSource( model->index( rows.first(), 0 ) ) );
     }
 }
 
 void SettingsDialog::moveDownStation()
 {
+    TRACE_SCOPE( "SettingsDialog::moveDownStation" );
     if ( getSelection() )
     {
-        if ( selectedStation < stationList.count() - 1 )
+        QList< int > rows = selectedRows();
+        const int last = model->rowCount() - 1;
+        for ( int i = rows.count() - 1; i >= 0; --i )
         {
-            stationList.swap( selectedStation, selectedStation + 1 );
-            selectedStation += 1;
-            updateStationsTable();
+            // Row stays if it is last or precedes selected row.
+            if ( ( rows[ i ] == last ) || ( ( i < rows.count() - 1 ) && ( rows[ i + 1 ] == rows[ i ] + 1 ) ) )
+                continue;
+
+            model->moveStation( rows[ i ], rows[ i ] + 2 );
+            rows[ i ] += 1;
         }
+        ui->stationTable->scrollTo( proxy->mapFromSource( model->index( rows.last(), 0 ) ) );
     }
 }
 
@@ -79,15 +153,15 @@ void SettingsDialog::appendStation()
     if ( dialog.exec() == QDialog::Accepted )
     {
         station = dialog.getStation();
-        if ( Player::checkSource( station.url ) )
+        model->appendStations( QList< Station >() << station );
+        checkStation( station.url );
+
+        const QModelIndex index = proxy->mapFromSource( model->index( model->rowCount() - 1, 0 ) );
+        if ( index.isValid() )
         {
-            stationList.append( station );
-            updateStationsTable();
+            ui->stationTable->selectRow( index.row() );
+            ui->stationTable->scrollTo( index );
         }
-        else
-            QMessageBox::critical( 0, tr( "Error" ),
-                                      tr( "Station has incorrect or unsupported stream "
-                                          "or network is unreachable!" ) );
     }
 }
 
@@ -95,67 +169,103 @@ void SettingsDialog::editStation()
 {
     if ( getSelection() )
     {
+        const int row = selectedRows().first();
         StationDialog dialog;
-        Station station = stationList[ selectedStation ];
+        Station station = model->station( row );
         dialog.setStation( station );
         if ( dialog.exec() == QDialog::Accepted )
         {
             station = dialog.getStation();
-            if ( Player::checkSource( station.url ) )
-            {
-                stationList[ selectedStation ] = station;
-                updateStationsTable();
-            }
-            else
-                QMessageBox::critical( 0, tr( "Error" ),
-                                          tr( "Station has incorrect or unsupported stream "
-                                              "or network is unreachable!" ) );
+            station.id = model->station( row ).id;
+            model->setStation( row, station );
+            checkStation( station.url );
         }
     }
 }
 
-void SettingsDialog::updateStationsTable()
+void SettingsDialog::checkStation( const QString & url )
 {
-    ui->stationTable->clearContents();
-    ui->stationTable->setRowCount( 0 );
+    if ( !prober || url.isEmpty() )
+        return;
 
-    foreach ( const Station & station, stationList )
-    {
-        const int currRow = ui->stationTable->rowCount();
-        ui->stationTable->insertRow( currRow );
-        ui->stationTable->setItem( currRow, 0, new QTableWidgetItem( station.name ) );
-        ui->stationTable->setItem( currRow, 1, new QTableWidgetItem( station.description ) );
-        ui->stationTable->setItem( currRow, 2, new QTableWidgetItem( station.url ) );
-        ui->stationTable->setItem( currRow, 3, new QTableWidgetItem( station.encoding ) );
-    }
+    const int id = prober->probe( url );
+    probeUrls.insert( id, url );
+    model->setStatus( url, -1 );
+}
 
-    restoreSelection();
+void SettingsDialog::onProbeFinished( int id, StationProber::Result result )
+{
+    if ( !probeUrls.contains( id ) )
+        return;
+
+    const QString url = probeUrls.take( id );
+    model->setStatus( url, result );
+    LOG_INFO( "settings", tr( "Station %1 check: %2." )
+                          .arg( url ).arg( StationProber::resultString( result ) ) );
 }
 
-bool SettingsDialog::getSelection()
+void SettingsDialog::sortByColumn( int column )
 {
-    if ( ui->stationTable->selectedItems().count() > 0 )
-    {
-        selectedStation = ui->stationTable->selectedItems().first()->row();
-        isSelection = true;
-    }
+    if ( proxy->sortColumn() != column )
+        proxy->sort( column, Qt::AscendingOrder );
+    else if ( proxy->sortOrder() == Qt::AscendingOrder )
+        proxy->sort( column, Qt::DescendingOrder );
     else
+        proxy->sort( -1 );
+
+    QHeaderView * header = ui->stationTable->horizontalHeader();
+    header->setSortIndicatorShown( proxy->sortColumn() >= 0 );
+    if ( proxy->sortColumn() >= 0 )
+        header->setSortIndicator( proxy->sortColumn(), proxy->sortOrder() );
+    updateReorder();
+}
+
+void SettingsDialog::setFilter( const QString & text )
+{
+    proxy->setQuery( text );
+    updateReorder();
+}
+
+void SettingsDialog::updateReorder()
+{
+    const bool stored = ( proxy->sortColumn() < 0 ) && proxy->query().isEmpty();
+    ui->upButton->setEnabled( stored );
+    ui->downButton->setEnabled( stored );
+    ui->stationTable->setDragEnabled( stored );
+}
+
+QList< int > SettingsDialog::selectedRows() const
+{
+    QList< int > rows;
+    foreach ( const QModelIndex & index, ui->stationTable->selectionModel()->selectedRows() )
+        rows.append( proxy->mapToSource( index ).row() );
+    qSort( rows );
+    return rows;
+}
+
+bool SettingsDialog::getSelection()
+{
+    const QModelIndexList rows = ui->stationTable->selectionModel()->selectedRows();
+    selectedStation = -1;
+    foreach ( const QModelIndex & index, rows )
     {
-        selectedStation = -1;
-        isSelection = false;
+        if ( ( selectedStation < 0 ) || ( index.row() < selectedStation ) )
+            selectedStation = index.row();
     }
+    isSelection = ( selectedStation >= 0 );
 
     return isSelection;
 }
 
 void SettingsDialog::restoreSelection()
 {
-    if ( isSelection && ( ui->stationTable->rowCount() > 0 ) )
+    const int count = proxy->rowCount();
+    if ( isSelection && ( count > 0 ) )
     {
         if ( selectedStation < 0 )
             selectedStation = 0;
-        else if ( selectedStation >= ui->stationTable->rowCount() )
-            selectedStation = ui->stationTable->rowCount() - 1;
+        else if ( selectedStation >= count )
+            selectedStation = count - 1;
         ui->stationTable->selectRow( selectedStation );
     }
 }
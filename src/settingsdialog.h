@@ -5,8 +5,13 @@
 #define SETTINGS_DIALOG_H
 
 #include <QDialog>
+#include <QHash>
 
 #include "station.h"
+#include "stationprober.h"
+
+class StationModel;
+class StationFilterModel;
 
 namespace Ui {
     class SettingsDialog;
@@ -22,9 +27,12 @@ class SettingsDialog : public QDialog
 
         void setStationList( const QList< Station > & list );
         QList< Station > getStationList() const;
+        // Append already checked stations.
+        void appendStations( const QList< Station > & list );
+        // Prober used for station url checks.
+        void setProber( StationProber * stationProber );
 
     public slots:
-        void updateStationsTable();
         void removeStation();
         void moveUpStation();
         void moveDownStation();
@@ -33,11 +41,31 @@ class SettingsDialog : public QDialog
         bool getSelection();
         void restoreSelection();
 
+    private slots:
+        void onProbeFinished( int id, StationProber::Result result );
+        // Sort by column: ascending, descending, then stored order.
+        void sortByColumn( int column );
+        void setFilter( const QString & text );
+
     private:
+        // Start background check of station url.
+        void checkStation( const QString & url );
+        // Selected model rows in ascending order.
+        QList< int > selectedRows() const;
+        // Reordering is possible only in stored order without filter.
+        void updateReorder();
+        // Size columns by header and first rows.
+        void resizeColumns();
+
         Ui::SettingsDialog * ui;
         int selectedStation;
         bool isSelection;
-        QList< Station > stationList;
+        StationModel * model;
+        // Sorted and filtered view of model.
+        StationFilterModel * proxy;
+        StationProber * prober;
+        // Urls of running probes.
+        QHash< int, QString > probeUrls;
 };
 
 #endif
@@ -8,6 +8,10 @@
 
 struct Station
 {
+    Station() : id( 0 ) {}
+
+    // Catalog id ( 0 - not stored yet ).
+    quint32 id;
     QString name;
     QString description;
     QString url;
@@ -0,0 +1,334 @@
+//
+// Station catalog: binary append-only station storage.
+//
+#include "stationcatalog.h"
+#include "safefile.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QSet>
+#include <QFile>
+#include <QDataStream>
+#include <QtEndian>
+
+// File signature "QRTC" and format version.
+#define CATALOG_MAGIC 0x51525443
+#define CATALOG_VERSION 1
+#define CATALOG_HEADER_SIZE 8
+// Record frame: payload size ( 4 bytes ) and checksum ( 2 bytes ).
+#define CATALOG_FRAME_SIZE 6
+// Superseded records allowed before rewrite.
+#define CATALOG_MIN_GARBAGE 1024
+
+StationCatalog::StationCatalog( const QString & catalogFile )
+    :fileName( catalogFile ),
+     nextId( 1 ),
+     recordCount( 0 ),
+     stale( true )
+{
+}
+
+bool StationCatalog::exists() const
+{
+    return QFile::exists( fileName );
+}
+
+bool StationCatalog::load( QList< Station > & list )
+{
+    TRACE_SCOPE( "StationCatalog::load" );
+    stations.clear();
+    order.clear();
+    nextId = 1;
+    recordCount = 0;
+    stale = true;
+    list.clear();
+
+    QFile file( fileName );
+    if ( !file.open( QFile::ReadOnly ) )
+    {
+        LOG_WARN( "catalog", tr( "Can't open catalog %1." ).arg( fileName ) );
+        return false;
+    }
+
+    const qint64 size = file.size();
+    QByteArray buffer;
+    const uchar * data = file.map( 0, size );
+    if ( !data )
+    {
+        buffer = file.readAll();
+        data = reinterpret_cast< const uchar * >( buffer.constData() );
+    }
+
+    if ( ( size < CATALOG_HEADER_SIZE ) ||
+         ( qFromBigEndian< quint32 >( data ) != CATALOG_MAGIC ) ||
+         ( qFromBigEndian< quint32 >( data + 4 ) != CATALOG_VERSION ) )
+    {
+        LOG_WARN( "catalog", tr( "Catalog %1 has unknown format." ).arg( fileName ) );
+        return false;
+    }
+
+    qint64 pos = CATALOG_HEADER_SIZE;
+    while ( pos + CATALOG_FRAME_SIZE <= size )
+    {
+        const quint32 length = qFromBigEndian< quint32 >( data + pos );
+        const quint16 checksum = qFromBigEndian< quint16 >( data + pos + 4 );
+        const char * payload = reinterpret_cast< const char * >( data + pos + CATALOG_FRAME_SIZE );
+        if ( ( pos + CATALOG_FRAME_SIZE + length > size ) ||
+             ( qChecksum( payload, length ) != checksum ) ||
+             !apply( payload, length ) )
+            break;
+
+        pos += CATALOG_FRAME_SIZE + length;
+        ++recordCount;
+    }
+    file.close();
+
+    // Cut off record torn by crash during append, tail left in place
+    // is dropped by rewrite on next save.
+    stale = false;
+    if ( pos != size )
+    {
+        LOG_WARN( "catalog", tr( "Catalog %1 is truncated to %2 bytes." ).arg( fileName ).arg( pos ) );
+        stale = !QFile::resize( fileName, pos );
+    }
+
+    list.reserve( order.count() );
+    foreach ( quint32 id, order )
+        list.append( stations.value( id ) );
+
+    LOG_INFO( "catalog", tr( "Loaded %1 stations ( %2 records )." ).arg( list.count() ).arg( recordCount ) );
+    return true;
+}
+
+bool StationCatalog::save( QList< Station > & list )
+{
+    TRACE_SCOPE( "StationCatalog::save" );
+    QSet< quint32 > keep;
+    QList< quint32 > ids;
+    ids.reserve( list.count() );
+    for ( int i = 0; i < list.count(); ++i )
+    {
+        if ( list[ i ].id == 0 )
+            list[ i ].id = nextId++;
+        keep.insert( list[ i ].id );
+        ids.append( list[ i ].id );
+    }
+
+    QByteArray batch;
+    int added = 0;
+    const QList< quint32 > current = order;
+    foreach ( quint32 id, current )
+    {
+        if ( !keep.contains( id ) )
+        {
+            addRemove( batch, id );
+            ++added;
+        }
+    }
+
+    foreach ( const Station & station, list )
+    {
+        if ( !stations.contains( station.id ) || differs( stations.value( station.id ), station ) )
+        {
+            addPut( batch, station );
+            ++added;
+        }
+    }
+
+    if ( ids != order )
+    {
+        addOrder( batch, ids );
+        ++added;
+    }
+
+    if ( ( added == 0 ) && !stale )
+        return true;
+
+    recordCount += added;
+    if ( stale || !exists() || ( recordCount > 2 * stations.count() + CATALOG_MIN_GARBAGE ) )
+        return rewrite();
+
+    if ( !append( batch ) )
+    {
+        stale = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool StationCatalog::apply( const char * data, int size )
+{
+    const QByteArray payload = QByteArray::fromRawData( data, size );
+    QDataStream in( payload );
+    in.setVersion( QDataStream::Qt_4_6 );
+
+    quint8 operation = 0;
+    in >> operation;
+    switch ( operation )
+    {
+        case Put:
+        {
+            Station station;
+            in >> station.id >> station.name >> station.description
+               >> station.url >> station.encoding;
+            if ( in.status() != QDataStream::Ok )
+                return false;
+
+            if ( !stations.contains( station.id ) )
+                order.append( station.id );
+            stations.insert( station.id, station );
+            nextId = qMax( nextId, station.id + 1 );
+        }
+        break;
+
+        case Remove:
+        {
+            quint32 id = 0;
+            in >> id;
+            if ( in.status() != QDataStream::Ok )
+                return false;
+
+            stations.remove( id );
+            order.removeOne( id );
+        }
+        break;
+
+        case Order:
+        {
+            quint32 count = 0;
+            in >> count;
+            QList< quint32 > ids;
+            ids.reserve( count );
+            for ( quint32 i = 0; ( i < count ) && ( in.status() == QDataStream::Ok ); ++i )
+            {
+                quint32 id = 0;
+                in >> id;
+                ids.append( id );
+            }
+            if ( in.status() != QDataStream::Ok )
+                return false;
+
+            order = ids;
+        }
+        break;
+
+        default: return false;
+    }
+
+    return true;
+}
+
+void StationCatalog::addPut( QByteArray & batch, const Station & station )
+{
+    QByteArray payload;
+    QDataStream out( &payload, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    out << quint8( Put ) << station.id << station.name << station.description
+        << station.url << station.encoding;
+    frame( batch, payload );
+
+    if ( !stations.contains( station.id ) )
+        order.append( station.id );
+    stations.insert( station.id, station );
+}
+
+void StationCatalog::addRemove( QByteArray & batch, quint32 id )
+{
+    QByteArray payload;
+    QDataStream out( &payload, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    out << quint8( Remove ) << id;
+    frame( batch, payload );
+
+    stations.remove( id );
+    order.removeOne( id );
+}
+
+void StationCatalog::addOrder( QByteArray & batch, const QList< quint32 > & ids )
+{
+    QByteArray payload;
+    QDataStream out( &payload, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    out << quint8( Order ) << quint32( ids.count() );
+    foreach ( quint32 id, ids )
+        out << id;
+    frame( batch, payload );
+
+    order = ids;
+}
+
+void StationCatalog::frame( QByteArray & batch, const QByteArray & payload )
+{
+    uchar head[ CATALOG_FRAME_SIZE ];
+    qToBigEndian< quint32 >( payload.size(), head );
+    qToBigEndian< quint16 >( qChecksum( payload.constData(), payload.size() ), head + 4 );
+    batch.append( reinterpret_cast< const char * >( head ), CATALOG_FRAME_SIZE );
+    batch.append( payload );
+}
+
+bool StationCatalog::append( const QByteArray & batch )
+{
+    QFile file( fileName );
+    if ( !file.open( QFile::WriteOnly | QFile::Append ) ||
+         ( file.write( batch ) != batch.size() ) || !file.flush() )
+    {
+        LOG_ERROR( "catalog", tr( "Can't append to catalog %1!" ).arg( fileName ) );
+        return false;
+    }
+
+    return true;
+}
+
+bool StationCatalog::rewrite()
+{
+    QByteArray data;
+    uchar head[ CATALOG_HEADER_SIZE ];
+    qToBigEndian< quint32 >( CATALOG_MAGIC, head );
+    qToBigEndian< quint32 >( CATALOG_VERSION, head + 4 );
+    data.append( reinterpret_cast< const char * >( head ), CATALOG_HEADER_SIZE );
+
+    // Put records in list order, so no order record is needed.
+    const QList< quint32 > ids = order;
+    foreach ( quint32 id, ids )
+        addPut( data, stations.value( id ) );
+
+    const QString tempName = fileName + ".tmp";
+    QFile file( tempName );
+    if ( !file.open( QFile::WriteOnly | QFile::Truncate ) ||
+         ( file.write( data ) != data.size() ) || !file.flush() )
+    {
+        LOG_ERROR( "catalog", tr( "Can't write catalog %1!" ).arg( tempName ) );
+        stale = true;
+        return false;
+    }
+    // Unsynced data must not replace good catalog.
+    if ( !SafeFile::sync( file ) )
+    {
+        LOG_ERROR( "catalog", tr( "Can't sync catalog %1!" ).arg( tempName ) );
+        file.close();
+        QFile::remove( tempName );
+        stale = true;
+        return false;
+    }
+    file.close();
+
+    // Replace old file in one step, it stays intact if we crash before.
+    if ( !SafeFile::replace( tempName, fileName ) )
+    {
+        LOG_ERROR( "catalog", tr( "Can't replace catalog %1!" ).arg( fileName ) );
+        stale = true;
+        return false;
+    }
+
+    stale = false;
+    recordCount = order.count();
+    LOG_INFO( "catalog", tr( "Catalog rewritten: %1 stations." ).arg( recordCount ) );
+    return true;
+}
+
+bool StationCatalog::differs( const Station & a, const Station & b )
+{
+    return ( a.name != b.name ) || ( a.description != b.description ) ||
+           ( a.url != b.url ) || ( a.encoding != b.encoding );
+}
@@ -0,0 +1,62 @@
+//
+// Station catalog: binary append-only station storage.
+//
+// File is a header followed by checksummed records ( put, remove, order ).
+// Edits are appended, the file is rewritten ( temp file and rename ) only
+// when superseded records outweigh live ones. Torn tail after a crash is
+// detected by checksum and cut off on load. Memory state changes before the
+// write, so after a failed write or load the next save rewrites the file.
+//
+#ifndef STATION_CATALOG_H
+#define STATION_CATALOG_H
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QCoreApplication>
+
+#include "station.h"
+
+class StationCatalog
+{
+    Q_DECLARE_TR_FUNCTIONS( StationCatalog )
+
+    public:
+        explicit StationCatalog( const QString & catalogFile );
+
+        // Is catalog file present.
+        bool exists() const;
+        // Read stations in stored order.
+        bool load( QList< Station > & list );
+        // Store changes against loaded state, new stations get ids.
+        bool save( QList< Station > & list );
+
+    private:
+        enum Operation { Put = 1, Remove = 2, Order = 3 };
+
+        // Apply record payload to memory state.
+        bool apply( const char * data, int size );
+        // Serialize record into batch ( and apply it ).
+        void addPut( QByteArray & batch, const Station & station );
+        void addRemove( QByteArray & batch, quint32 id );
+        void addOrder( QByteArray & batch, const QList< quint32 > & ids );
+        // Frame payload with size and checksum.
+        static void frame( QByteArray & batch, const QByteArray & payload );
+        // Append records to file.
+        bool append( const QByteArray & batch );
+        // Write compact file with live stations only.
+        bool rewrite();
+        // Do stations differ ( id is not compared ).
+        static bool differs( const Station & a, const Station & b );
+
+        QString fileName;
+        QHash< quint32, Station > stations;
+        QList< quint32 > order;
+        quint32 nextId;
+        // Records in file, live or superseded.
+        int recordCount;
+        // File is out of step with memory state ( failed write or load ).
+        bool stale;
+};
+
+#endif
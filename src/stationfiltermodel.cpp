@@ -0,0 +1,66 @@
+//
+// Station filter model: sorts stations and filters them by fuzzy search.
+//
+#include "stationfiltermodel.h"
+#include "stationmodel.h"
+#include "stationindex.h"
+#include "tracer.h"
+
+StationFilterModel::StationFilterModel( StationModel * stationModel, QObject * parent )
+    :QSortFilterProxyModel( parent ),
+     model( stationModel )
+{
+    setSourceModel( model );
+    setDynamicSortFilter( true );
+    setSortCaseSensitivity( Qt::CaseInsensitive );
+    connect( model, SIGNAL( dataChanged( const QModelIndex &, const QModelIndex & ) ),
+                    SLOT( onDataChanged( const QModelIndex &, const QModelIndex & ) ) );
+    connect( model, SIGNAL( rowsInserted( const QModelIndex &, int, int ) ), SLOT( onRowsInserted() ) );
+    connect( model, SIGNAL( modelReset() ), SLOT( onRowsInserted() ) );
+}
+
+void StationFilterModel::setQuery( const QString & text )
+{
+    // Query of punctuation only shows all stations.
+    const QString folded = StationIndex::fold( text );
+    if ( folded == queryText )
+        return;
+
+    queryText = folded;
+    refresh();
+}
+
+QString StationFilterModel::query() const
+{
+    return queryText;
+}
+
+bool StationFilterModel::filterAcceptsRow( int sourceRow, const QModelIndex & sourceParent ) const
+{
+    Q_UNUSED( sourceParent );
+    return queryText.isEmpty() || matches.contains( model->rowKey( sourceRow ) );
+}
+
+void StationFilterModel::onDataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight )
+{
+    Q_UNUSED( bottomRight );
+
+    // Check status is not searched.
+    if ( topLeft.column() < StationModel::StatusColumn )
+        onRowsInserted();
+}
+
+void StationFilterModel::onRowsInserted()
+{
+    if ( !queryText.isEmpty() )
+        refresh();
+}
+
+void StationFilterModel::refresh()
+{
+    TRACE_SCOPE( "StationFilterModel::refresh" );
+    matches.clear();
+    if ( !queryText.isEmpty() )
+        matches = model->search( queryText ).toSet();
+    invalidateFilter();
+}
@@ -0,0 +1,42 @@
+//
+// Station filter model: sorts stations and filters them by fuzzy search.
+//
+#ifndef STATION_FILTER_MODEL_H
+#define STATION_FILTER_MODEL_H
+
+#include <QSortFilterProxyModel>
+#include <QSet>
+
+class StationModel;
+
+class StationFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+    public:
+        explicit StationFilterModel( StationModel * stationModel, QObject * parent = 0 );
+
+        // Show only stations matching query ( empty - all ).
+        void setQuery( const QString & text );
+        // Folded query.
+        QString query() const;
+
+    protected:
+        bool filterAcceptsRow( int sourceRow, const QModelIndex & sourceParent ) const;
+
+    private slots:
+        // Search again after station text changes.
+        void onDataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight );
+        void onRowsInserted();
+
+    private:
+        // Run query against station index and refilter.
+        void refresh();
+
+        StationModel * model;
+        QString queryText;
+        // Search keys of matching stations.
+        QSet< quint32 > matches;
+};
+
+#endif
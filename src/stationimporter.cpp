@@ -0,0 +1,94 @@
+//
+// Station importer: reads playlist and validates stations.
+//
+#include "stationimporter.h"
+#include "playlist.h"
+#include "logger.h"
+
+#include <QSet>
+
+StationImporter::StationImporter( StationProber * stationProber, QObject * parent )
+    :QObject( parent ),
+     prober( stationProber ),
+     done( 0 )
+{
+    if ( prober )
+        connect( prober, SIGNAL( probeFinished( int, StationProber::Result ) ),
+                         SLOT( onProbeFinished( int, StationProber::Result ) ) );
+}
+
+bool StationImporter::start( const QString & fileName, const QList< Station > & known )
+{
+    if ( !prober || isRunning() )
+        return false;
+
+    QList< Station > stations;
+    if ( !Playlist::read( fileName, stations ) )
+        return false;
+
+    QSet< QString > urls;
+    foreach ( const Station & station, known )
+        urls.insert( station.url );
+
+    parsed.clear();
+    valid.clear();
+    done = 0;
+    foreach ( const Station & station, stations )
+    {
+        if ( urls.contains( station.url ) )
+            continue;
+
+        urls.insert( station.url );
+        parsed.append( station );
+    }
+    LOG_INFO( "importer", tr( "Validating %1 new stations." ).arg( parsed.count() ) );
+
+    // Prober runs checks in parallel up to its concurrency limit.
+    for ( int i = 0; i < parsed.count(); ++i )
+        probeIndex.insert( prober->probe( parsed[ i ].url ), i );
+
+    if ( parsed.isEmpty() )
+        emit finished( QList< Station >(), 0 );
+    return true;
+}
+
+void StationImporter::cancel()
+{
+    const QList< int > ids = probeIndex.keys();
+    probeIndex.clear();
+    if ( prober )
+    {
+        foreach ( int id, ids )
+            prober->cancel( id );
+    }
+    parsed.clear();
+    valid.clear();
+}
+
+bool StationImporter::isRunning() const
+{
+    return !probeIndex.isEmpty();
+}
+
+void StationImporter::onProbeFinished( int id, StationProber::Result result )
+{
+    if ( !probeIndex.contains( id ) )
+        return;
+
+    const int index = probeIndex.take( id );
+    if ( ( result == StationProber::Ok ) || ( result == StationProber::Unchecked ) )
+        valid.insert( index, parsed[ index ] );
+    ++done;
+    emit progress( done, parsed.count() );
+
+    if ( probeIndex.isEmpty() )
+    {
+        const QList< Station > stations = valid.values();
+        const int rejected = parsed.count() - stations.count();
+        LOG_INFO( "importer", tr( "Import done: %1 valid, %2 rejected." )
+                              .arg( stations.count() ).arg( rejected ) );
+        parsed.clear();
+        valid.clear();
+        emit finished( stations, rejected );
+    }
+}
@@ -0,0 +1,46 @@
+//
+// Station importer: reads playlist and validates stations.
+//
+#ifndef STATION_IMPORTER_H
+#define STATION_IMPORTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+
+#include "station.h"
+#include "stationprober.h"
+
+class StationImporter : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit StationImporter( StationProber * stationProber, QObject * parent = 0 );
+
+        // Read playlist and start validation, stations with known urls are skipped.
+        bool start( const QString & fileName, const QList< Station > & known );
+        // Abort validation, nothing is reported.
+        void cancel();
+        // Is validation running.
+        bool isRunning() const;
+
+    signals:
+        // Validated stations count.
+        void progress( int done, int total );
+        // Validation done, valid stations in playlist order.
+        void finished( const QList< Station > & stations, int rejected );
+
+    private slots:
+        void onProbeFinished( int id, StationProber::Result result );
+
+    private:
+        StationProber * prober;
+        // Station index by probe id.
+        QHash< int, int > probeIndex;
+        QList< Station > parsed;
+        QMap< int, Station > valid;
+        int done;
+};
+
+#endif
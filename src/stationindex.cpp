@@ -0,0 +1,230 @@
+//
+// Station index: fuzzy search over station names and descriptions.
+//
+#include "stationindex.h"
+#include "tracer.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+
+// Pack three characters into trigram code.
+#define TRIGRAM( a, b, c ) ( ( quint64( ( a ).unicode() ) << 32 ) | ( quint64( ( b ).unicode() ) << 16 ) | ( c ).unicode() )
+
+StationIndex::StationIndex()
+{
+}
+
+void StationIndex::insert( quint32 key, const Station & station )
+{
+    if ( keySlots.contains( key ) )
+        remove( key );
+
+    Entry entry;
+    entry.key = key;
+    entry.name = fold( station.name );
+    entry.text = entry.name + ' ' + fold( station.description );
+
+    int slot;
+    if ( freeSlots.isEmpty() )
+    {
+        slot = entries.count();
+        entries.append( entry );
+        hits.append( 0 );
+    }
+    else
+    {
+        slot = freeSlots.last();
+        freeSlots.pop_back();
+        entries[ slot ] = entry;
+    }
+    keySlots.insert( key, slot );
+
+    foreach ( quint64 gram, trigrams( entry.text, true ) )
+    {
+        QVector< int > & list = postings[ gram ];
+        if ( list.isEmpty() || ( list.last() < slot ) )
+            list.append( slot );
+        else
+            list.insert( qLowerBound( list.begin(), list.end(), slot ), slot );
+    }
+}
+
+void StationIndex::remove( quint32 key )
+{
+    QHash< quint32, int >::iterator it = keySlots.find( key );
+    if ( it == keySlots.end() )
+        return;
+
+    const int slot = it.value();
+    keySlots.erase( it );
+
+    Entry & entry = entries[ slot ];
+    foreach ( quint64 gram, trigrams( entry.text, true ) )
+    {
+        QHash< quint64, QVector< int > >::iterator posting = postings.find( gram );
+        if ( posting == postings.end() )
+            continue;
+
+        QVector< int > & list = posting.value();
+        QVector< int >::iterator found = qBinaryFind( list.begin(), list.end(), slot );
+        if ( found != list.end() )
+            list.erase( found );
+        if ( list.isEmpty() )
+            postings.erase( posting );
+    }
+
+    entry.name.clear();
+    entry.text.clear();
+    freeSlots.append( slot );
+}
+
+void StationIndex::clear()
+{
+    entries.clear();
+    freeSlots.clear();
+    keySlots.clear();
+    postings.clear();
+    hits.clear();
+}
+
+int StationIndex::count() const
+{
+    return keySlots.count();
+}
+
+QList< quint32 > StationIndex::search( const QString & query, int limit ) const
+{
+    TRACE_SCOPE( "StationIndex::search" );
+    QList< quint32 > result;
+    const QString folded = fold( query );
+    if ( folded.isEmpty() )
+        return result;
+
+    QVector< Match > matches;
+    const QVector< quint64 > grams = trigrams( folded, false );
+    if ( grams.isEmpty() )
+    {
+        // Too short for trigrams: word prefix in names.
+        QHash< quint32, int >::const_iterator it = keySlots.constBegin();
+        for ( ; it != keySlots.constEnd(); ++it )
+        {
+            const Entry & entry = entries[ it.value() ];
+            if ( entry.name.startsWith( folded ) || entry.name.contains( ' ' + folded ) )
+            {
+                Match match = { it.value(), score( entry, folded, 0 ) };
+                matches.append( match );
+            }
+        }
+    }
+    else
+    {
+        // Count shared trigrams, touched slots are reset afterwards.
+        QVector< int > touched;
+        foreach ( quint64 gram, grams )
+        {
+            QHash< quint64, QVector< int > >::const_iterator posting = postings.constFind( gram );
+            if ( posting == postings.constEnd() )
+                continue;
+
+            foreach ( int slot, posting.value() )
+            {
+                if ( hits[ slot ]++ == 0 )
+                    touched.append( slot );
+            }
+        }
+
+        // Every typo spoils up to three trigrams.
+        const int needed = qMax( 1, grams.count() - grams.count() / 3 );
+        foreach ( int slot, touched )
+        {
+            if ( hits[ slot ] >= needed )
+            {
+                Match match = { slot, score( entries[ slot ], folded, hits[ slot ] ) };
+                matches.append( match );
+            }
+            hits[ slot ] = 0;
+        }
+    }
+
+    if ( limit > 0 )
+    {
+        qSort( matches.begin(), matches.end(), matchLessThan );
+        if ( matches.count() > limit )
+            matches.resize( limit );
+    }
+
+    result.reserve( matches.count() );
+    foreach ( const Match & match, matches )
+        result.append( entries[ match.slot ].key );
+    return result;
+}
+
+QString StationIndex::fold( const QString & text )
+{
+    const QString decomposed = text.normalized( QString::NormalizationForm_KD ).toCaseFolded();
+    QString result;
+    result.reserve( decomposed.length() );
+
+    bool space = true;
+    for ( int i = 0; i < decomposed.length(); ++i )
+    {
+        const QChar c = decomposed.at( i );
+        if ( c.isMark() )
+            continue;
+
+        if ( c.isLetterOrNumber() )
+        {
+            result += c;
+            space = false;
+        }
+        else if ( !space )
+        {
+            result += ' ';
+            space = true;
+        }
+    }
+
+    if ( result.endsWith( ' ' ) )
+        result.chop( 1 );
+    return result;
+}
+
+QVector< quint64 > StationIndex::trigrams( const QString & text, bool wordEnd )
+{
+    // Leading space marks word start, trailing one ( in entries ) word end.
+    const QString padded = ' ' + text + ( wordEnd ? " " : "" );
+    QVector< quint64 > grams;
+    if ( padded.length() < 3 )
+        return grams;
+
+    grams.reserve( padded.length() - 2 );
+    for ( int i = 0; i + 2 < padded.length(); ++i )
+        grams.append( TRIGRAM( padded.at( i ), padded.at( i + 1 ), padded.at( i + 2 ) ) );
+
+    qSort( grams.begin(), grams.end() );
+    grams.erase( std::unique( grams.begin(), grams.end() ), grams.end() );
+    return grams;
+}
+
+int StationIndex::score( const Entry & entry, const QString & query, int shared ) const
+{
+    int value = shared * 10;
+    if ( entry.name.startsWith( query ) )
+        value += 100;
+    else if ( entry.name.contains( ' ' + query ) )
+        value += 60;
+    else if ( entry.name.contains( query ) )
+        value += 40;
+    else if ( entry.text.contains( query ) )
+        value += 20;
+
+    // Shorter names first among equal matches.
+    return value * 64 - qMin( entry.name.length(), 63 );
+}
+
+bool StationIndex::matchLessThan( const Match & a, const Match & b )
+{
+    if ( a.score != b.score )
+        return a.score > b.score;
+    return a.slot < b.slot;
+}
@@ -0,0 +1,71 @@
+//
+// Station index: fuzzy search over station names and descriptions.
+//
+// Text is folded ( case, diacritics, punctuation ) and split into trigrams,
+// each trigram keeps a sorted list of entries containing it. A query matches
+// entries sharing most of its trigrams, so a typo or two is tolerated.
+// Entries are added and removed one by one, the index is never rebuilt.
+//
+#ifndef STATION_INDEX_H
+#define STATION_INDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QString>
+
+#include "station.h"
+
+class StationIndex
+{
+    public:
+        StationIndex();
+
+        // Add station under key ( or replace text of key ).
+        void insert( quint32 key, const Station & station );
+        // Remove key.
+        void remove( quint32 key );
+        void clear();
+        // Number of keys.
+        int count() const;
+        // Keys of matching stations, best first ( limit <= 0 - all matches, unordered ).
+        QList< quint32 > search( const QString & query, int limit = 0 ) const;
+
+        // Lower case text without diacritics and punctuation.
+        static QString fold( const QString & text );
+
+    private:
+        struct Entry
+        {
+            quint32 key;
+            // Folded name.
+            QString name;
+            // Folded name and description.
+            QString text;
+        };
+
+        // Match candidate.
+        struct Match
+        {
+            int slot;
+            int score;
+        };
+
+        // Unique trigram codes of folded text.
+        static QVector< quint64 > trigrams( const QString & text, bool wordEnd );
+        // Rank candidate by substring position in name and text.
+        int score( const Entry & entry, const QString & query, int shared ) const;
+        static bool matchLessThan( const Match & a, const Match & b );
+
+        QVector< Entry > entries;
+        // Free entry slots.
+        QVector< int > freeSlots;
+        // Entry slot of station key.
+        QHash< quint32, int > keySlots;
+        // Sorted entry slots of trigram.
+        QHash< quint64, QVector< int > > postings;
+        // Trigram hits per slot, kept between searches.
+        mutable QVector< int > hits;
+};
+
+#endif
@@ -0,0 +1,310 @@
+//
+// Station model: station list for item views.
+//
+#include "stationmodel.h"
+#include "stationprober.h"
+#include "tracer.h"
+
+#include <QMimeData>
+#include <QDataStream>
+#include <QStringList>
+#include <QBrush>
+
+// Mime type of dragged rows.
+#define STATION_ROWS_MIME "application/x-qradiotray-rows"
+
+StationModel::StationModel( QObject * parent )
+    :QAbstractTableModel( parent ),
+     nextKey( 1 )
+{
+}
+
+int StationModel::rowCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : stationList.count();
+}
+
+int StationModel::columnCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant StationModel::data( const QModelIndex & index, int role ) const
+{
+    if ( !index.isValid() || ( index.row() >= stationList.count() ) )
+        return QVariant();
+
+    const Station & item = stationList[ index.row() ];
+    if ( ( role == Qt::DisplayRole ) || ( role == Qt::ToolTipRole ) )
+    {
+        switch ( index.column() )
+        {
+            case NameColumn: return item.name;
+            case DescriptionColumn: return item.description;
+            case UrlColumn: return item.url;
+            case EncodingColumn: return item.encoding;
+            case StatusColumn: return statusText( item.url );
+            default: break;
+        }
+    }
+    else if ( ( role == Qt::ForegroundRole ) && ( index.column() == StatusColumn ) )
+    {
+        const int status = urlStatus.value( item.url, StationProber::Ok );
+        if ( ( status >= 0 ) && ( status != StationProber::Ok ) && ( status != StationProber::Unchecked ) )
+            return QBrush( Qt::red );
+    }
+
+    return QVariant();
+}
+
+QVariant StationModel::headerData( int section, Qt::Orientation orientation, int role ) const
+{
+    if ( ( orientation != Qt::Horizontal ) || ( role != Qt::DisplayRole ) )
+        return QAbstractTableModel::headerData( section, orientation, role );
+
+    switch ( section )
+    {
+        case NameColumn: return tr( "Name" );
+        case DescriptionColumn: return tr( "Description" );
+        case UrlColumn: return tr( "Url" );
+        case EncodingColumn: return tr( "Encoding" );
+        case StatusColumn: return tr( "Status" );
+        default: break;
+    }
+
+    return QVariant();
+}
+
+Qt::ItemFlags StationModel::flags( const QModelIndex & index ) const
+{
+    // Drop only between rows, never onto a station.
+    if ( !index.isValid() )
+        return Qt::ItemIsDropEnabled;
+
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+}
+
+bool StationModel::removeRows( int row, int count, const QModelIndex & parent )
+{
+    if ( parent.isValid() || ( row < 0 ) || ( count <= 0 ) || ( row + count > stationList.count() ) )
+        return false;
+
+    beginRemoveRows( QModelIndex(), row, row + count - 1 );
+    for ( int i = row; i < row + count; ++i )
+        searchIndex.remove( rowKeys[ i ] );
+    stationList.erase( stationList.begin() + row, stationList.begin() + row + count );
+    rowKeys.erase( rowKeys.begin() + row, rowKeys.begin() + row + count );
+    endRemoveRows();
+    return true;
+}
+
+Qt::DropActions StationModel::supportedDropActions() const
+{
+    return Qt::MoveAction;
+}
+
+QStringList StationModel::mimeTypes() const
+{
+    return QStringList() << STATION_ROWS_MIME;
+}
+
+QMimeData * StationModel::mimeData( const QModelIndexList & indexes ) const
+{
+    QList< int > rows;
+    foreach ( const QModelIndex & index, indexes )
+    {
+        if ( index.isValid() && !rows.contains( index.row() ) )
+            rows.append( index.row() );
+    }
+
+    QByteArray encoded;
+    QDataStream out( &encoded, QIODevice::WriteOnly );
+    out << rows;
+
+    QMimeData * mime = new QMimeData;
+    mime->setData( STATION_ROWS_MIME, encoded );
+    return mime;
+}
+
+bool StationModel::dropMimeData( const QMimeData * data, Qt::DropAction action,
+                                 int row, int column, const QModelIndex & parent )
+{
+    Q_UNUSED( column );
+    if ( ( action != Qt::MoveAction ) || !data || !data->hasFormat( STATION_ROWS_MIME ) )
+        return false;
+
+    QList< int > rows;
+    QDataStream in( data->data( STATION_ROWS_MIME ) );
+    in >> rows;
+
+    if ( parent.isValid() )
+        row = parent.row();
+    if ( ( row < 0 ) || ( row > stationList.count() ) )
+        row = stationList.count();
+    moveStations( rows, row );
+
+    // Rows are moved already, the view must not remove dragged ones.
+    return false;
+}
+
+void StationModel::setStations( const QList< Station > & list )
+{
+    TRACE_SCOPE( "StationModel::setStations" );
+    beginResetModel();
+    stationList = list;
+    rowKeys.clear();
+    rowKeys.reserve( list.count() );
+    searchIndex.clear();
+    foreach ( const Station & item, list )
+    {
+        rowKeys.append( nextKey );
+        searchIndex.insert( nextKey++, item );
+    }
+    endResetModel();
+}
+
+const QList< Station > & StationModel::stations() const
+{
+    return stationList;
+}
+
+const Station & StationModel::station( int row ) const
+{
+    return stationList.at( row );
+}
+
+void StationModel::appendStations( const QList< Station > & list )
+{
+    if ( list.isEmpty() )
+        return;
+
+    beginInsertRows( QModelIndex(), stationList.count(), stationList.count() + list.count() - 1 );
+    stationList += list;
+    foreach ( const Station & item, list )
+    {
+        rowKeys.append( nextKey );
+        searchIndex.insert( nextKey++, item );
+    }
+    endInsertRows();
+}
+
+void StationModel::setStation( int row, const Station & station )
+{
+    if ( ( row < 0 ) || ( row >= stationList.count() ) )
+        return;
+
+    stationList[ row ] = station;
+    searchIndex.insert( rowKeys[ row ], station );
+    emit dataChanged( index( row, 0 ), index( row, ColumnCount - 1 ) );
+}
+
+void StationModel::removeStations( QList< int > rows )
+{
+    TRACE_SCOPE( "StationModel::removeStations" );
+    qSort( rows );
+
+    // From the end, so rows before are not shifted.
+    int last = rows.count() - 1;
+    while ( last >= 0 )
+    {
+        int first = last;
+        while ( ( first > 0 ) && ( rows[ first - 1 ] == rows[ first ] - 1 ) )
+            --first;
+        removeRows( rows[ first ], rows[ last ] - rows[ first ] + 1 );
+        last = first - 1;
+    }
+}
+
+bool StationModel::moveStation( int from, int to )
+{
+    if ( ( from < 0 ) || ( from >= stationList.count() ) ||
+         ( to < 0 ) || ( to > stationList.count() ) ||
+         ( to == from ) || ( to == from + 1 ) )
+        return false;
+
+    beginMoveRows( QModelIndex(), from, from, QModelIndex(), to );
+    stationList.move( from, ( to > from ) ? to - 1 : to );
+    rowKeys.move( from, ( to > from ) ? to - 1 : to );
+    endMoveRows();
+    return true;
+}
+
+void StationModel::moveStations( QList< int > rows, int to )
+{
+    TRACE_SCOPE( "StationModel::moveStations" );
+    qSort( rows );
+
+    // Rows above the target are stacked just before it, from the bottom.
+    int target = to;
+    for ( int i = rows.count() - 1; i >= 0; --i )
+    {
+        if ( rows[ i ] < to )
+        {
+            moveStation( rows[ i ], target );
+            --target;
+        }
+    }
+
+    // Rows below the target follow it, from the top.
+    target = to;
+    for ( int i = 0; i < rows.count(); ++i )
+    {
+        if ( rows[ i ] >= to )
+        {
+            moveStation( rows[ i ], target );
+            ++target;
+        }
+    }
+}
+
+void StationModel::setStatus( const QString & url, int status )
+{
+    urlStatus.insert( url, status );
+
+    int first = -1;
+    int last = -1;
+    for ( int i = 0; i < stationList.count(); ++i )
+    {
+        if ( stationList[ i ].url == url )
+        {
+            if ( first < 0 )
+                first = i;
+            last = i;
+        }
+    }
+
+    if ( first >= 0 )
+        emit dataChanged( index( first, StatusColumn ), index( last, StatusColumn ) );
+}
+
+void StationModel::clearStatus()
+{
+    if ( urlStatus.isEmpty() )
+        return;
+
+    urlStatus.clear();
+    if ( !stationList.isEmpty() )
+        emit dataChanged( index( 0, StatusColumn ), index( stationList.count() - 1, StatusColumn ) );
+}
+
+quint32 StationModel::rowKey( int row ) const
+{
+    return rowKeys.value( row );
+}
+
+QList< quint32 > StationModel::search( const QString & query, int limit ) const
+{
+    return searchIndex.search( query, limit );
+}
+
+QString StationModel::statusText( const QString & url ) const
+{
+    QHash< QString, int >::const_iterator it = urlStatus.constFind( url );
+    if ( it == urlStatus.constEnd() )
+        return QString();
+
+    if ( it.value() < 0 )
+        return tr( "Checking..." );
+
+    return StationProber::resultString( static_cast< StationProber::Result >( it.value() ) );
+}
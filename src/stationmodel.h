@@ -0,0 +1,76 @@
+//
+// Station model: station list for item views.
+//
+// Every edit emits exact row signals ( insert, remove, move, change ), so
+// views keep their items and selection instead of being rebuilt.
+//
+#ifndef STATION_MODEL_H
+#define STATION_MODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QList>
+
+#include "station.h"
+#include "stationindex.h"
+
+class StationModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+    public:
+        // Table columns.
+        enum Column { NameColumn, DescriptionColumn, UrlColumn, EncodingColumn, StatusColumn, ColumnCount };
+
+        explicit StationModel( QObject * parent = 0 );
+
+        int rowCount( const QModelIndex & parent = QModelIndex() ) const;
+        int columnCount( const QModelIndex & parent = QModelIndex() ) const;
+        QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const;
+        QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole ) const;
+        Qt::ItemFlags flags( const QModelIndex & index ) const;
+        bool removeRows( int row, int count, const QModelIndex & parent = QModelIndex() );
+
+        // Drag and drop of rows inside the model.
+        Qt::DropActions supportedDropActions() const;
+        QStringList mimeTypes() const;
+        QMimeData * mimeData( const QModelIndexList & indexes ) const;
+        bool dropMimeData( const QMimeData * data, Qt::DropAction action,
+                           int row, int column, const QModelIndex & parent );
+
+        // Replace all stations ( model reset ).
+        void setStations( const QList< Station > & list );
+        const QList< Station > & stations() const;
+        const Station & station( int row ) const;
+        // Append stations to the end.
+        void appendStations( const QList< Station > & list );
+        // Replace station in row.
+        void setStation( int row, const Station & station );
+        // Remove rows, contiguous rows are removed at once.
+        void removeStations( QList< int > rows );
+        // Move row before row "to" ( index before move ).
+        bool moveStation( int from, int to );
+        // Move rows together before row "to", keeping their order.
+        void moveStations( QList< int > rows, int to );
+
+        // Set check status of url ( -1 while checking ).
+        void setStatus( const QString & url, int status );
+        void clearStatus();
+
+        // Search key of row, stays with the station while it moves.
+        quint32 rowKey( int row ) const;
+        // Keys of stations matching query, best first ( limit <= 0 - all, unordered ).
+        QList< quint32 > search( const QString & query, int limit = 0 ) const;
+
+    private:
+        QString statusText( const QString & url ) const;
+
+        QList< Station > stationList;
+        QList< quint32 > rowKeys;
+        quint32 nextKey;
+        StationIndex searchIndex;
+        // Check results of urls.
+        QHash< QString, int > urlStatus;
+};
+
+#endif
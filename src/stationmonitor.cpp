@@ -0,0 +1,317 @@
+//
+// Station monitor: background health checks of all stations.
+//
+#include "stationmonitor.h"
+#include "safefile.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <QSet>
+#include <QFile>
+#include <QDataStream>
+#include <QDateTime>
+
+// File signature "QRTH" and format version.
+#define HEALTH_MAGIC 0x51525448
+#define HEALTH_VERSION 1
+// Check results kept per station.
+#define HEALTH_SAMPLES 16
+// Failed checks in a row to call station dead.
+#define HEALTH_DEAD_AFTER 3
+// Slower response makes station degraded ( msec ).
+#define HEALTH_SLOW_RESPONSE 3000
+// Estimated traffic of one probe ( bytes ).
+#define HEALTH_PROBE_COST 16384
+// Shortest time between two probes ( msec ).
+#define HEALTH_MIN_SPACING 1000
+// Changed history is written after ( msec ).
+#define HEALTH_SAVE_DELAY 60000
+
+StationMonitor::StationMonitor( const QString & fileName, QObject * parent )
+    :QObject( parent ),
+     fileName( fileName ),
+     cursor( 0 ),
+     interval( 0 ),
+     maxConcurrent( 1 ),
+     bandwidth( 32 )
+{
+    prober.setMaxConcurrent( maxConcurrent );
+    connect( &prober, SIGNAL( probeMeasured( int, int, const QString &, int ) ),
+                      SLOT( onProbeMeasured( int, int, const QString &, int ) ) );
+    connect( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ),
+                      SLOT( onProbeFinished( int, StationProber::Result ) ) );
+    connect( &probeTimer, SIGNAL( timeout() ), SLOT( probeNext() ) );
+    saveTimer.setSingleShot( true );
+    saveTimer.setInterval( HEALTH_SAVE_DELAY );
+    connect( &saveTimer, SIGNAL( timeout() ), SLOT( save() ) );
+    load();
+}
+
+StationMonitor::~StationMonitor()
+{
+    prober.cancelAll();
+    if ( saveTimer.isActive() )
+        save();
+}
+
+void StationMonitor::setInterval( int msec )
+{
+    interval = qMax( 0, msec );
+    reschedule();
+}
+
+void StationMonitor::setMaxConcurrent( int count )
+{
+    maxConcurrent = qMax( 1, count );
+    prober.setMaxConcurrent( maxConcurrent );
+}
+
+void StationMonitor::setBandwidth( int kbps )
+{
+    bandwidth = qMax( 1, kbps );
+    reschedule();
+}
+
+void StationMonitor::setStations( const QList< Station > & stations )
+{
+    TRACE_SCOPE( "StationMonitor::setStations" );
+    QSet< QString > used;
+    urls.clear();
+    foreach ( const Station & station, stations )
+    {
+        if ( !station.url.isEmpty() && !used.contains( station.url ) )
+        {
+            used.insert( station.url );
+            urls.append( station.url );
+        }
+    }
+
+    foreach ( const QString & url, history.keys() )
+    {
+        if ( !used.contains( url ) )
+        {
+            history.remove( url );
+            saveTimer.start();
+        }
+    }
+
+    if ( cursor >= urls.count() )
+        cursor = 0;
+    reschedule();
+}
+
+StationMonitor::Health StationMonitor::health( const QString & url ) const
+{
+    return history.value( url ).health;
+}
+
+QString StationMonitor::summary( const QString & url ) const
+{
+    const QList< Sample > samples = history.value( url ).samples;
+    if ( samples.isEmpty() )
+        return QString();
+
+    const Sample & last = samples.last();
+    const QString time = QDateTime::fromMSecsSinceEpoch( last.time ).toString( Qt::DefaultLocaleShortDate );
+    if ( last.result != StationProber::Ok )
+    {
+        int failures = 0;
+        for ( int i = samples.count() - 1; ( i >= 0 ) && ( samples[ i ].result != StationProber::Ok ); --i )
+            ++failures;
+        return tr( "%1 ( %2 checks in a row, last %3 )" )
+               .arg( StationProber::resultString( StationProber::Result( last.result ) ) )
+               .arg( failures ).arg( time );
+    }
+
+    QString text = tr( "Responds in %1 msec" ).arg( last.responseTime );
+    if ( last.bitrate > 0 )
+        text += tr( ", %1 kbit/s" ).arg( last.bitrate );
+    if ( !last.contentType.isEmpty() )
+        text += ", " + last.contentType;
+    return tr( "%1 ( checked %2 )" ).arg( text ).arg( time );
+}
+
+void StationMonitor::probeNext()
+{
+    if ( ( running.count() >= maxConcurrent ) || urls.isEmpty() )
+        return;
+
+    // Next station in list order not checked within interval.
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for ( int i = 0; i < urls.count(); ++i )
+    {
+        const QString url = urls.at( cursor );
+        cursor = ( cursor + 1 ) % urls.count();
+
+        const QList< Sample > & samples = history[ url ].samples;
+        if ( !samples.isEmpty() && ( now - samples.last().time < interval ) )
+            continue;
+
+        const int id = prober.probe( url );
+        if ( id >= 0 )
+        {
+            running.insert( id, url );
+            LOG_DEBUG( "monitor", tr( "Checking %1." ).arg( url ) );
+        }
+        return;
+    }
+}
+
+void StationMonitor::onProbeMeasured( int id, int responseTime, const QString & contentType, int bitrate )
+{
+    if ( !running.contains( id ) )
+        return;
+
+    Sample & sample = measured[ id ];
+    sample.responseTime = responseTime;
+    sample.bitrate = bitrate;
+    sample.contentType = contentType;
+}
+
+void StationMonitor::onProbeFinished( int id, StationProber::Result result )
+{
+    if ( !running.contains( id ) )
+        return;
+
+    const QString url = running.take( id );
+    Sample sample = measured.take( id );
+    // Streams the prober can't check tell nothing about health.
+    if ( ( result == StationProber::Cancelled ) || ( result == StationProber::Unchecked ) ||
+         !history.contains( url ) )
+        return;
+
+    if ( result != StationProber::Ok )
+        sample.bitrate = 0;
+    sample.time = QDateTime::currentMSecsSinceEpoch();
+    sample.result = result;
+
+    History & entry = history[ url ];
+    entry.samples.append( sample );
+    while ( entry.samples.count() > HEALTH_SAMPLES )
+        entry.samples.removeFirst();
+    saveTimer.start();
+
+    TRACE_COUNTER( "monitor response", sample.responseTime );
+    const Health health = evaluate( entry.samples );
+    if ( health == entry.health )
+        return;
+
+    entry.health = health;
+    if ( health == Dead )
+        LOG_WARN( "monitor", tr( "Station %1 is dead: %2" ).arg( url ).arg( summary( url ) ) );
+    else
+        LOG_INFO( "monitor", tr( "Station %1 health changed: %2" ).arg( url ).arg( summary( url ) ) );
+    emit healthChanged( url, health );
+}
+
+void StationMonitor::save()
+{
+    TRACE_SCOPE( "StationMonitor::save" );
+    saveTimer.stop();
+
+    QByteArray data;
+    QDataStream out( &data, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    out << quint32( HEALTH_MAGIC ) << quint32( HEALTH_VERSION ) << quint32( history.count() );
+    QHash< QString, History >::const_iterator it = history.constBegin();
+    for ( ; it != history.constEnd(); ++it )
+    {
+        out << it.key() << quint32( it.value().samples.count() );
+        foreach ( const Sample & sample, it.value().samples )
+            out << sample.time << sample.result << sample.responseTime << sample.bitrate << sample.contentType;
+    }
+
+    // History is cheap to lose, no sync, but old file is replaced in one step.
+    const QString tempName = fileName + ".tmp";
+    QFile file( tempName );
+    if ( !file.open( QFile::WriteOnly | QFile::Truncate ) ||
+         ( file.write( data ) != data.size() ) || !file.flush() )
+    {
+        LOG_ERROR( "monitor", tr( "Can't write station history %1!" ).arg( tempName ) );
+        return;
+    }
+    file.close();
+
+    if ( !SafeFile::replace( tempName, fileName ) )
+        LOG_ERROR( "monitor", tr( "Can't replace station history %1!" ).arg( fileName ) );
+}
+
+void StationMonitor::load()
+{
+    TRACE_SCOPE( "StationMonitor::load" );
+    QFile file( fileName );
+    if ( !file.open( QFile::ReadOnly ) )
+        return;
+
+    QDataStream in( &file );
+    in.setVersion( QDataStream::Qt_4_6 );
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if ( ( magic != HEALTH_MAGIC ) || ( version != HEALTH_VERSION ) )
+    {
+        LOG_WARN( "monitor", tr( "Station history %1 is not readable, starting over." ).arg( fileName ) );
+        return;
+    }
+
+    for ( quint32 i = 0; ( i < count ) && ( in.status() == QDataStream::Ok ); ++i )
+    {
+        QString url;
+        quint32 samples = 0;
+        in >> url >> samples;
+        History entry;
+        for ( quint32 j = 0; ( j < samples ) && ( in.status() == QDataStream::Ok ); ++j )
+        {
+            Sample sample;
+            in >> sample.time >> sample.result >> sample.responseTime >> sample.bitrate >> sample.contentType;
+            entry.samples.append( sample );
+        }
+        if ( in.status() != QDataStream::Ok )
+            break;
+
+        while ( entry.samples.count() > HEALTH_SAMPLES )
+            entry.samples.removeFirst();
+        entry.health = evaluate( entry.samples );
+        history.insert( url, entry );
+    }
+
+    if ( in.status() != QDataStream::Ok )
+        LOG_WARN( "monitor", tr( "Station history %1 is truncated." ).arg( fileName ) );
+    LOG_INFO( "monitor", tr( "History of %1 stations loaded." ).arg( history.count() ) );
+}
+
+void StationMonitor::reschedule()
+{
+    if ( ( interval <= 0 ) || urls.isEmpty() )
+    {
+        probeTimer.stop();
+        return;
+    }
+
+    // Even spread over interval, but never faster than bandwidth allows.
+    const int share = interval / urls.count();
+    const int traffic = int( qint64( HEALTH_PROBE_COST ) * 8 / bandwidth );
+    const int spacing = qMax( HEALTH_MIN_SPACING, qMax( share, traffic ) );
+    if ( probeTimer.isActive() && ( probeTimer.interval() == spacing ) )
+        return;
+
+    probeTimer.start( spacing );
+    LOG_DEBUG( "monitor", tr( "Checking %1 stations, one every %2 msec." ).arg( urls.count() ).arg( spacing ) );
+}
+
+StationMonitor::Health StationMonitor::evaluate( const QList< Sample > & samples )
+{
+    if ( samples.isEmpty() )
+        return Unknown;
+
+    int failures = 0;
+    for ( int i = samples.count() - 1; ( i >= 0 ) && ( samples[ i ].result != StationProber::Ok ); --i )
+        ++failures;
+
+    if ( failures >= HEALTH_DEAD_AFTER )
+        return Dead;
+    if ( ( failures > 0 ) || ( samples.last().responseTime > HEALTH_SLOW_RESPONSE ) )
+        return Degraded;
+    return Healthy;
+}
@@ -0,0 +1,105 @@
+//
+// Station monitor: background health checks of all stations.
+//
+// Stations are probed one by one, spread evenly over check interval, so
+// the whole list is checked once per interval without bursts. Probes run
+// below concurrency limit and are spaced so their traffic stays below
+// bandwidth cap. Last results of each station are kept in history file,
+// station is dead after several failed checks in a row and degraded after
+// one failure or slow response.
+//
+#ifndef STATION_MONITOR_H
+#define STATION_MONITOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QTimer>
+
+#include "station.h"
+#include "stationprober.h"
+
+class StationMonitor : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Station health.
+        enum Health { Unknown, Healthy, Degraded, Dead };
+
+        explicit StationMonitor( const QString & fileName, QObject * parent = 0 );
+        ~StationMonitor();
+
+        // Time to check every station once ( msec, 0 - monitoring off ).
+        void setInterval( int msec );
+        // Maximum number of probes running at once.
+        void setMaxConcurrent( int count );
+        // Traffic cap of probes ( kbit/s ).
+        void setBandwidth( int kbps );
+        // Stations to watch, history of others is forgotten.
+        void setStations( const QList< Station > & stations );
+
+        Health health( const QString & url ) const;
+        // Human readable result of last check ( empty if never checked ).
+        QString summary( const QString & url ) const;
+
+    signals:
+        void healthChanged( const QString & url, StationMonitor::Health health );
+
+    private slots:
+        // Probe next station due for check.
+        void probeNext();
+        void onProbeMeasured( int id, int responseTime, const QString & contentType, int bitrate );
+        void onProbeFinished( int id, StationProber::Result result );
+        // Write history file.
+        void save();
+
+    private:
+        // Single check result.
+        struct Sample
+        {
+            Sample() : time( 0 ), result( 0 ), responseTime( -1 ), bitrate( 0 ) {}
+
+            // Check time ( msec since epoch ).
+            qint64 time;
+            qint32 result;
+            // Time to response head ( msec, -1 - no response ).
+            qint32 responseTime;
+            // Advertised bitrate ( kbit/s, 0 - unknown ).
+            qint32 bitrate;
+            QString contentType;
+        };
+
+        // Check results of station, newest last.
+        struct History
+        {
+            History() : health( Unknown ) {}
+
+            QList< Sample > samples;
+            Health health;
+        };
+
+        // Read history file.
+        void load();
+        // Restart probe timer for current list and limits.
+        void reschedule();
+        static Health evaluate( const QList< Sample > & samples );
+
+        StationProber prober;
+        QString fileName;
+        QHash< QString, History > history;
+        // Unique urls in list order.
+        QStringList urls;
+        int cursor;
+        // Running probes: id to url and measured values.
+        QHash< int, QString > running;
+        QHash< int, Sample > measured;
+        QTimer probeTimer;
+        QTimer saveTimer;
+        int interval;
+        int maxConcurrent;
+        int bandwidth;
+};
+
+#endif
@@ -0,0 +1,384 @@
+//
+// Station prober.
+//
+#include "stationprober.h"
+#include "icyclient.h"
+#include "logger.h"
+
+#include <QUrl>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+// Default timeout of station probe ( in msec ).
+#define PROBE_TIMEOUT 10000
+// Default number of probes running at once.
+#define PROBE_CONCURRENCY 4
+// Watchdog period ( in msec ).
+#define PROBE_WATCHDOG_INTERVAL 250
+// Maximum number of followed redirects.
+#define PROBE_MAX_REDIRECTS 5
+// Network read buffer size of probe ( in bytes ).
+#define PROBE_BUFFER_SIZE 16384
+// Bytes enough to recognize stream signature.
+#define PROBE_SNIFF_SIZE 4096
+
+StationProber::StationProber( QObject * parent )
+    :QObject( parent ),
+     manager( new QNetworkAccessManager( this ) ),
+     nextId( 0 ),
+     maxConcurrent( PROBE_CONCURRENCY ),
+     timeout( PROBE_TIMEOUT )
+{
+    watchdog.setInterval( PROBE_WATCHDOG_INTERVAL );
+    connect( &watchdog, SIGNAL( timeout() ), SLOT( checkTimeouts() ) );
+}
+
+StationProber::~StationProber()
+{
+    blockSignals( true );
+    cancelAll();
+}
+
+int StationProber::probe( const QString & url )
+{
+    if ( url.isEmpty() )
+        return -1;
+
+    Probe probe;
+    probe.id = nextId++;
+    probe.url = url;
+    probe.client = 0;
+    probe.reply = 0;
+    probe.redirects = 0;
+    probe.responseTime = -1;
+    probe.bitrate = 0;
+    probes.insert( probe.id, probe );
+    queue.append( probe.id );
+    LOG_DEBUG( "prober", tr( "Probe #%1 queued for url %2." ).arg( probe.id ).arg( url ) );
+
+    // Start later so caller gets id before any signal.
+    QMetaObject::invokeMethod( this, "startQueued", Qt::QueuedConnection );
+    return probe.id;
+}
+
+void StationProber::cancel( int id )
+{
+    finish( id, Cancelled );
+}
+
+void StationProber::cancelAll()
+{
+    foreach ( int id, probes.keys() )
+        finish( id, Cancelled );
+}
+
+void StationProber::setMaxConcurrent( int count )
+{
+    maxConcurrent = qMax( 1, count );
+    QMetaObject::invokeMethod( this, "startQueued", Qt::QueuedConnection );
+}
+
+void StationProber::setTimeout( int msec )
+{
+    timeout = ( msec > 0 ) ? msec : PROBE_TIMEOUT;
+}
+
+int StationProber::pendingCount() const
+{
+    return probes.count();
+}
+
+QString StationProber::resultString( Result result )
+{
+    switch ( result )
+    {
+        case Ok         : return tr( "OK" );
+        case Unchecked  : return tr( "Not checked" );
+        case Unreachable: return tr( "Unreachable" );
+        case BadStatus  : return tr( "Bad server response" );
+        case BadContent : return tr( "Unsupported stream" );
+        case Timeout    : return tr( "Timeout" );
+        case Cancelled  : return tr( "Cancelled" );
+    }
+
+    return QString();
+}
+
+void StationProber::startQueued()
+{
+    while ( !queue.isEmpty() && ( requests.count() < maxConcurrent ) )
+    {
+        const int id = queue.takeFirst();
+        if ( !probes.contains( id ) )
+            continue;
+
+        probes[ id ].elapsed.start();
+        emit probeStarted( id );
+        // Receiver may cancel probe right away.
+        if ( !probes.contains( id ) )
+            continue;
+
+        Probe & probe = probes[ id ];
+        const QUrl url( probe.url );
+        const QString scheme = url.scheme().toLower();
+        if ( scheme == "http" )
+            connectClient( probe, url );
+        else if ( scheme == "https" )
+            request( probe, url );
+        else if ( scheme.isEmpty() || ( scheme == "file" ) )
+        {
+            const QString fileName = scheme.isEmpty() ? probe.url : url.toLocalFile();
+            finish( id, QFile::exists( fileName ) ? Ok : Unreachable );
+        }
+        else
+        {
+            // Streaming protocols ( mms, rtsp ) are left to the backend.
+            finish( id, Unchecked );
+        }
+    }
+
+    if ( requests.isEmpty() )
+        watchdog.stop();
+    else if ( !watchdog.isActive() )
+        watchdog.start();
+}
+
+void StationProber::connectClient( Probe & probe, const QUrl & url )
+{
+    // Audio is only reported, redirects are followed by client.
+    probe.client = new IcyClient( 0, this );
+    requests.insert( probe.client, probe.id );
+    connect( probe.client, SIGNAL( streamStarted() ), SLOT( onStreamStarted() ) );
+    connect( probe.client, SIGNAL( audioReceived( const QByteArray &, int, int ) ),
+                           SLOT( onAudioReceived( const QByteArray &, int, int ) ) );
+    connect( probe.client, SIGNAL( failed( const QString & ) ), SLOT( onStreamFailed() ) );
+    probe.client->open( url );
+}
+
+void StationProber::onStreamStarted()
+{
+    IcyClient * client = qobject_cast< IcyClient * >( sender() );
+    if ( !client || !requests.contains( client ) )
+        return;
+
+    const int id = requests.value( client );
+    Probe & probe = probes[ id ];
+    probe.responseTime = int( probe.elapsed.elapsed() );
+    probe.bitrate = client->bitrate();
+    probe.contentType = QString::fromLatin1( client->contentType() );
+    if ( probe.contentType.startsWith( "text/html", Qt::CaseInsensitive ) )
+        finish( id, BadContent );
+    else if ( isAudioType( probe.contentType ) )
+        finish( id, Ok );
+}
+
+void StationProber::onAudioReceived( const QByteArray & chunk, int offset, int length )
+{
+    IcyClient * client = qobject_cast< IcyClient * >( sender() );
+    if ( !client || !requests.contains( client ) )
+        return;
+
+    // Unknown content type - look at first bytes.
+    const int id = requests.value( client );
+    QByteArray & sniffed = probes[ id ].sniffed;
+    sniffed.append( chunk.constData() + offset, qMin( length, PROBE_SNIFF_SIZE - sniffed.size() ) );
+    if ( isAudioData( sniffed ) )
+        finish( id, Ok );
+    else if ( sniffed.size() >= PROBE_SNIFF_SIZE )
+        finish( id, BadContent );
+}
+
+void StationProber::onStreamFailed()
+{
+    IcyClient * client = qobject_cast< IcyClient * >( sender() );
+    if ( !client || !requests.contains( client ) )
+        return;
+
+    const int id = requests.value( client );
+    const int status = client->statusCode();
+    if ( status == 200 )
+    {
+        // Whole ( short ) body received without decision.
+        finish( id, isAudioData( probes.value( id ).sniffed ) ? Ok : BadContent );
+    }
+    else
+        finish( id, ( status > 0 ) ? BadStatus : Unreachable );
+}
+
+void StationProber::request( Probe & probe, const QUrl & url )
+{
+    QNetworkRequest request( url );
+    request.setRawHeader( "User-Agent", "QRadioTray" );
+    request.setRawHeader( "Icy-MetaData", "0" );
+
+    probe.reply = manager->get( request );
+    probe.reply->setReadBufferSize( PROBE_BUFFER_SIZE );
+    requests.insert( probe.reply, probe.id );
+    connect( probe.reply, SIGNAL( metaDataChanged() ), SLOT( onMetaDataChanged() ) );
+    connect( probe.reply, SIGNAL( readyRead() ), SLOT( onReadyRead() ) );
+    connect( probe.reply, SIGNAL( finished() ), SLOT( onFinished() ) );
+}
+
+void StationProber::onMetaDataChanged()
+{
+    QNetworkReply * reply = qobject_cast< QNetworkReply * >( sender() );
+    if ( !reply || !requests.contains( reply ) )
+        return;
+
+    const int id = requests.value( reply );
+    Probe & probe = probes[ id ];
+
+    const QVariant redirect = reply->attribute( QNetworkRequest::RedirectionTargetAttribute );
+    if ( redirect.isValid() )
+    {
+        if ( ++probe.redirects > PROBE_MAX_REDIRECTS )
+        {
+            finish( id, BadStatus );
+            return;
+        }
+
+        const QUrl target = reply->url().resolved( redirect.toUrl() );
+        LOG_DEBUG( "prober", tr( "Probe #%1 redirected to %2." ).arg( id ).arg( target.toString() ) );
+        requests.remove( reply );
+        reply->disconnect( this );
+        reply->abort();
+        reply->deleteLater();
+        request( probe, target );
+        return;
+    }
+
+    probe.responseTime = int( probe.elapsed.elapsed() );
+    probe.bitrate = reply->rawHeader( "icy-br" ).split( ',' ).value( 0 ).toInt();
+    probe.contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toString();
+
+    const QVariant status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute );
+    if ( status.isValid() && ( ( status.toInt() < 200 ) || ( status.toInt() >= 300 ) ) )
+    {
+        finish( id, BadStatus );
+        return;
+    }
+
+    const QString contentType = probe.contentType;
+    if ( contentType.startsWith( "text/html", Qt::CaseInsensitive ) )
+        finish( id, BadContent );
+}
+
+void StationProber::onReadyRead()
+{
+    QNetworkReply * reply = qobject_cast< QNetworkReply * >( sender() );
+    if ( !reply || !requests.contains( reply ) )
+        return;
+
+    const int id = requests.value( reply );
+    const QString contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toString();
+    if ( isAudioType( contentType ) )
+    {
+        finish( id, Ok );
+        return;
+    }
+
+    // Unknown content type - look at first bytes.
+    const QByteArray data = reply->peek( PROBE_SNIFF_SIZE );
+    if ( isAudioData( data ) )
+        finish( id, Ok );
+    else if ( data.size() >= PROBE_SNIFF_SIZE )
+        finish( id, BadContent );
+}
+
+void StationProber::onFinished()
+{
+    QNetworkReply * reply = qobject_cast< QNetworkReply * >( sender() );
+    if ( !reply || !requests.contains( reply ) )
+        return;
+
+    const int id = requests.value( reply );
+    if ( reply->error() != QNetworkReply::NoError )
+    {
+        LOG_DEBUG( "prober", tr( "Probe #%1 error \"%2\"." ).arg( id ).arg( reply->errorString() ) );
+        const QVariant status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute );
+        finish( id, status.isValid() ? BadStatus : Unreachable );
+        return;
+    }
+
+    // Whole ( short ) body received without decision.
+    const QByteArray data = reply->peek( PROBE_SNIFF_SIZE );
+    const QString contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toString();
+    if ( !data.isEmpty() && ( isAudioType( contentType ) || isAudioData( data ) ) )
+        finish( id, Ok );
+    else
+        finish( id, BadContent );
+}
+
+void StationProber::checkTimeouts()
+{
+    QList< int > expired;
+    foreach ( int id, requests )
+    {
+        if ( probes.value( id ).elapsed.hasExpired( timeout ) )
+            expired.append( id );
+    }
+
+    foreach ( int id, expired )
+        finish( id, Timeout );
+}
+
+void StationProber::finish( int id, Result result )
+{
+    if ( !probes.contains( id ) )
+        return;
+
+    const Probe probe = probes.take( id );
+    queue.removeAll( id );
+    if ( probe.client )
+    {
+        requests.remove( probe.client );
+        probe.client->disconnect( this );
+        probe.client->close();
+        probe.client->deleteLater();
+    }
+    if ( probe.reply )
+    {
+        requests.remove( probe.reply );
+        probe.reply->disconnect( this );
+        probe.reply->abort();
+        probe.reply->deleteLater();
+    }
+
+    LOG_DEBUG( "prober", tr( "Probe #%1 result: %2." ).arg( id ).arg( resultString( result ) ) );
+    if ( result != Cancelled )
+        emit probeMeasured( id, probe.responseTime, probe.contentType, probe.bitrate );
+    emit probeFinished( id, result );
+    startQueued();
+}
+
+bool StationProber::isAudioType( const QString & contentType )
+{
+    const QString type = contentType.section( ';', 0, 0 ).trimmed().toLower();
+    return type.startsWith( "audio/" ) ||
+           ( type == "application/ogg" ) ||
+           ( type == "application/x-ogg" ) ||
+           ( type == "application/x-mpegurl" ) ||
+           ( type == "application/vnd.apple.mpegurl" ) ||
+           ( type == "application/pls+xml" ) ||
+           ( type == "application/xspf+xml" );
+}
+
+bool StationProber::isAudioData( const QByteArray & data )
+{
+    if ( data.startsWith( "ID3" ) || data.startsWith( "OggS" ) || data.startsWith( "fLaC" ) ||
+         data.startsWith( "#EXTM3U" ) || data.startsWith( "\x30\x26\xB2\x75" ) ||
+         data.left( 10 ).toLower().startsWith( "[playlist]" ) )
+        return true;
+
+    // MPEG audio or ADTS frame sync.
+    for ( int i = 0; i + 1 < data.size(); ++i )
+    {
+        if ( ( static_cast< uchar >( data[ i ] ) == 0xFF ) &&
+             ( ( static_cast< uchar >( data[ i + 1 ] ) & 0xE0 ) == 0xE0 ) )
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,105 @@
+//
+// Station prober.
+//
+#ifndef STATION_PROBER_H
+#define STATION_PROBER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QUrl;
+class QNetworkAccessManager;
+class QNetworkReply;
+class IcyClient;
+
+class StationProber : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Probe result.
+        enum Result { Ok, Unchecked, Unreachable, BadStatus, BadContent, Timeout, Cancelled };
+
+        explicit StationProber( QObject * parent = 0 );
+        ~StationProber();
+
+        // Queue url check, returns probe id ( -1 if url is empty ).
+        int probe( const QString & url );
+        // Abort probe ( running or queued ).
+        void cancel( int id );
+        // Abort all probes.
+        void cancelAll();
+        // Maximum number of probes running at once.
+        void setMaxConcurrent( int count );
+        // Per-probe timeout ( in msec ).
+        void setTimeout( int msec );
+        // Number of probes not finished yet.
+        int pendingCount() const;
+        // Human readable result.
+        static QString resultString( Result result );
+
+    signals:
+        // Probe left the queue and connects to the host.
+        void probeStarted( int id );
+        // Probe finished ( successfully or not ).
+        void probeFinished( int id, StationProber::Result result );
+        // Sent before probeFinished unless cancelled: time to response head
+        // ( msec, -1 - no response ), content type and bitrate from icy-br ( 0 - unknown ).
+        void probeMeasured( int id, int responseTime, const QString & contentType, int bitrate );
+
+    private slots:
+        // Start queued probes while below concurrency limit.
+        void startQueued();
+        // Plain HTTP and ICY probe ( Qt's HTTP parser rejects "ICY 200 OK" ).
+        void onStreamStarted();
+        void onAudioReceived( const QByteArray & chunk, int offset, int length );
+        void onStreamFailed();
+        // HTTPS probe.
+        void onMetaDataChanged();
+        void onReadyRead();
+        void onFinished();
+        void checkTimeouts();
+
+    private:
+        // Single probe state.
+        struct Probe
+        {
+            int id;
+            QString url;
+            IcyClient * client;
+            QNetworkReply * reply;
+            QElapsedTimer elapsed;
+            int redirects;
+            int responseTime;
+            QString contentType;
+            int bitrate;
+            // First audio bytes of ICY probe.
+            QByteArray sniffed;
+        };
+
+        // Open stream of probe.
+        void connectClient( Probe & probe, const QUrl & url );
+        // Send HTTPS request for probe.
+        void request( Probe & probe, const QUrl & url );
+        // Stop probe and emit result.
+        void finish( int id, Result result );
+        // Is content type of audio stream or playlist.
+        static bool isAudioType( const QString & contentType );
+        // Is data starts with known audio stream signature.
+        static bool isAudioData( const QByteArray & data );
+
+        QNetworkAccessManager * manager;
+        QHash< int, Probe > probes;
+        // Running probes by their client or reply.
+        QHash< QObject *, int > requests;
+        QList< int > queue;
+        QTimer watchdog;
+        int nextId;
+        int maxConcurrent;
+        int timeout;
+};
+
+#endif
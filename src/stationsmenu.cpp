@@ -0,0 +1,307 @@
+//
+// Stations menu: keeps one action per station and applies list changes.
+//
+#include "stationsmenu.h"
+#include "tracer.h"
+
+#include <QSet>
+#include <QActionGroup>
+#include <QWidgetAction>
+#include <QLineEdit>
+#include <QKeyEvent>
+#include <QApplication>
+
+// Default maximum stations shown without submenus.
+#define STATIONS_FLAT_LIMIT 40
+// Maximum search results shown.
+#define STATIONS_SEARCH_RESULTS 20
+
+StationsMenu::StationsMenu( QWidget * parent )
+    :QMenu( parent ),
+     group( new QActionGroup( this ) ),
+     current( 0 ),
+     flatLimit( STATIONS_FLAT_LIMIT ),
+     searchEdit( new QLineEdit ),
+     searchAction( new QWidgetAction( this ) ),
+     searchSeparator( new QAction( this ) )
+{
+    group->setExclusive( true );
+    connect( group, SIGNAL( triggered( QAction * ) ), SLOT( onTriggered( QAction * ) ) );
+    connect( group, SIGNAL( hovered( QAction * ) ), SLOT( onHovered( QAction * ) ) );
+
+    searchEdit->setPlaceholderText( tr( "Search" ) );
+    searchAction->setDefaultWidget( searchEdit );
+    searchSeparator->setSeparator( true );
+    connect( searchEdit, SIGNAL( textChanged( const QString & ) ), SLOT( onSearchChanged( const QString & ) ) );
+    connect( searchEdit, SIGNAL( returnPressed() ), SLOT( onSearchAccepted() ) );
+    connect( this, SIGNAL( aboutToShow() ), SLOT( onAboutToShow() ) );
+    connect( this, SIGNAL( aboutToHide() ), SLOT( onAboutToHide() ) );
+}
+
+void StationsMenu::setFlatLimit( int count )
+{
+    flatLimit = ( count > 0 ) ? count : STATIONS_FLAT_LIMIT;
+}
+
+void StationsMenu::setCurrent( quint32 id )
+{
+    current = id;
+    if ( stationActions.contains( id ) )
+        stationActions.value( id )->setChecked( true );
+}
+
+void StationsMenu::setHealth( quint32 id, StationMonitor::Health health, const QString & summary )
+{
+    Mark mark;
+    mark.health = health;
+    mark.summary = summary;
+    marks.insert( id, mark );
+    if ( stationActions.contains( id ) )
+        actionFor( stations.value( id ) );
+}
+
+void StationsMenu::setStations( const QList< Station > & list )
+{
+    TRACE_SCOPE( "StationsMenu::setStations" );
+
+    QSet< quint32 > keep;
+    order.clear();
+    order.reserve( list.count() );
+    foreach ( const Station & station, list )
+    {
+        keep.insert( station.id );
+        order.append( station.id );
+
+        // Only new or renamed stations are reindexed.
+        QHash< quint32, Station >::const_iterator old = stations.constFind( station.id );
+        if ( ( old == stations.constEnd() ) || ( old.value().name != station.name ) ||
+             ( old.value().description != station.description ) )
+            searchIndex.insert( station.id, station );
+        stations.insert( station.id, station );
+
+        // Existing actions are renamed in place.
+        if ( stationActions.contains( station.id ) )
+            actionFor( station );
+    }
+
+    foreach ( quint32 id, stations.keys() )
+    {
+        if ( !keep.contains( id ) )
+        {
+            stations.remove( id );
+            marks.remove( id );
+            searchIndex.remove( id );
+            delete stationActions.take( id );
+        }
+    }
+
+    if ( list.count() <= flatLimit )
+    {
+        removeGroups();
+        content = actionsFor( order );
+        showContent();
+        return;
+    }
+
+    // Split into groups, only changed groups will be rebuilt.
+    QMap< QString, QList< quint32 > > split;
+    foreach ( const Station & station, list )
+        split[ groupKey( station ) ].append( station.id );
+
+    foreach ( const QString & key, groups.keys() )
+    {
+        if ( !split.contains( key ) )
+        {
+            Group removed = groups.take( key );
+            groupKeys.remove( removed.menu );
+            delete removed.menu;
+        }
+    }
+
+    QList< QAction * > menus;
+    QMap< QString, QList< quint32 > >::const_iterator it = split.constBegin();
+    for ( ; it != split.constEnd(); ++it )
+    {
+        if ( !groups.contains( it.key() ) )
+        {
+            Group added;
+            added.menu = new QMenu( it.key(), this );
+            added.dirty = true;
+            connect( added.menu, SIGNAL( aboutToShow() ), SLOT( populateGroup() ) );
+            groups.insert( it.key(), added );
+            groupKeys.insert( added.menu, it.key() );
+        }
+
+        Group & item = groups[ it.key() ];
+        if ( item.ids != it.value() )
+        {
+            item.ids = it.value();
+            item.dirty = true;
+        }
+        menus.append( item.menu->menuAction() );
+    }
+    content = menus;
+    showContent();
+}
+
+void StationsMenu::onTriggered( QAction * action )
+{
+    if ( !action )
+        return;
+
+    current = action->data().toUInt();
+    emit stationTriggered( current );
+}
+
+void StationsMenu::onHovered( QAction * action )
+{
+    if ( action )
+        emit stationHovered( action->data().toUInt() );
+}
+
+void StationsMenu::populateGroup()
+{
+    TRACE_SCOPE( "StationsMenu::populateGroup" );
+    QMenu * menu = qobject_cast< QMenu * >( sender() );
+    if ( !menu || !groupKeys.contains( menu ) )
+        return;
+
+    Group & item = groups[ groupKeys.value( menu ) ];
+    if ( !item.dirty )
+        return;
+
+    arrange( item.menu, actionsFor( item.ids ) );
+    item.dirty = false;
+}
+
+void StationsMenu::onSearchChanged( const QString & text )
+{
+    Q_UNUSED( text );
+    TRACE_SCOPE( "StationsMenu::onSearchChanged" );
+    showContent();
+}
+
+void StationsMenu::onSearchAccepted()
+{
+    if ( results.isEmpty() )
+        return;
+
+    // Activate as if chosen by keyboard, so all menus close.
+    setActiveAction( results.first() );
+    QKeyEvent press( QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier );
+    QApplication::sendEvent( this, &press );
+}
+
+void StationsMenu::onAboutToShow()
+{
+    if ( order.count() > flatLimit )
+        searchEdit->setFocus();
+}
+
+void StationsMenu::onAboutToHide()
+{
+    searchEdit->clear();
+}
+
+QString StationsMenu::groupKey( const Station & station )
+{
+    const QString name = station.name.trimmed();
+    if ( name.isEmpty() || !name.at( 0 ).isLetter() )
+        return "#";
+
+    // Base letter without diacritic.
+    const QString base = name.at( 0 ).decomposition();
+    return ( base.isEmpty() ? name.left( 1 ) : base.left( 1 ) ).toUpper();
+}
+
+QAction * StationsMenu::actionFor( const Station & station )
+{
+    QAction * action = stationActions.value( station.id );
+    if ( !action )
+    {
+        action = new QAction( group );
+        action->setCheckable( true );
+        action->setData( station.id );
+        action->setChecked( station.id == current );
+        stationActions.insert( station.id, action );
+    }
+
+    if ( action->text() != station.name )
+        action->setText( station.name );
+
+    // Dead stations are struck out, degraded ones are italic.
+    const Mark mark = marks.value( station.id );
+    QString toolTip = station.description;
+    if ( !mark.summary.isEmpty() )
+        toolTip += ( toolTip.isEmpty() ? "" : "\n" ) + mark.summary;
+    if ( action->toolTip() != toolTip )
+        action->setToolTip( toolTip );
+
+    QFont font = action->font();
+    if ( ( font.strikeOut() != ( mark.health == StationMonitor::Dead ) ) ||
+         ( font.italic() != ( mark.health == StationMonitor::Degraded ) ) )
+    {
+        font.setStrikeOut( mark.health == StationMonitor::Dead );
+        font.setItalic( mark.health == StationMonitor::Degraded );
+        action->setFont( font );
+    }
+    return action;
+}
+
+QList< QAction * > StationsMenu::actionsFor( const QList< quint32 > & ids )
+{
+    QList< QAction * > list;
+    list.reserve( ids.count() );
+    foreach ( quint32 id, ids )
+        list.append( actionFor( stations.value( id ) ) );
+    return list;
+}
+
+void StationsMenu::arrange( QMenu * target, const QList< QAction * > & wanted )
+{
+    QList< QAction * > present = target->actions();
+    for ( int i = 0; i < wanted.count(); ++i )
+    {
+        QAction * action = wanted[ i ];
+        if ( ( i < present.count() ) && ( present[ i ] == action ) )
+            continue;
+
+        // Insert ( or move ) action before the one at its place.
+        QAction * before = ( i < present.count() ) ? present[ i ] : 0;
+        target->insertAction( before, action );
+        present.removeOne( action );
+        present.insert( i, action );
+    }
+
+    for ( int i = wanted.count(); i < present.count(); ++i )
+        target->removeAction( present[ i ] );
+}
+
+void StationsMenu::removeGroups()
+{
+    foreach ( const Group & item, groups )
+        delete item.menu;
+    groups.clear();
+    groupKeys.clear();
+}
+
+void StationsMenu::showContent()
+{
+    QList< QAction * > wanted;
+    results.clear();
+    if ( order.count() <= flatLimit )
+        wanted = content;
+    else
+    {
+        wanted << searchAction << searchSeparator;
+        if ( searchEdit->text().trimmed().isEmpty() )
+            wanted += content;
+        else
+        {
+            results = actionsFor( searchIndex.search( searchEdit->text(), STATIONS_SEARCH_RESULTS ) );
+            wanted += results;
+        }
+    }
+
+    arrange( this, wanted );
+}
@@ -0,0 +1,105 @@
+//
+// Stations menu: keeps one action per station and applies list changes.
+//
+// Short lists are shown flat. Long lists are grouped into submenus by first
+// letter, actions of a submenu are created when it is about to show. Long
+// lists also get a search box, typed text replaces the menu with the best
+// matches.
+//
+#ifndef STATIONS_MENU_H
+#define STATIONS_MENU_H
+
+#include <QMenu>
+#include <QHash>
+#include <QMap>
+
+#include "station.h"
+#include "stationindex.h"
+#include "stationmonitor.h"
+
+class QActionGroup;
+class QLineEdit;
+class QWidgetAction;
+
+class StationsMenu : public QMenu
+{
+    Q_OBJECT
+
+    public:
+        explicit StationsMenu( QWidget * parent = 0 );
+
+        // Apply new station list, unchanged actions are kept.
+        void setStations( const QList< Station > & list );
+        // Maximum stations shown without submenus.
+        void setFlatLimit( int count );
+        // Check action of station.
+        void setCurrent( quint32 id );
+        // Mark station by health, summary is added to tooltip.
+        void setHealth( quint32 id, StationMonitor::Health health, const QString & summary );
+
+    signals:
+        void stationTriggered( quint32 id );
+        // Station highlighted, likely to be chosen.
+        void stationHovered( quint32 id );
+
+    private slots:
+        void onTriggered( QAction * action );
+        void onHovered( QAction * action );
+        // Build actions of submenu being shown.
+        void populateGroup();
+        void onSearchChanged( const QString & text );
+        // Trigger best match.
+        void onSearchAccepted();
+        void onAboutToShow();
+        void onAboutToHide();
+
+    private:
+        // Submenu of stations.
+        struct Group
+        {
+            QMenu * menu;
+            QList< quint32 > ids;
+            bool dirty;
+        };
+
+        // Health mark of station.
+        struct Mark
+        {
+            Mark() : health( StationMonitor::Unknown ) {}
+
+            StationMonitor::Health health;
+            QString summary;
+        };
+
+        // Submenu title of station.
+        static QString groupKey( const Station & station );
+        // Existing ( updated ) or new action of station.
+        QAction * actionFor( const Station & station );
+        // Make menu contain exactly wanted actions in wanted order.
+        static void arrange( QMenu * target, const QList< QAction * > & wanted );
+        // Actions of stations, created on demand.
+        QList< QAction * > actionsFor( const QList< quint32 > & ids );
+        void removeGroups();
+        // Show search results or normal content.
+        void showContent();
+
+        QActionGroup * group;
+        QHash< quint32, QAction * > stationActions;
+        QHash< quint32, Station > stations;
+        QHash< quint32, Mark > marks;
+        QList< quint32 > order;
+        QMap< QString, Group > groups;
+        QHash< QMenu *, QString > groupKeys;
+        quint32 current;
+        int flatLimit;
+        // Stations or submenus shown without search.
+        QList< QAction * > content;
+        StationIndex searchIndex;
+        QLineEdit * searchEdit;
+        QWidgetAction * searchAction;
+        QAction * searchSeparator;
+        // Current matches, best first.
+        QList< QAction * > results;
+};
+
+#endif
@@ -0,0 +1,163 @@
+//
+// Stream buffer: bounded queue of audio chunks feeding Phonon.
+//
+#include "streambuffer.h"
+#include "tracer.h"
+
+StreamBuffer::StreamBuffer( int capacity, QObject * parent )
+    :Phonon::AbstractMediaStream( parent ),
+     buffered( 0 ),
+     limit( capacity ),
+     dropped( 0 ),
+     wanted( false ),
+     ended( false ),
+     target( 0 ),
+     primed( false ),
+     primingPercent( -1 )
+{
+    // Live stream: no size, no seeking.
+    setStreamSize( -1 );
+    setStreamSeekable( false );
+}
+
+void StreamBuffer::append( const QByteArray & chunk, int offset, int length )
+{
+    if ( ended || ( length <= 0 ) )
+        return;
+
+    Segment segment;
+    segment.chunk = chunk;
+    segment.offset = offset;
+    segment.length = length;
+    segments.enqueue( segment );
+    buffered += length;
+
+    // Drop oldest audio over capacity.
+    while ( ( buffered > limit ) && !segments.isEmpty() )
+    {
+        Segment & head = segments.head();
+        const int excess = int( qMin< qint64 >( buffered - limit, head.length ) );
+        head.offset += excess;
+        head.length -= excess;
+        buffered -= excess;
+        dropped += excess;
+        if ( head.length == 0 )
+            segments.dequeue();
+    }
+
+    TRACE_COUNTER( "stream buffer", buffered );
+    feed();
+}
+
+void StreamBuffer::finish()
+{
+    ended = true;
+    feed();
+}
+
+void StreamBuffer::clear()
+{
+    segments.clear();
+    buffered = 0;
+    TRACE_COUNTER( "stream buffer", buffered );
+}
+
+qint64 StreamBuffer::fill() const
+{
+    return buffered;
+}
+
+int StreamBuffer::capacity() const
+{
+    return limit;
+}
+
+void StreamBuffer::setCapacity( int bytes )
+{
+    // Applies to data appended from now on.
+    limit = qMax( 1, bytes );
+}
+
+qint64 StreamBuffer::droppedBytes() const
+{
+    return dropped;
+}
+
+void StreamBuffer::setPrebuffer( int bytes )
+{
+    // Leave room for incoming data while waiting.
+    target = qBound( 0, bytes, limit * 3 / 4 );
+    feed();
+}
+
+int StreamBuffer::prebuffer() const
+{
+    return target;
+}
+
+void StreamBuffer::rebuffer()
+{
+    primed = false;
+    primingPercent = -1;
+    feed();
+}
+
+bool StreamBuffer::isPrimed() const
+{
+    return primed;
+}
+
+void StreamBuffer::needData()
+{
+    wanted = true;
+    feed();
+}
+
+void StreamBuffer::enoughData()
+{
+    wanted = false;
+}
+
+void StreamBuffer::reset()
+{
+    // Live stream can't be rewound, playback continues from current data.
+}
+
+void StreamBuffer::feed()
+{
+    if ( !primed )
+    {
+        if ( ( buffered < target ) && !ended )
+        {
+            const int percent = int( buffered * 100 / qMax( target, 1 ) );
+            if ( percent != primingPercent )
+            {
+                primingPercent = percent;
+                emit priming( percent );
+            }
+            return;
+        }
+
+        primed = true;
+        primingPercent = -1;
+        emit priming( 100 );
+    }
+
+    while ( wanted && !segments.isEmpty() )
+    {
+        const Segment segment = segments.dequeue();
+        buffered -= segment.length;
+
+        // Backend may keep the array, so only whole chunks go without copy.
+        if ( ( segment.offset == 0 ) && ( segment.length == segment.chunk.size() ) )
+            writeData( segment.chunk );
+        else
+            writeData( segment.chunk.mid( segment.offset, segment.length ) );
+    }
+
+    if ( wanted && ended && segments.isEmpty() )
+    {
+        wanted = false;
+        endOfData();
+    }
+}
@@ -0,0 +1,78 @@
+//
+// Stream buffer: bounded queue of audio chunks feeding Phonon.
+//
+// Chunks received from network are queued as shared references ( no copy ),
+// whole chunks are passed to the backend as is. When the buffer is full
+// the oldest audio is dropped, as a live stream can't wait for us.
+// Data is held back until prebuffer is filled: at start and after
+// rebuffer() ( backend ran dry ).
+//
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <QQueue>
+#include <QByteArray>
+
+#include <phonon/abstractmediastream.h>
+
+class StreamBuffer : public Phonon::AbstractMediaStream
+{
+    Q_OBJECT
+
+    public:
+        explicit StreamBuffer( int capacity, QObject * parent = 0 );
+
+        // Queue part of chunk ( chunk is shared, not copied ).
+        void append( const QByteArray & chunk, int offset, int length );
+        // No more data will come.
+        void finish();
+        // Drop queued data ( position jump ).
+        void clear();
+        // Bytes waiting for backend.
+        qint64 fill() const;
+        int capacity() const;
+        void setCapacity( int bytes );
+        // Bytes dropped on overflow.
+        qint64 droppedBytes() const;
+        // Bytes to collect before data goes to backend.
+        void setPrebuffer( int bytes );
+        int prebuffer() const;
+        // Hold data back until prebuffer is filled again.
+        void rebuffer();
+        bool isPrimed() const;
+
+    signals:
+        // Prebuffer fill while collecting ( in percents ).
+        void priming( int percent );
+
+    protected:
+        void needData();
+        void enoughData();
+        void reset();
+
+    private:
+        // Chunk part.
+        struct Segment
+        {
+            QByteArray chunk;
+            int offset;
+            int length;
+        };
+
+        // Write queued data while backend wants it.
+        void feed();
+
+        QQueue< Segment > segments;
+        qint64 buffered;
+        int limit;
+        qint64 dropped;
+        // Backend asked for data.
+        bool wanted;
+        bool ended;
+        int target;
+        bool primed;
+        // Last reported priming percent.
+        int primingPercent;
+};
+
+#endif
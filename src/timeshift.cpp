@@ -0,0 +1,138 @@
+//
+// Timeshift: ring of last minutes of compressed stream.
+//
+#include "timeshift.h"
+#include "logger.h"
+#include "tracer.h"
+
+#include <string.h>
+
+Timeshift::Timeshift()
+    :ring( 0 ),
+     size( 0 ),
+     head( 0 )
+{
+}
+
+Timeshift::~Timeshift()
+{
+    release();
+}
+
+void Timeshift::setCapacity( qint64 bytes, qint64 memoryLimit, const QString & spillFile )
+{
+    TRACE_SCOPE( "Timeshift::setCapacity" );
+    release();
+    head = 0;
+    if ( bytes <= 0 )
+        return;
+
+    if ( ( bytes > memoryLimit ) && !spillFile.isEmpty() )
+    {
+        spill.setFileName( spillFile );
+        if ( spill.open( QIODevice::ReadWrite | QIODevice::Truncate ) && spill.resize( bytes ) )
+            ring = reinterpret_cast< char * >( spill.map( 0, bytes ) );
+
+        if ( ring )
+        {
+            size = bytes;
+            LOG_INFO( "timeshift", tr( "%1 bytes mapped from %2." ).arg( size ).arg( spillFile ) );
+            return;
+        }
+
+        LOG_WARN( "timeshift", tr( "Can't map %1 ( %2 ), window is cut to %3 bytes." )
+                               .arg( spillFile ).arg( spill.errorString() ).arg( memoryLimit ) );
+        release();
+    }
+
+    // Heap never goes over the limit.
+    size = qMin( bytes, qMin( memoryLimit, qint64( 0x7fffffff ) ) );
+    if ( size <= 0 )
+    {
+        size = 0;
+        return;
+    }
+    memory.resize( int( size ) );
+    ring = memory.data();
+}
+
+qint64 Timeshift::capacity() const
+{
+    return size;
+}
+
+void Timeshift::clear()
+{
+    head = 0;
+}
+
+void Timeshift::append( const char * data, int length )
+{
+    if ( !ring || ( length <= 0 ) )
+        return;
+
+    // Only the last "size" bytes can be kept.
+    if ( length > size )
+    {
+        data += length - size;
+        head += length - size;
+        length = int( size );
+    }
+
+    const qint64 at = head % size;
+    const int first = int( qMin< qint64 >( length, size - at ) );
+    memcpy( ring + at, data, first );
+    if ( first < length )
+        memcpy( ring, data + first, length - first );
+    head += length;
+}
+
+qint64 Timeshift::begin() const
+{
+    return qMax< qint64 >( 0, head - size );
+}
+
+qint64 Timeshift::end() const
+{
+    return head;
+}
+
+QByteArray Timeshift::read( qint64 pos, int length ) const
+{
+    QByteArray result;
+    if ( !ring || ( pos < begin() ) || ( pos >= head ) || ( length <= 0 ) )
+        return result;
+
+    length = int( qMin< qint64 >( length, head - pos ) );
+    result.resize( length );
+    const qint64 at = pos % size;
+    const int first = int( qMin< qint64 >( length, size - at ) );
+    memcpy( result.data(), ring + at, first );
+    if ( first < length )
+        memcpy( result.data() + first, ring, length - first );
+    return result;
+}
+
+qint64 Timeshift::memoryUsage() const
+{
+    return memory.size();
+}
+
+qint64 Timeshift::mappedSize() const
+{
+    return spill.isOpen() ? size : 0;
+}
+
+void Timeshift::release()
+{
+    if ( spill.isOpen() )
+    {
+        if ( ring )
+            spill.unmap( reinterpret_cast< uchar * >( ring ) );
+        spill.close();
+        spill.remove();
+    }
+    memory.clear();
+    ring = 0;
+    size = 0;
+}
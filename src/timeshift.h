@@ -0,0 +1,57 @@
+//
+// Timeshift: ring of last minutes of compressed stream.
+//
+// Bytes are addressed by stream position ( count of bytes appended so far ),
+// so a reader keeps its place while the ring wraps. Short windows live in
+// memory, windows over memory limit are kept in memory-mapped spill file
+// ( page cache holds them, not process heap ). Size never changes while
+// data is appended.
+//
+#ifndef TIMESHIFT_H
+#define TIMESHIFT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <QCoreApplication>
+
+class Timeshift
+{
+    Q_DECLARE_TR_FUNCTIONS( Timeshift )
+
+    public:
+        Timeshift();
+        ~Timeshift();
+
+        // Set ring size ( bytes ), content is dropped. Sizes over memory limit
+        // are mapped from spill file, if that fails ring is cut to the limit.
+        void setCapacity( qint64 bytes, qint64 memoryLimit, const QString & spillFile );
+        qint64 capacity() const;
+        // Forget content, positions start from zero.
+        void clear();
+
+        void append( const char * data, int length );
+        // Oldest kept position and live edge.
+        qint64 begin() const;
+        qint64 end() const;
+        // Copy of up to length bytes from position ( empty if not kept ).
+        QByteArray read( qint64 pos, int length ) const;
+
+        // Process heap used by ring.
+        qint64 memoryUsage() const;
+        // Size of mapped spill file.
+        qint64 mappedSize() const;
+
+    private:
+        // Free storage.
+        void release();
+
+        char * ring;
+        qint64 size;
+        // Bytes appended since clear.
+        qint64 head;
+        QByteArray memory;
+        QFile spill;
+};
+
+#endif
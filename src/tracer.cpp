@@ -0,0 +1,188 @@
+//
+// Tracer: timing spans and counters in Chrome trace-event format.
+//
+#include "tracer.h"
+#include "logger.h"
+
+#include <QMap>
+#include <QFile>
+#include <QThread>
+#include <QTextStream>
+
+#include <algorithm>
+
+// Maximum number of kept events.
+#define TRACE_MAX_EVENTS 500000
+
+Tracer * Tracer::tracer;
+bool Tracer::enabled;
+QElapsedTimer Tracer::clock;
+
+Tracer::Tracer()
+    :QObject( 0 ),
+     dropped( 0 )
+{
+    if ( tracer )
+    {
+        delete tracer;
+        tracer = 0;
+    }
+    clock.start();
+    tracer = this;
+}
+
+Tracer::~Tracer()
+{
+    stop();
+    if ( tracer == this )
+        tracer = 0;
+}
+
+Tracer * Tracer::instance()
+{
+    return tracer;
+}
+
+qint64 Tracer::now()
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::start( const QString & fileName )
+{
+    if ( fileName.isEmpty() )
+        return;
+
+    QMutexLocker locker( &mutex );
+    traceFile = fileName;
+    events.clear();
+    events.reserve( 4096 );
+    threads.clear();
+    dropped = 0;
+    enabled = true;
+}
+
+void Tracer::stop()
+{
+    if ( !enabled )
+        return;
+
+    QVector< Event > list;
+    int lost;
+    {
+        QMutexLocker locker( &mutex );
+        enabled = false;
+        list = events;
+        lost = dropped;
+        events.clear();
+    }
+
+    if ( write( list ) )
+        LOG_INFO( "tracer", tr( "Trace written to %1: %2 events, %3 dropped." )
+                            .arg( traceFile ).arg( list.count() ).arg( lost ) )
+    else
+        LOG_WARN( "tracer", tr( "Can't write trace %1!" ).arg( traceFile ) );
+}
+
+void Tracer::addSpan( const char * name, qint64 start, qint64 duration )
+{
+    append( name, 'X', start, duration );
+}
+
+void Tracer::addCounter( const char * name, qint64 value )
+{
+    append( name, 'C', now(), value );
+}
+
+void Tracer::addInstant( const char * name )
+{
+    append( name, 'i', now(), 0 );
+}
+
+void Tracer::append( const char * name, char phase, qint64 time, qint64 value )
+{
+    QMutexLocker locker( &mutex );
+    if ( !enabled )
+        return;
+
+    if ( events.count() >= TRACE_MAX_EVENTS )
+    {
+        ++dropped;
+        return;
+    }
+
+    const quintptr handle = reinterpret_cast< quintptr >( QThread::currentThreadId() );
+    QHash< quintptr, int >::const_iterator it = threads.constFind( handle );
+    if ( it == threads.constEnd() )
+        it = threads.insert( handle, threads.count() + 1 );
+
+    Event event;
+    event.name = name;
+    event.phase = phase;
+    event.time = time;
+    event.value = value;
+    event.thread = it.value();
+    events.append( event );
+}
+
+bool Tracer::write( const QVector< Event > & list )
+{
+    QFile file( traceFile );
+    if ( !file.open( QFile::WriteOnly | QFile::Truncate ) )
+        return false;
+
+    QTextStream out( &file );
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for ( int i = 0; i < list.count(); ++i )
+    {
+        const Event & event = list[ i ];
+        if ( i > 0 )
+            out << ",\n";
+        out << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+            << "\",\"ts\":" << event.time << ",\"pid\":1,\"tid\":" << event.thread;
+        switch ( event.phase )
+        {
+            case 'X': out << ",\"dur\":" << event.value; break;
+            case 'C': out << ",\"args\":{\"value\":" << event.value << "}"; break;
+            case 'i': out << ",\"s\":\"g\""; break;
+            default: break;
+        }
+        out << "}";
+    }
+    out << "\n],\n\"spanSummary\":{";
+    writeSummary( out, list );
+    out << "}}\n";
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
+
+void Tracer::writeSummary( QTextStream & out, const QVector< Event > & list )
+{
+    // Durations per span name, sorted by name so files diff well.
+    QMap< QByteArray, QVector< qint64 > > spans;
+    foreach ( const Event & event, list )
+    {
+        if ( event.phase == 'X' )
+            spans[ event.name ].append( event.value );
+    }
+
+    QMap< QByteArray, QVector< qint64 > >::iterator it = spans.begin();
+    for ( ; it != spans.end(); ++it )
+    {
+        QVector< qint64 > & durations = it.value();
+        std::sort( durations.begin(), durations.end() );
+        qint64 total = 0;
+        foreach ( qint64 duration, durations )
+            total += duration;
+
+        const int count = durations.count();
+        if ( it != spans.begin() )
+            out << ",";
+        out << "\n\"" << it.key() << "\":{\"count\":" << count << ",\"total\":" << total
+            << ",\"min\":" << durations.first() << ",\"p50\":" << durations[ count / 2 ]
+            << ",\"p95\":" << durations[ ( count * 95 ) / 100 ] << ",\"max\":" << durations.last() << "}";
+    }
+    if ( !spans.isEmpty() )
+        out << "\n";
+}
@@ -0,0 +1,105 @@
+//
+// Tracer: timing spans and counters in Chrome trace-event format.
+//
+// Events are kept in memory while tracing is on and written as JSON
+// ( chrome://tracing, Perfetto ) on stop, with per-span statistics for
+// comparing runs. When tracing is off TRACE_* macros cost one test of a
+// static flag.
+//
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+
+class QTextStream;
+
+class Tracer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit Tracer();
+        ~Tracer();
+
+        static Tracer * instance();
+        // Is recording on.
+        static inline bool isEnabled() { return enabled; }
+        // Microseconds since tracer creation.
+        static qint64 now();
+
+        // Start recording, events go to file on stop.
+        void start( const QString & fileName );
+        // Stop recording and write file.
+        void stop();
+
+        // Span with start time and duration ( in usec ).
+        void addSpan( const char * name, qint64 start, qint64 duration );
+        // Counter value.
+        void addCounter( const char * name, qint64 value );
+        // Single point in time.
+        void addInstant( const char * name );
+
+    private:
+        // Trace event, names are string literals.
+        struct Event
+        {
+            const char * name;
+            char phase;
+            qint64 time;
+            qint64 value;
+            int thread;
+        };
+
+        // Store event, mutex is locked inside.
+        void append( const char * name, char phase, qint64 time, qint64 value );
+        // Write events as JSON.
+        bool write( const QVector< Event > & list );
+        // Count, total and percentiles ( usec ) of spans by name.
+        static void writeSummary( QTextStream & out, const QVector< Event > & list );
+
+        static Tracer * tracer;
+        static bool enabled;
+        static QElapsedTimer clock;
+        QMutex mutex;
+        QString traceFile;
+        QVector< Event > events;
+        // Small thread numbers instead of thread handles.
+        QHash< quintptr, int > threads;
+        int dropped;
+};
+
+//
+// Measures lifetime of scope.
+//
+class TraceScope
+{
+    public:
+        explicit TraceScope( const char * spanName )
+            :name( spanName ),
+             start( Tracer::isEnabled() ? Tracer::now() : -1 )
+        {
+        }
+
+        ~TraceScope()
+        {
+            if ( ( start >= 0 ) && Tracer::isEnabled() )
+                Tracer::instance()->addSpan( name, start, Tracer::now() - start );
+        }
+
+    private:
+        const char * name;
+        qint64 start;
+};
+
+#define TRACE_CONCAT_( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_( a, b )
+
+#define TRACE_SCOPE( name ) TraceScope TRACE_CONCAT( traceScope, __LINE__ )( name )
+#define TRACE_COUNTER( name, value ) { if ( Tracer::isEnabled() ) Tracer::instance()->addCounter( ( name ), ( value ) ); }
+#define TRACE_INSTANT( name ) { if ( Tracer::isEnabled() ) Tracer::instance()->addInstant( ( name ) ); }
+
+#endif
@@ -0,0 +1,217 @@
+//
+// Tray animator: tray icon frames and animation.
+//
+#include "trayanimator.h"
+#include "tracer.h"
+
+#include <QSystemTrayIcon>
+#include <QPainter>
+#include <QPixmap>
+
+// Frame names.
+#define FRAME_PASSIVE "passive"
+#define FRAME_ACTIVE "active"
+#define FRAME_ERROR "error"
+#define FRAME_BUFFER "buffer-%1"
+// Icon size when tray doesn't report one.
+#define DEFAULT_ICON_SIZE 22
+
+TrayAnimator::TrayAnimator( QSystemTrayIcon * trayIcon, QObject * parent )
+    :QObject( parent ),
+     tray( trayIcon ),
+     state( Passive ),
+     bufferStep( 0 ),
+     frameRate( 1 ),
+     currFrame( 0 ),
+     shownKey( 0 )
+{
+    frames << "active-2" << "active-1" << FRAME_ACTIVE;
+    connect( &timer, SIGNAL( timeout() ), SLOT( nextFrame() ) );
+}
+
+void TrayAnimator::setState( State newState )
+{
+    state = newState;
+    switch ( state )
+    {
+        case Playing:
+            if ( !levels.isEmpty() )
+            {
+                timer.stop();
+                showLevels();
+            }
+            else if ( frameRate > 0 )
+            {
+                if ( !timer.isActive() )
+                {
+                    currFrame = 0;
+                    timer.start( 1000 / frameRate );
+                }
+            }
+            else
+                show( FRAME_ACTIVE );
+        break;
+
+        case Buffering:
+            timer.stop();
+            show( QString( FRAME_BUFFER ).arg( bufferStep ) );
+        break;
+
+        case Error:
+            timer.stop();
+            show( FRAME_ERROR );
+        break;
+
+        default:
+            timer.stop();
+            show( FRAME_PASSIVE );
+        break;
+    }
+}
+
+void TrayAnimator::setBufferLevel( int percent )
+{
+    // Ten steps, so at most eleven frames are ever drawn.
+    bufferStep = qBound( 0, percent, 100 ) / 10;
+    if ( state == Buffering )
+        show( QString( FRAME_BUFFER ).arg( bufferStep ) );
+}
+
+void TrayAnimator::setFrameRate( int fps )
+{
+    frameRate = qBound( 0, fps, 25 );
+    if ( state != Playing )
+        return;
+
+    if ( frameRate > 0 )
+        timer.start( 1000 / frameRate );
+    else
+    {
+        timer.stop();
+        show( FRAME_ACTIVE );
+    }
+}
+
+void TrayAnimator::setLevels( const QVector< int > & bands )
+{
+    levels = bands;
+    if ( state == Playing )
+        setState( Playing );
+}
+
+QIcon TrayAnimator::frame( const QString & name )
+{
+    const QSize size = iconSize();
+    const QString key = QString( "%1@%2x%3" ).arg( name ).arg( size.width() ).arg( size.height() );
+    QHash< QString, QIcon >::const_iterator it = cache.constFind( key );
+    if ( it != cache.constEnd() )
+        return it.value();
+
+    TRACE_SCOPE( "TrayAnimator::render" );
+    const QIcon icon( render( name, size ) );
+    cache.insert( key, icon );
+    return icon;
+}
+
+void TrayAnimator::nextFrame()
+{
+    TRACE_SCOPE( "TrayAnimator::nextFrame" );
+    if ( frames.isEmpty() )
+        return;
+
+    if ( currFrame >= frames.count() )
+        currFrame = 0;
+    show( frames[ currFrame ] );
+    ++currFrame;
+}
+
+QPixmap TrayAnimator::render( const QString & name, const QSize & size ) const
+{
+    if ( !name.startsWith( "buffer-" ) && ( name != FRAME_ERROR ) )
+        return QPixmap( QString( ":/images/radio-%1.png" ).arg( name ) )
+               .scaled( size, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+
+    // Dynamic frames are drawn over passive icon.
+    QPixmap pixmap = QPixmap( ":/images/radio-passive.png" )
+                     .scaled( size, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+    QPainter painter( &pixmap );
+    painter.setRenderHint( QPainter::Antialiasing );
+    const QRect area = pixmap.rect();
+    if ( name == FRAME_ERROR )
+    {
+        const int side = area.width() / 2;
+        const QRect mark( area.right() - side + 1, area.bottom() - side + 1, side, side );
+        painter.setPen( Qt::NoPen );
+        painter.setBrush( Qt::red );
+        painter.drawEllipse( mark );
+        painter.setPen( QPen( Qt::white, qMax( 1, side / 6 ) ) );
+        painter.drawLine( mark.topLeft() + QPoint( side / 4, side / 4 ),
+                          mark.bottomRight() - QPoint( side / 4, side / 4 ) );
+        painter.drawLine( mark.topRight() + QPoint( -side / 4, side / 4 ),
+                          mark.bottomLeft() + QPoint( side / 4, -side / 4 ) );
+    }
+    else
+    {
+        const int step = name.mid( 7 ).toInt();
+        const int height = qMax( 2, area.height() / 8 );
+        const QRect bar( area.left(), area.bottom() - height + 1, area.width(), height );
+        painter.fillRect( bar, QColor( 0, 0, 0, 128 ) );
+        painter.fillRect( QRect( bar.left(), bar.top(), bar.width() * step / 10, height ), Qt::green );
+    }
+
+    return pixmap;
+}
+
+void TrayAnimator::show( const QString & name )
+{
+    if ( !tray )
+        return;
+
+    // Same frame, but also same size.
+    const QIcon icon = frame( name );
+    if ( icon.cacheKey() == shownKey )
+        return;
+
+    TRACE_SCOPE( "TrayAnimator::show" );
+    shownKey = icon.cacheKey();
+    tray->setIcon( icon );
+}
+
+void TrayAnimator::showLevels()
+{
+    if ( !tray )
+        return;
+
+    const QSize size = iconSize();
+    QVector< int > bars( levels.count() );
+    for ( int i = 0; i < levels.count(); ++i )
+        bars[ i ] = qBound( 0, levels[ i ], 100 ) * size.height() / 100;
+    if ( ( bars == shownBars ) && ( shownKey == 0 ) )
+        return;
+
+    TRACE_SCOPE( "TrayAnimator::showLevels" );
+    QPixmap pixmap = frame( FRAME_ACTIVE ).pixmap( size );
+    QPainter painter( &pixmap );
+    const QRect area = pixmap.rect();
+    const int width = qMax( 1, area.width() / bars.count() );
+    for ( int i = 0; i < bars.count(); ++i )
+    {
+        const QRect bar( area.left() + i * width, area.bottom() - bars[ i ] + 1, width - 1, bars[ i ] );
+        painter.fillRect( bar, ( bars[ i ] > area.height() * 3 / 4 ) ? Qt::yellow : Qt::green );
+    }
+    painter.end();
+
+    // Meter frames are not cached, zero key marks them shown.
+    shownBars = bars;
+    shownKey = 0;
+    tray->setIcon( QIcon( pixmap ) );
+}
+
+QSize TrayAnimator::iconSize() const
+{
+    const QSize size = tray ? tray->geometry().size() : QSize();
+    if ( size.isValid() && !size.isEmpty() )
+        return size;
+
+    return QSize( DEFAULT_ICON_SIZE, DEFAULT_ICON_SIZE );
+}
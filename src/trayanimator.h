@@ -0,0 +1,73 @@
+//
+// Tray animator: tray icon frames and animation.
+//
+// Frames are decoded ( or drawn ) once per icon size and kept. Animation
+// runs on its own timer only while playing, the tray is touched only when
+// the shown frame changes. Level meter bars replace animation while set,
+// they are drawn per update and not cached.
+//
+#ifndef TRAY_ANIMATOR_H
+#define TRAY_ANIMATOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QIcon>
+#include <QSize>
+#include <QStringList>
+#include <QTimer>
+
+class QSystemTrayIcon;
+
+class TrayAnimator : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Player state shown by icon.
+        enum State { Passive, Playing, Buffering, Error };
+
+        explicit TrayAnimator( QSystemTrayIcon * trayIcon, QObject * parent = 0 );
+
+        void setState( State newState );
+        // Buffer fill shown while buffering ( in percents ).
+        void setBufferLevel( int percent );
+        // Animation frames per second ( 0 - no animation ).
+        void setFrameRate( int fps );
+        // Level bars shown while playing ( percents, empty - animation ).
+        void setLevels( const QVector< int > & bands );
+        // Icon of frame ( cached ).
+        QIcon frame( const QString & name );
+
+    private slots:
+        void nextFrame();
+
+    private:
+        // Decode image file or draw dynamic frame.
+        QPixmap render( const QString & name, const QSize & size ) const;
+        // Set tray icon if frame differs from shown one.
+        void show( const QString & name );
+        // Draw level bars over active icon.
+        void showLevels();
+        // Icon size in tray.
+        QSize iconSize() const;
+
+        QSystemTrayIcon * tray;
+        State state;
+        // Buffer level step ( 0 - 10 ).
+        int bufferStep;
+        int frameRate;
+        QTimer timer;
+        // Playing animation frames.
+        QStringList frames;
+        int currFrame;
+        // Cache key of icon in tray.
+        qint64 shownKey;
+        QVector< int > levels;
+        // Bar heights ( pixels ) in tray.
+        QVector< int > shownBars;
+        // Frames by name and size.
+        QHash< QString, QIcon > cache;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#
+# QBENCHMARK suites of hot paths.
+#
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    logger \
+    catalog \
+    stations \
+    metadata \
+    trayicon
+
+check.CONFIG = recursive
+QMAKE_EXTRA_TARGETS += check
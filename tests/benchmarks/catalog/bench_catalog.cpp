@@ -0,0 +1,133 @@
+//
+// Benchmark: station catalog load and save on generated catalogs.
+//
+#include <QtTest>
+#include <QDir>
+
+#include "stationcatalog.h"
+#include "synthetic.h"
+
+// Generated stations not stored yet ( catalog gives ids ).
+static QList< Station > unsaved( int count )
+{
+    QList< Station > list = Synthetic::stations( count );
+    for ( int i = 0; i < list.count(); ++i )
+        list[ i ].id = 0;
+    return list;
+}
+
+class BenchCatalog : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void cleanup();
+        // Startup: read whole catalog.
+        void load_data();
+        void load();
+        // First save ( import ) writes whole file.
+        void saveAll_data();
+        void saveAll();
+        // Edit of one station is appended.
+        void saveEdit_data();
+        void saveEdit();
+
+    private:
+        // Rows: catalog sizes.
+        void sizes();
+
+        QString fileName;
+};
+
+void BenchCatalog::initTestCase()
+{
+    fileName = QDir::temp().filePath( "bench_catalog.dat" );
+}
+
+void BenchCatalog::cleanup()
+{
+    QFile::remove( fileName );
+    QFile::remove( fileName + ".tmp" );
+}
+
+void BenchCatalog::sizes()
+{
+    QTest::addColumn< int >( "count" );
+    QTest::newRow( "10" ) << 10;
+    QTest::newRow( "1k" ) << 1000;
+    QTest::newRow( "100k" ) << 100000;
+}
+
+void BenchCatalog::load_data()
+{
+    sizes();
+}
+
+void BenchCatalog::load()
+{
+    QFETCH( int, count );
+
+    QList< Station > list = unsaved( count );
+    StationCatalog writer( fileName );
+    QVERIFY( writer.save( list ) );
+
+    StationCatalog catalog( fileName );
+    QList< Station > loaded;
+    QBENCHMARK
+    {
+        QVERIFY( catalog.load( loaded ) );
+    }
+    QCOMPARE( loaded.count(), count );
+}
+
+void BenchCatalog::saveAll_data()
+{
+    sizes();
+}
+
+void BenchCatalog::saveAll()
+{
+    QFETCH( int, count );
+
+    const QList< Station > generated = unsaved( count );
+    QBENCHMARK
+    {
+        QFile::remove( fileName );
+        QList< Station > list = generated;
+        StationCatalog catalog( fileName );
+        QVERIFY( catalog.save( list ) );
+    }
+}
+
+void BenchCatalog::saveEdit_data()
+{
+    sizes();
+}
+
+void BenchCatalog::saveEdit()
+{
+    QFETCH( int, count );
+
+    QList< Station > list = unsaved( count );
+    StationCatalog catalog( fileName );
+    QVERIFY( catalog.save( list ) );
+    QVERIFY( catalog.load( list ) );
+
+    // Rewrites after many edits are part of the cost.
+    int edit = 0;
+    QBENCHMARK
+    {
+        list[ edit % count ].name += "*";
+        QVERIFY( catalog.save( list ) );
+        ++edit;
+    }
+
+    StationCatalog check( fileName );
+    QList< Station > loaded;
+    QVERIFY( check.load( loaded ) );
+    QCOMPARE( loaded.count(), count );
+}
+
+QTEST_MAIN( BenchCatalog )
+#include "bench_catalog.moc"
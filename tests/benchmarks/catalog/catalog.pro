@@ -0,0 +1,10 @@
+#
+# Benchmark: station catalog load and save ( Application::loadSettings and
+# storeSettings ) on generated catalogs.
+#
+
+TEMPLATE = app
+TARGET = bench_catalog
+include( ../../tests.pri )
+
+SOURCES += bench_catalog.cpp
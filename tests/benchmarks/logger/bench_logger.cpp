@@ -0,0 +1,110 @@
+//
+// Benchmark: Logger::add with and without log file, cost of disabled record.
+//
+#include <QtTest>
+#include <QDir>
+
+#include "logger.h"
+
+// Writer echoes records with qDebug, that would flood test output.
+static void quietHandler( QtMsgType type, const char * message )
+{
+    if ( type == QtDebugMsg )
+        return;
+
+    fprintf( stderr, "%s\n", message );
+    if ( type == QtFatalMsg )
+        abort();
+}
+
+class BenchLogger : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+        // Enqueue of enabled record ( caller side cost ).
+        void add_data();
+        void add();
+        // Record below log level: message must not be formatted.
+        void disabled_data();
+        void disabled();
+
+    private:
+        QString logFile;
+};
+
+void BenchLogger::initTestCase()
+{
+    logFile = QDir::temp().filePath( "bench_logger.log" );
+    qInstallMsgHandler( quietHandler );
+}
+
+void BenchLogger::cleanupTestCase()
+{
+    qInstallMsgHandler( 0 );
+    QFile::remove( logFile );
+}
+
+void BenchLogger::add_data()
+{
+    QTest::addColumn< bool >( "toFile" );
+    QTest::newRow( "console" ) << false;
+    QTest::newRow( "file" ) << true;
+}
+
+void BenchLogger::add()
+{
+    QFETCH( bool, toFile );
+
+    Logger logger;
+    if ( toFile )
+        logger.setLogFile( logFile );
+    // Writer keeps up or caller waits, dropped records would flatter result.
+    logger.setOverflowPolicy( Logger::Block );
+
+    int percent = 0;
+    QBENCHMARK
+    {
+        LOG_INFO( "player", QString( "Buffering %1%." ).arg( percent ) );
+        percent = ( percent + 1 ) % 100;
+    }
+
+    logger.flush();
+    QCOMPARE( logger.droppedCount(), 0 );
+}
+
+void BenchLogger::disabled_data()
+{
+    // Baseline is the same loop without log call.
+    QTest::addColumn< int >( "mode" );
+    QTest::newRow( "baseline" ) << 0;
+    QTest::newRow( "level" ) << 1;
+    QTest::newRow( "source" ) << 2;
+}
+
+void BenchLogger::disabled()
+{
+    QFETCH( int, mode );
+
+    Logger logger;
+    logger.setLevel( Logger::Warning );
+    // Other source at debug level, filter falls to per-source lookup.
+    if ( mode == 2 )
+        logger.setSourceLevel( "meter", Logger::Debug );
+
+    volatile int percent = 0;
+    QBENCHMARK
+    {
+        if ( mode > 0 )
+            LOG_DEBUG( "player", QObject::tr( "Buffering %1%." ).arg( percent ) );
+        percent = ( percent + 1 ) % 100;
+    }
+
+    logger.flush();
+    QCOMPARE( logger.droppedCount(), 0 );
+}
+
+QTEST_MAIN( BenchLogger )
+#include "bench_logger.moc"
@@ -0,0 +1,9 @@
+#
+# Benchmark: Logger::add with and without log file.
+#
+
+TEMPLATE = app
+TARGET = bench_logger
+include( ../../tests.pri )
+
+SOURCES += bench_logger.cpp
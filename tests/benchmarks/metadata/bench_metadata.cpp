@@ -0,0 +1,92 @@
+//
+// Benchmark: meta data filter on generated track changes and repeats.
+//
+#include <QtTest>
+
+#include "metadatafilter.h"
+#include "synthetic.h"
+
+// Distinct tracks cycled through.
+#define BENCH_TRACKS 64
+
+class BenchMetaData : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        // Event repeating shown track ( dropped by fingerprint ).
+        void repeat();
+        // Every event is a new track, published at once.
+        void change_data();
+        void change();
+        // Burst inside debounce window ( collapsed, timer restarted ).
+        void burst();
+};
+
+void BenchMetaData::repeat()
+{
+    MetaDataFilter filter;
+    filter.setWindow( 0 );
+    const QMultiMap< QString, QString > data = Synthetic::metaData( 1 );
+    filter.process( data );
+
+    QBENCHMARK
+    {
+        filter.process( data );
+    }
+    QCOMPARE( filter.publishedCount(), quint64( 1 ) );
+}
+
+void BenchMetaData::change_data()
+{
+    QTest::addColumn< QString >( "encoding" );
+    QTest::newRow( "none" ) << QString();
+    QTest::newRow( "windows-1251" ) << QString( "windows-1251" );
+    QTest::newRow( "utf-8" ) << QString( "UTF-8" );
+}
+
+void BenchMetaData::change()
+{
+    QFETCH( QString, encoding );
+
+    QList< QMultiMap< QString, QString > > tracks;
+    for ( int i = 0; i < BENCH_TRACKS; ++i )
+        tracks.append( Synthetic::metaData( i ) );
+
+    MetaDataFilter filter;
+    filter.setWindow( 0 );
+    filter.setEncoding( encoding );
+    QSignalSpy spy( &filter, SIGNAL( trackChanged( QString ) ) );
+
+    int track = 0;
+    QBENCHMARK
+    {
+        filter.process( tracks[ track % BENCH_TRACKS ] );
+        ++track;
+    }
+    QCOMPARE( filter.duplicateCount(), quint64( 0 ) );
+    QVERIFY( !spy.isEmpty() );
+}
+
+void BenchMetaData::burst()
+{
+    QList< QMultiMap< QString, QString > > tracks;
+    for ( int i = 0; i < BENCH_TRACKS; ++i )
+        tracks.append( Synthetic::metaData( i ) );
+
+    // Long window and wait, nothing is published while measuring.
+    MetaDataFilter filter;
+    filter.setWindow( 60000 );
+    filter.setMaxWait( 600000 );
+
+    int track = 0;
+    QBENCHMARK
+    {
+        filter.process( tracks[ track % BENCH_TRACKS ] );
+        ++track;
+    }
+    QCOMPARE( filter.publishedCount(), quint64( 0 ) );
+}
+
+QTEST_MAIN( BenchMetaData )
+#include "bench_metadata.moc"
@@ -0,0 +1,9 @@
+#
+# Benchmark: meta data filter on generated track changes and repeats.
+#
+
+TEMPLATE = app
+TARGET = bench_metadata
+include( ../../tests.pri )
+
+SOURCES += bench_metadata.cpp
@@ -0,0 +1,204 @@
+//
+// Benchmark: station list views on generated catalogs.
+//
+#include <QtTest>
+#include <QLineEdit>
+#include <QTableView>
+
+#include "stationsmenu.h"
+#include "stationmodel.h"
+#include "settingsdialog.h"
+#include "synthetic.h"
+
+// Stations in settings dialog benchmarks.
+#define BENCH_DIALOG_STATIONS 50000
+
+class BenchStations : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        // Tray menu built from scratch.
+        void menuBuild_data();
+        void menuBuild();
+        // One station renamed, other actions are kept.
+        void menuUpdate_data();
+        void menuUpdate();
+        // Model reset with whole list.
+        void modelSet_data();
+        void modelSet();
+        // Selection of ten stations moved to the end and back.
+        void modelMove_data();
+        void modelMove();
+        // Settings dialog filled with long list ( columns are sized ).
+        void dialogSet();
+        // Selection of ten rows moved down and up by dialog buttons.
+        void dialogMove();
+        // Filter text typed and cleared.
+        void dialogFilter_data();
+        void dialogFilter();
+
+    private:
+        // Rows: catalog sizes.
+        void sizes();
+};
+
+void BenchStations::sizes()
+{
+    QTest::addColumn< int >( "count" );
+    QTest::newRow( "10" ) << 10;
+    QTest::newRow( "1k" ) << 1000;
+    QTest::newRow( "100k" ) << 100000;
+}
+
+void BenchStations::menuBuild_data()
+{
+    sizes();
+}
+
+void BenchStations::menuBuild()
+{
+    QFETCH( int, count );
+
+    const QList< Station > list = Synthetic::stations( count );
+    QBENCHMARK
+    {
+        StationsMenu menu;
+        menu.setStations( list );
+    }
+}
+
+void BenchStations::menuUpdate_data()
+{
+    sizes();
+}
+
+void BenchStations::menuUpdate()
+{
+    QFETCH( int, count );
+
+    QList< Station > list = Synthetic::stations( count );
+    StationsMenu menu;
+    menu.setStations( list );
+
+    int edit = 0;
+    QBENCHMARK
+    {
+        list[ edit % count ].name += "*";
+        menu.setStations( list );
+        ++edit;
+    }
+}
+
+void BenchStations::modelSet_data()
+{
+    sizes();
+}
+
+void BenchStations::modelSet()
+{
+    QFETCH( int, count );
+
+    const QList< Station > list = Synthetic::stations( count );
+    StationModel model;
+    QBENCHMARK
+    {
+        model.setStations( list );
+    }
+    QCOMPARE( model.rowCount(), count );
+}
+
+void BenchStations::modelMove_data()
+{
+    sizes();
+}
+
+void BenchStations::modelMove()
+{
+    QFETCH( int, count );
+
+    StationModel model;
+    model.setStations( Synthetic::stations( count ) );
+
+    // Scattered selection from the middle of the list.
+    QList< int > rows;
+    for ( int i = 0; i < qMin( 10, count ); ++i )
+        rows.append( ( count / 2 + i * 7 ) % count );
+    qSort( rows );
+    // Same stations after move to the end.
+    QList< int > tail;
+    for ( int i = 0; i < rows.count(); ++i )
+        tail.append( count - rows.count() + i );
+
+    QBENCHMARK
+    {
+        model.moveStations( rows, count );
+        model.moveStations( tail, count / 2 );
+    }
+    QCOMPARE( model.rowCount(), count );
+}
+
+void BenchStations::dialogSet()
+{
+    const QList< Station > list = Synthetic::stations( BENCH_DIALOG_STATIONS );
+    SettingsDialog dialog;
+    dialog.show();
+    QBENCHMARK
+    {
+        dialog.setStationList( list );
+    }
+    QCOMPARE( dialog.getStationList().count(), BENCH_DIALOG_STATIONS );
+}
+
+void BenchStations::dialogMove()
+{
+    SettingsDialog dialog;
+    dialog.setStationList( Synthetic::stations( BENCH_DIALOG_STATIONS ) );
+    dialog.show();
+
+    // Scattered selection from the middle, kept by view while rows move.
+    QTableView * table = dialog.findChild< QTableView * >( "stationTable" );
+    QVERIFY( table );
+    QItemSelection selection;
+    for ( int i = 0; i < 10; ++i )
+    {
+        const QModelIndex index = table->model()->index( BENCH_DIALOG_STATIONS / 2 + i * 7, 0 );
+        selection.select( index, index );
+    }
+    table->selectionModel()->select( selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows );
+
+    QBENCHMARK
+    {
+        dialog.moveDownStation();
+        dialog.moveUpStation();
+    }
+    QCOMPARE( table->selectionModel()->selectedRows().count(), 10 );
+}
+
+void BenchStations::dialogFilter_data()
+{
+    QTest::addColumn< QString >( "text" );
+    QTest::newRow( "word" ) << QString( "jazz" );
+    QTest::newRow( "prefix" ) << QString( "m" );
+    QTest::newRow( "none" ) << QString( "nothing like this" );
+}
+
+void BenchStations::dialogFilter()
+{
+    QFETCH( QString, text );
+
+    SettingsDialog dialog;
+    dialog.setStationList( Synthetic::stations( BENCH_DIALOG_STATIONS ) );
+    dialog.show();
+
+    QLineEdit * filter = dialog.findChild< QLineEdit * >( "filterEdit" );
+    QVERIFY( filter );
+    QBENCHMARK
+    {
+        filter->setText( text );
+        filter->clear();
+    }
+}
+
+QTEST_MAIN( BenchStations )
+#include "bench_stations.moc"
@@ -0,0 +1,10 @@
+#
+# Benchmark: station list views ( tray menu, settings table and model
+# reordering ) on generated catalogs.
+#
+
+TEMPLATE = app
+TARGET = bench_stations
+include( ../../tests.pri )
+
+SOURCES += bench_stations.cpp
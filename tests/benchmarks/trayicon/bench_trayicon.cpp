@@ -0,0 +1,103 @@
+//
+// Benchmark: tray icon frames, animation and level bars.
+//
+#include <QtTest>
+#include <QSystemTrayIcon>
+
+#include "trayanimator.h"
+
+class BenchTrayIcon : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        // Frame decoded and scaled ( cache of new animator is empty ).
+        void render_data();
+        void render();
+        // Frame taken from cache.
+        void cached();
+        // One step of playing animation.
+        void animate();
+        // Buffer fill changes by one percent.
+        void buffering();
+        // Level bars drawn over icon.
+        void levels();
+};
+
+void BenchTrayIcon::render_data()
+{
+    QTest::addColumn< QString >( "name" );
+    QTest::newRow( "active" ) << QString( "active" );
+    QTest::newRow( "error" ) << QString( "error" );
+    QTest::newRow( "buffer" ) << QString( "buffer-5" );
+}
+
+void BenchTrayIcon::render()
+{
+    QFETCH( QString, name );
+
+    QBENCHMARK
+    {
+        TrayAnimator animator( 0 );
+        QVERIFY( !animator.frame( name ).isNull() );
+    }
+}
+
+void BenchTrayIcon::cached()
+{
+    TrayAnimator animator( 0 );
+    animator.frame( "active" );
+
+    QBENCHMARK
+    {
+        animator.frame( "active" );
+    }
+}
+
+void BenchTrayIcon::animate()
+{
+    QSystemTrayIcon tray;
+    TrayAnimator animator( &tray );
+    animator.setFrameRate( 0 );
+    animator.setState( TrayAnimator::Playing );
+
+    QBENCHMARK
+    {
+        QMetaObject::invokeMethod( &animator, "nextFrame" );
+    }
+}
+
+void BenchTrayIcon::buffering()
+{
+    QSystemTrayIcon tray;
+    TrayAnimator animator( &tray );
+    animator.setState( TrayAnimator::Buffering );
+
+    int percent = 0;
+    QBENCHMARK
+    {
+        animator.setBufferLevel( percent % 101 );
+        ++percent;
+    }
+}
+
+void BenchTrayIcon::levels()
+{
+    QSystemTrayIcon tray;
+    TrayAnimator animator( &tray );
+    animator.setState( TrayAnimator::Playing );
+
+    // Bars move every update, like music does.
+    QVector< int > bands( 8 );
+    int step = 0;
+    QBENCHMARK
+    {
+        for ( int i = 0; i < bands.count(); ++i )
+            bands[ i ] = ( step * 13 + i * 29 ) % 101;
+        animator.setLevels( bands );
+        ++step;
+    }
+}
+
+QTEST_MAIN( BenchTrayIcon )
+#include "bench_trayicon.moc"
@@ -0,0 +1,10 @@
+#
+# Benchmark: tray icon frames, animation and level bars.
+#
+
+TEMPLATE = app
+TARGET = bench_trayicon
+include( ../../tests.pri )
+
+SOURCES += bench_trayicon.cpp
+RESOURCES += ../../../resources.qrc
@@ -0,0 +1,263 @@
+//
+// Stand-in server: local Icecast / Shoutcast imitation for stream tests.
+//
+#include "standinserver.h"
+#include "synthetic.h"
+
+#include <QTcpSocket>
+#include <QHostAddress>
+
+// Send interval ( msec ).
+#define STAND_IN_TICK 20
+// Unsent data kept for slow client, live audio past it is skipped ( bytes ).
+#define STAND_IN_BACKLOG 65536
+// Longest request head ( bytes ).
+#define STAND_IN_MAX_REQUEST 8192
+
+StandInServer::StandInServer( QObject * parent )
+    :QTcpServer( parent ),
+     connections( 0 )
+{
+    timer.setInterval( STAND_IN_TICK );
+    connect( &timer, SIGNAL( timeout() ), SLOT( pump() ) );
+    connect( this, SIGNAL( newConnection() ), SLOT( onNewConnection() ) );
+}
+
+StandInServer::~StandInServer()
+{
+    timer.stop();
+    foreach ( const Client & client, clients )
+    {
+        client.socket->disconnect( this );
+        client.socket->abort();
+    }
+}
+
+void StandInServer::setOptions( const Options & options )
+{
+    current = options;
+}
+
+QUrl StandInServer::start()
+{
+    if ( !isListening() && !listen( QHostAddress::LocalHost ) )
+        return QUrl();
+
+    connections = 0;
+    clock.start();
+    timer.start();
+    return QUrl( QString( "http://127.0.0.1:%1/stream.mp3" ).arg( serverPort() ) );
+}
+
+int StandInServer::connectionCount() const
+{
+    return connections;
+}
+
+QByteArray StandInServer::lastRequest() const
+{
+    return last;
+}
+
+int StandInServer::currentTrack() const
+{
+    return int( clock.elapsed() / qMax( 1, current.titlePeriod ) );
+}
+
+void StandInServer::onNewConnection()
+{
+    while ( QTcpSocket * socket = nextPendingConnection() )
+    {
+        Client client;
+        client.socket = socket;
+        client.options = current;
+        client.frame = silentFrame( current.bitrate );
+        client.age.start();
+        connect( socket, SIGNAL( readyRead() ), SLOT( onReadyRead() ) );
+        connect( socket, SIGNAL( disconnected() ), SLOT( onDisconnected() ) );
+        clients.append( client );
+        ++connections;
+        emit clientConnected();
+    }
+}
+
+void StandInServer::onReadyRead()
+{
+    const int index = clientIndex( qobject_cast< QTcpSocket * >( sender() ) );
+    if ( index < 0 )
+        return;
+
+    // Request head is kept, body ( if any ) is ignored.
+    Client & client = clients[ index ];
+    const QByteArray data = client.socket->readAll();
+    if ( client.answered || client.request.contains( "\r\n\r\n" ) )
+        return;
+
+    client.request += data;
+    if ( client.request.size() > STAND_IN_MAX_REQUEST )
+        drop( client );
+}
+
+void StandInServer::onDisconnected()
+{
+    QTcpSocket * socket = qobject_cast< QTcpSocket * >( sender() );
+    const int index = clientIndex( socket );
+    if ( index < 0 )
+        return;
+
+    clients.removeAt( index );
+    socket->deleteLater();
+}
+
+void StandInServer::pump()
+{
+    for ( int i = 0; i < clients.count(); ++i )
+    {
+        Client & client = clients[ i ];
+        if ( client.closing )
+            continue;
+
+        const Options & options = client.options;
+        const qint64 age = client.age.elapsed();
+        if ( ( options.dropAfter > 0 ) && ( age >= options.dropAfter ) )
+        {
+            drop( client );
+            emit clientDropped();
+            continue;
+        }
+
+        if ( !client.answered )
+        {
+            if ( client.request.contains( "\r\n\r\n" ) && ( age >= options.latency ) )
+                answer( client );
+            continue;
+        }
+
+        // Stalled source sends nothing and skips stalled time.
+        qint64 active = age - client.answeredAt;
+        if ( ( options.stallAfter > 0 ) && ( options.stallLength > 0 ) && ( age >= options.stallAfter ) )
+        {
+            if ( age < options.stallAfter + options.stallLength )
+                continue;
+            active -= options.stallLength;
+        }
+
+        const int kbps = ( options.bandwidth > 0 ) ? options.bandwidth : options.bitrate;
+        const qint64 due = options.burst + active * kbps / 8;
+        if ( due <= client.sent )
+            continue;
+
+        // Live source doesn't wait for slow client.
+        if ( client.socket->bytesToWrite() > STAND_IN_BACKLOG )
+            client.sent = due;
+        else
+            sendAudio( client, due - client.sent );
+    }
+}
+
+int StandInServer::clientIndex( QTcpSocket * socket ) const
+{
+    for ( int i = 0; i < clients.count(); ++i )
+    {
+        if ( clients[ i ].socket == socket )
+            return i;
+    }
+    return -1;
+}
+
+void StandInServer::answer( Client & client )
+{
+    const Options & options = client.options;
+    const QByteArray request = client.request.left( client.request.indexOf( "\r\n\r\n" ) );
+    last = request;
+    client.answered = true;
+    client.answeredAt = client.age.elapsed();
+
+    if ( options.statusCode != 200 )
+    {
+        const QByteArray reason = ( options.statusCode == 404 ) ? "Not Found" : "Error";
+        client.socket->write( "HTTP/1.0 " + QByteArray::number( options.statusCode ) + " " + reason +
+                              "\r\nContent-Type: text/html\r\n\r\n" );
+        drop( client );
+        return;
+    }
+
+    client.withMeta = ( options.metaInterval > 0 ) && request.toLower().contains( "icy-metadata: 1" );
+    client.audioLeft = options.metaInterval;
+
+    QByteArray head = options.icyStatus ? "ICY 200 OK\r\n" : "HTTP/1.0 200 OK\r\nServer: Icecast 2.4.4\r\n";
+    head += "Content-Type: audio/mpeg\r\n";
+    head += "icy-name: Stand-in radio\r\n";
+    head += "icy-genre: Test\r\n";
+    head += "icy-br: " + QByteArray::number( options.bitrate ) + "\r\n";
+    if ( client.withMeta )
+        head += "icy-metaint: " + QByteArray::number( options.metaInterval ) + "\r\n";
+    head += "\r\n";
+    client.socket->write( head );
+}
+
+void StandInServer::sendAudio( Client & client, qint64 count )
+{
+    QByteArray data;
+    data.reserve( int( count ) + 256 );
+    while ( count > 0 )
+    {
+        int length = int( qMin( count, qint64( client.frame.size() - client.frameOffset ) ) );
+        if ( client.withMeta )
+            length = qMin( length, client.audioLeft );
+
+        data += client.frame.mid( client.frameOffset, length );
+        client.frameOffset = ( client.frameOffset + length ) % client.frame.size();
+        client.sent += length;
+        count -= length;
+        if ( client.withMeta )
+        {
+            client.audioLeft -= length;
+            if ( client.audioLeft == 0 )
+            {
+                data += metaBlock( client );
+                client.audioLeft = client.options.metaInterval;
+            }
+        }
+    }
+    client.socket->write( data );
+}
+
+QByteArray StandInServer::metaBlock( Client & client )
+{
+    const int track = int( clock.elapsed() / qMax( 1, client.options.titlePeriod ) );
+    if ( track == client.track )
+        return QByteArray( 1, '\0' );
+
+    client.track = track;
+    QByteArray text = "StreamTitle='" + Synthetic::trackTitle( track ).toUtf8() + "';StreamUrl='';";
+    const int blocks = ( text.size() + 15 ) / 16;
+    text.append( QByteArray( blocks * 16 - text.size(), '\0' ) );
+    return char( blocks ) + text;
+}
+
+void StandInServer::drop( Client & client )
+{
+    client.closing = true;
+    client.socket->disconnectFromHost();
+}
+
+QByteArray StandInServer::silentFrame( int bitrate )
+{
+    // MPEG-1 Layer III bitrates by header index.
+    static const int rates[] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+    int index = 9;
+    for ( int i = 1; i < 15; ++i )
+    {
+        if ( rates[ i ] == bitrate )
+            index = i;
+    }
+
+    // 44.1 kHz mono without padding, zero side info decodes to silence.
+    QByteArray frame( 144000 * rates[ index ] / 44100, '\0' );
+    frame[ 0 ] = char( 0xff );
+    frame[ 1 ] = char( 0xfb );
+    frame[ 2 ] = char( index << 4 );
+    frame[ 3 ] = char( 0xc0 );
+    return frame;
+}
@@ -0,0 +1,134 @@
+//
+// Stand-in server: local Icecast / Shoutcast imitation for stream tests.
+//
+// Serves endless synthetic MP3 ( silent MPEG-1 Layer III frames ) at the
+// configured bitrate, with ICY meta data when the client asks for it. Track
+// title changes on a fixed period. Latency, bandwidth, a stall and a
+// disconnect can be set; options are taken by each connection when it is
+// accepted, so a test can change them between connections.
+//
+#ifndef STAND_IN_SERVER_H
+#define STAND_IN_SERVER_H
+
+#include <QTcpServer>
+#include <QUrl>
+#include <QList>
+#include <QTimer>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+class QTcpSocket;
+
+class StandInServer : public QTcpServer
+{
+    Q_OBJECT
+
+    public:
+        struct Options
+        {
+            Options()
+                :bitrate( 128 ), metaInterval( 16000 ), icyStatus( true ), statusCode( 200 ),
+                 burst( 65536 ), latency( 0 ), bandwidth( 0 ), stallAfter( 0 ), stallLength( 0 ),
+                 dropAfter( 0 ), titlePeriod( 5000 )
+            {
+            }
+
+            // Stream bitrate ( kbit/s, 32 - 320 ).
+            int bitrate;
+            // Audio bytes between meta data blocks ( 0 - no meta data ).
+            int metaInterval;
+            // Status line "ICY 200 OK" ( Shoutcast ) or "HTTP/1.0 200 OK" ( Icecast ).
+            bool icyStatus;
+            // Other than 200 - refused with this code.
+            int statusCode;
+            // Audio sent at once after response head ( bytes ).
+            int burst;
+            // Delay of response head ( msec ).
+            int latency;
+            // Send rate ( kbit/s, 0 - stream bitrate ).
+            int bandwidth;
+            // Nothing is sent for stallLength, stallAfter from connect ( msec, 0 - no stall ).
+            int stallAfter;
+            int stallLength;
+            // Connection is closed after this long ( msec, 0 - never ).
+            int dropAfter;
+            // Track title changes this often ( msec ).
+            int titlePeriod;
+        };
+
+        explicit StandInServer( QObject * parent = 0 );
+        ~StandInServer();
+
+        // Options of connections accepted from now on.
+        void setOptions( const Options & options );
+        // Listen on loopback, returns stream url ( empty on failure ).
+        QUrl start();
+
+        // Connections accepted since start.
+        int connectionCount() const;
+        // Head of last request.
+        QByteArray lastRequest() const;
+        // Track number of title being sent now.
+        int currentTrack() const;
+
+    signals:
+        void clientConnected();
+        // Server closed connection ( dropAfter ).
+        void clientDropped();
+
+    private slots:
+        void onNewConnection();
+        void onReadyRead();
+        void onDisconnected();
+        // Send what each client is due.
+        void pump();
+
+    private:
+        struct Client
+        {
+            Client() : socket( 0 ), answered( false ), closing( false ), withMeta( false ), answeredAt( 0 ),
+                       sent( 0 ), audioLeft( 0 ), frameOffset( 0 ), track( -1 ) {}
+
+            QTcpSocket * socket;
+            Options options;
+            QElapsedTimer age;
+            QByteArray request;
+            bool answered;
+            // Server is closing connection.
+            bool closing;
+            bool withMeta;
+            // Age when response head was sent ( msec ).
+            qint64 answeredAt;
+            // Audio bytes sent ( or skipped for slow client ).
+            qint64 sent;
+            // Audio bytes before next meta data block.
+            int audioLeft;
+            // Silent frame and position in it.
+            QByteArray frame;
+            int frameOffset;
+            // Title sent last.
+            int track;
+        };
+
+        // Client of socket ( -1 - unknown ).
+        int clientIndex( QTcpSocket * socket ) const;
+        // Status line and headers.
+        void answer( Client & client );
+        // Audio and meta data up to byte count.
+        void sendAudio( Client & client, qint64 count );
+        // Meta data block ( zero length if title didn't change ).
+        QByteArray metaBlock( Client & client );
+        // Close connection, client is removed when socket disconnects.
+        void drop( Client & client );
+        // Silent frame of bitrate.
+        static QByteArray silentFrame( int bitrate );
+
+        Options current;
+        QList< Client > clients;
+        QTimer timer;
+        QElapsedTimer clock;
+        int connections;
+        QByteArray last;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//
+// Synthetic data for tests and benchmarks.
+//
+#include "synthetic.h"
+
+static const char * const genres[] =
+{
+    "Jazz", "Rock", "Classic", "Ambient", "News", "Talk", "Chillout", "Metal",
+    "Blues", "Country", "Lounge", "Techno", "Folk", "Reggae", "Soul", "Pop"
+};
+#define GENRE_COUNT 16
+
+static const char * const places[] =
+{
+    "Radio", "FM", "Moscow", "Berlin", "Paris", "London", "Wien", "Praha",
+    "Helsinki", "Montreal", "Tokyo", "Lisboa"
+};
+#define PLACE_COUNT 12
+
+static const char * const encodings[] = { "", "UTF-8", "Windows-1251", "KOI8-R" };
+#define ENCODING_COUNT 4
+
+QList< Station > Synthetic::stations( int count )
+{
+    QList< Station > list;
+    list.reserve( count );
+    quint32 seed = 42;
+    for ( int i = 0; i < count; ++i )
+    {
+        const char * genre = genres[ next( seed ) % GENRE_COUNT ];
+        const char * place = places[ next( seed ) % PLACE_COUNT ];
+
+        Station station;
+        station.id = quint32( i + 1 );
+        station.name = QString( "%1 %2 %3" ).arg( place ).arg( genre ).arg( i + 1 );
+        station.description = QString( "%1 music from %2, %3 kbit/s" )
+                              .arg( genre ).arg( place ).arg( 32 << ( next( seed ) % 4 ) );
+        station.url = QString( "http://stream%1.example.com:8000/%2.mp3" )
+                      .arg( next( seed ) % 100 ).arg( QString( genre ).toLower() + QString::number( i + 1 ) );
+        station.encoding = encodings[ next( seed ) % ENCODING_COUNT ];
+        list.append( station );
+    }
+
+    return list;
+}
+
+QMultiMap< QString, QString > Synthetic::metaData( int track )
+{
+    // Backend puts more keys than are shown, some stations send them empty.
+    quint32 seed = quint32( track );
+    QMultiMap< QString, QString > data;
+    data.insert( "ARTIST", QString( "Artist %1" ).arg( track / 3 ) );
+    data.insert( "TITLE", QString( "Title of track number %1" ).arg( track ) );
+    data.insert( "ALBUM", ( next( seed ) % 2 ) ? QString( "Album %1" ).arg( track / 10 ) : QString() );
+    data.insert( "GENRE", genres[ next( seed ) % GENRE_COUNT ] );
+    data.insert( "DATE", QString::number( 1960 + next( seed ) % 60 ) );
+    data.insert( "TRACKNUMBER", QString::number( track % 12 + 1 ) );
+    data.insert( "DESCRIPTION", QString() );
+    return data;
+}
+
+QString Synthetic::trackTitle( int track )
+{
+    return QString( "Artist %1 - Title of track number %2" ).arg( track / 3 ).arg( track );
+}
+
+quint32 Synthetic::next( quint32 & seed )
+{
+    // Numerical Recipes LCG, upper bits are the better ones.
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
@@ -0,0 +1,31 @@
+//
+// Synthetic data for tests and benchmarks.
+//
+// Generated content is the same on every run ( fixed pseudo random
+// sequence ), so results of different builds are comparable.
+//
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <QList>
+#include <QMultiMap>
+#include <QString>
+
+#include "station.h"
+
+class Synthetic
+{
+    public:
+        // Stations with ids 1 .. count, names share words like real catalogs.
+        static QList< Station > stations( int count );
+        // Meta data map as backend reports it for track number.
+        static QMultiMap< QString, QString > metaData( int track );
+        // "Artist - Title" of track number.
+        static QString trackTitle( int track );
+
+    private:
+        // Next value of fixed pseudo random sequence.
+        static quint32 next( quint32 & seed );
+};
+
+#endif
@@ -0,0 +1,16 @@
+//
+// Wait for signals caught by QSignalSpy, event loop keeps running.
+//
+#include "waitfor.h"
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+bool waitFor( QSignalSpy & spy, int count, int timeout )
+{
+    QElapsedTimer clock;
+    clock.start();
+    while ( ( spy.count() < count ) && ( clock.elapsed() < timeout ) )
+        QTest::qWait( 20 );
+    return spy.count() >= count;
+}
@@ -0,0 +1,12 @@
+//
+// Wait for signals caught by QSignalSpy, event loop keeps running.
+//
+#ifndef WAIT_FOR_H
+#define WAIT_FOR_H
+
+class QSignalSpy;
+
+// Wait until spy caught count signals, false on timeout ( msec ).
+bool waitFor( QSignalSpy & spy, int count, int timeout );
+
+#endif
@@ -0,0 +1,84 @@
+#
+# Player sources as static library for tests ( all but main.cpp, Application
+# and AboutDialog ).
+#
+
+TEMPLATE = lib
+TARGET = qradiotraycore
+CONFIG += staticlib
+CONFIG -= debug_and_release
+SRC = ../../src
+DEPENDPATH += $$SRC ../../ui
+INCLUDEPATH += $$SRC
+UI_DIR = tmp
+MOC_DIR = tmp
+OBJECTS_DIR = tmp
+
+#
+# Modules.
+#
+
+QT += core gui network phonon
+
+#
+# Files.
+#
+
+SOURCES += \
+    $$SRC/player.cpp \
+    $$SRC/settingsdialog.cpp \
+    $$SRC/stationdialog.cpp \
+    $$SRC/logger.cpp \
+    $$SRC/tracer.cpp \
+    $$SRC/stationcatalog.cpp \
+    $$SRC/safefile.cpp \
+    $$SRC/stationprober.cpp \
+    $$SRC/stationimporter.cpp \
+    $$SRC/playlist.cpp \
+    $$SRC/stationsmenu.cpp \
+    $$SRC/trayanimator.cpp \
+    $$SRC/metadatafilter.cpp \
+    $$SRC/streambuffer.cpp \
+    $$SRC/icyclient.cpp \
+    $$SRC/stationmodel.cpp \
+    $$SRC/stationfiltermodel.cpp \
+    $$SRC/stationindex.cpp \
+    $$SRC/recorder.cpp \
+    $$SRC/timeshift.cpp \
+    $$SRC/hostresolver.cpp \
+    $$SRC/stationmonitor.cpp \
+    $$SRC/controlserver.cpp \
+    $$SRC/metrics.cpp \
+    $$SRC/levelmeter.cpp
+
+HEADERS += \
+    $$SRC/player.h \
+    $$SRC/station.h \
+    $$SRC/settingsdialog.h \
+    $$SRC/stationdialog.h \
+    $$SRC/logger.h \
+    $$SRC/tracer.h \
+    $$SRC/stationcatalog.h \
+    $$SRC/safefile.h \
+    $$SRC/stationprober.h \
+    $$SRC/stationimporter.h \
+    $$SRC/playlist.h \
+    $$SRC/stationsmenu.h \
+    $$SRC/trayanimator.h \
+    $$SRC/metadatafilter.h \
+    $$SRC/streambuffer.h \
+    $$SRC/icyclient.h \
+    $$SRC/stationmodel.h \
+    $$SRC/stationfiltermodel.h \
+    $$SRC/stationindex.h \
+    $$SRC/recorder.h \
+    $$SRC/timeshift.h \
+    $$SRC/hostresolver.h \
+    $$SRC/stationmonitor.h \
+    $$SRC/controlserver.h \
+    $$SRC/metrics.h \
+    $$SRC/levelmeter.h
+
+FORMS += \
+    ../../ui/settingsdialog.ui \
+    ../../ui/stationdialog.ui
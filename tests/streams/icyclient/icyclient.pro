@@ -0,0 +1,9 @@
+#
+# Test: ICY client against stand-in server ( demux, titles, status lines ).
+#
+
+TEMPLATE = app
+TARGET = test_icyclient
+include( ../../tests.pri )
+
+SOURCES += test_icyclient.cpp
@@ -0,0 +1,187 @@
+//
+// Test: ICY client against stand-in server.
+//
+#include <QtTest>
+
+#include "icyclient.h"
+#include "standinserver.h"
+#include "waitfor.h"
+
+// Longest wait for stream start ( msec ).
+#define TEST_TIMEOUT 5000
+
+// Audio parts of chunks caught by spy, joined.
+static QByteArray joined( const QSignalSpy & spy )
+{
+    QByteArray audio;
+    foreach ( const QList< QVariant > & arguments, spy )
+        audio += arguments.at( 0 ).toByteArray().mid( arguments.at( 1 ).toInt(), arguments.at( 2 ).toInt() );
+    return audio;
+}
+
+class TestIcyClient : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        // Headers are parsed, audio comes without meta data blocks.
+        void demux_data();
+        void demux();
+        // Changed titles are reported once each.
+        void titles();
+        // 4xx answer: failed, retry won't help.
+        void refused();
+        // Server closing stream is a failure.
+        void dropped();
+        // Cleared faults release held data on open stream.
+        void faultsCleared();
+};
+
+void TestIcyClient::demux_data()
+{
+    QTest::addColumn< bool >( "icyStatus" );
+    QTest::addColumn< int >( "metaInterval" );
+    QTest::addColumn< int >( "bitrate" );
+    QTest::newRow( "shoutcast" ) << true << 16000 << 128;
+    QTest::newRow( "icecast" ) << false << 16000 << 128;
+    QTest::newRow( "no meta data" ) << true << 0 << 128;
+    // Blocks inside frames and chunks.
+    QTest::newRow( "short interval" ) << true << 333 << 64;
+}
+
+void TestIcyClient::demux()
+{
+    QFETCH( bool, icyStatus );
+    QFETCH( int, metaInterval );
+    QFETCH( int, bitrate );
+
+    StandInServer server;
+    StandInServer::Options options;
+    options.icyStatus = icyStatus;
+    options.metaInterval = metaInterval;
+    options.bitrate = bitrate;
+    options.titlePeriod = 500;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    IcyClient client( 0 );
+    QSignalSpy started( &client, SIGNAL( streamStarted() ) );
+    QSignalSpy audio( &client, SIGNAL( audioReceived( const QByteArray &, int, int ) ) );
+    QSignalSpy failed( &client, SIGNAL( failed( const QString & ) ) );
+    client.open( url );
+    QVERIFY( waitFor( started, 1, TEST_TIMEOUT ) );
+    QTest::qWait( 1500 );
+    QVERIFY( failed.isEmpty() );
+
+    QCOMPARE( client.statusCode(), 200 );
+    QCOMPARE( client.contentType(), QByteArray( "audio/mpeg" ) );
+    QCOMPARE( client.stationName(), QByteArray( "Stand-in radio" ) );
+    QCOMPARE( client.bitrate(), bitrate );
+    QCOMPARE( client.metaInterval(), metaInterval );
+    QVERIFY( server.lastRequest().toLower().contains( "icy-metadata: 1" ) );
+
+    // Burst and a second of audio, frame headers on every frame boundary.
+    const QByteArray stream = joined( audio );
+    const int frame = 144000 * bitrate / 44100;
+    QVERIFY( stream.size() > options.burst );
+    QVERIFY( !stream.contains( "StreamTitle" ) );
+    for ( int offset = 0; offset + frame < stream.size(); offset += frame )
+    {
+        QCOMPARE( quint8( stream[ offset ] ), quint8( 0xff ) );
+        QCOMPARE( quint8( stream[ offset + 1 ] ), quint8( 0xfb ) );
+    }
+    client.close();
+}
+
+void TestIcyClient::titles()
+{
+    StandInServer server;
+    StandInServer::Options options;
+    options.metaInterval = 4000;
+    options.titlePeriod = 1000;
+    options.burst = 0;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    IcyClient client( 0 );
+    QSignalSpy titles( &client, SIGNAL( titleReceived( const QByteArray & ) ) );
+    client.open( url );
+    QVERIFY( waitFor( titles, 3, TEST_TIMEOUT ) );
+
+    // Same title in later blocks is not reported again.
+    for ( int i = 0; i < titles.count(); ++i )
+    {
+        const QByteArray title = titles[ i ].at( 0 ).toByteArray();
+        QVERIFY( title.startsWith( "Artist " ) );
+        QVERIFY( title.contains( " - Title of track number " ) );
+        if ( i > 0 )
+            QVERIFY( title != titles[ i - 1 ].at( 0 ).toByteArray() );
+    }
+    client.close();
+}
+
+void TestIcyClient::refused()
+{
+    StandInServer server;
+    StandInServer::Options options;
+    options.statusCode = 404;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    IcyClient client( 0 );
+    QSignalSpy started( &client, SIGNAL( streamStarted() ) );
+    QSignalSpy failed( &client, SIGNAL( failed( const QString & ) ) );
+    client.open( url );
+    QVERIFY( waitFor( failed, 1, TEST_TIMEOUT ) );
+    QVERIFY( started.isEmpty() );
+    QVERIFY( client.isRefused() );
+    QCOMPARE( client.statusCode(), 404 );
+    QVERIFY( !client.isOpen() );
+}
+
+void TestIcyClient::dropped()
+{
+    StandInServer server;
+    StandInServer::Options options;
+    options.dropAfter = 1000;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    IcyClient client( 0 );
+    QSignalSpy started( &client, SIGNAL( streamStarted() ) );
+    QSignalSpy failed( &client, SIGNAL( failed( const QString & ) ) );
+    client.open( url );
+    QVERIFY( waitFor( started, 1, TEST_TIMEOUT ) );
+    QVERIFY( waitFor( failed, 1, TEST_TIMEOUT ) );
+    QCOMPARE( failed.count(), 1 );
+    QVERIFY( !client.isRefused() );
+    QVERIFY( !client.isStreaming() );
+}
+
+void TestIcyClient::faultsCleared()
+{
+    StandInServer server;
+    const QUrl url = server.start();
+
+    IcyClient client( 0 );
+    QSignalSpy started( &client, SIGNAL( streamStarted() ) );
+    QSignalSpy audio( &client, SIGNAL( audioReceived( const QByteArray &, int, int ) ) );
+    IcyClient::Faults faults;
+    faults.latency = 60000;
+    client.setFaults( faults );
+    client.open( url );
+
+    // Everything is held back, even response head.
+    QTest::qWait( 1000 );
+    QVERIFY( started.isEmpty() );
+
+    client.setFaults( IcyClient::Faults() );
+    QVERIFY( waitFor( started, 1, TEST_TIMEOUT ) );
+    QTest::qWait( 500 );
+    QVERIFY( !joined( audio ).isEmpty() );
+    QCOMPARE( server.connectionCount(), 1 );
+    client.close();
+}
+
+QTEST_MAIN( TestIcyClient )
+#include "test_icyclient.moc"
@@ -0,0 +1,10 @@
+#
+# Harness: real Player against stand-in server, records time to first
+# audio, switch latency, buffering events and recovery time.
+#
+
+TEMPLATE = app
+TARGET = test_playback
+include( ../../tests.pri )
+
+SOURCES += test_playback.cpp
@@ -0,0 +1,276 @@
+//
+// Harness: real Player against stand-in server.
+//
+// Each case reports its measure as benchmark result, so "make check" XML
+// of different builds can be compared. Cases are skipped when Phonon
+// backend can't play ( no audio device ).
+//
+#include <QtTest>
+
+#include "player.h"
+#include "standinserver.h"
+#include "waitfor.h"
+
+// Longest wait for audio ( msec ).
+#define HARNESS_TIMEOUT 20000
+// Play time of buffering cases ( msec ).
+#define HARNESS_PLAY_TIME 15000
+
+// Meta data as Player sends it ( spy needs registered type ).
+typedef QMultiMap< QString, QString > MetaData;
+Q_DECLARE_METATYPE( MetaData )
+
+class TestPlayback : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        // Start to audio, title from ICY meta data reaches player.
+        void firstAudio_data();
+        void firstAudio();
+        // Station change while playing, cold and from standby stream.
+        void switchLatency_data();
+        void switchLatency();
+        // Underruns when server stalls or can't keep up.
+        void buffering_data();
+        void buffering();
+        // Outage after server drops stream.
+        void recovery();
+        // Client faults set and cleared on open stream.
+        void faultsChange();
+
+    private:
+        // Player reading http through own client.
+        void setUp( Player & player );
+
+        bool canPlay;
+};
+
+void TestPlayback::initTestCase()
+{
+    // Phonon backends need application name.
+    QCoreApplication::setApplicationName( "QRadioTray tests" );
+    qRegisterMetaType< MetaData >( "QMultiMap<QString,QString>" );
+
+    StandInServer server;
+    const QUrl url = server.start();
+    QVERIFY( url.isValid() );
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    player.setUrl( url );
+    player.startPlay();
+    canPlay = waitFor( started, 1, HARNESS_TIMEOUT );
+    player.stopPlay();
+    if ( !canPlay )
+        qWarning( "Phonon backend doesn't play, playback cases are skipped." );
+}
+
+void TestPlayback::setUp( Player & player )
+{
+    player.setNativeStream( true, 262144 );
+    player.setPrebuffer( 500, 4000 );
+    player.setReconnectPolicy( 8, 60000 );
+}
+
+void TestPlayback::firstAudio_data()
+{
+    QTest::addColumn< int >( "bitrate" );
+    QTest::addColumn< bool >( "icyStatus" );
+    QTest::addColumn< int >( "latency" );
+    QTest::newRow( "128k icy" ) << 128 << true << 0;
+    QTest::newRow( "128k icecast" ) << 128 << false << 0;
+    QTest::newRow( "32k" ) << 32 << true << 0;
+    QTest::newRow( "320k" ) << 320 << true << 0;
+    QTest::newRow( "latency 500" ) << 128 << true << 500;
+}
+
+void TestPlayback::firstAudio()
+{
+    if ( !canPlay )
+        QSKIP( "Phonon backend doesn't play.", SkipAll );
+    QFETCH( int, bitrate );
+    QFETCH( bool, icyStatus );
+    QFETCH( int, latency );
+
+    StandInServer server;
+    StandInServer::Options options;
+    options.bitrate = bitrate;
+    options.icyStatus = icyStatus;
+    options.latency = latency;
+    options.metaInterval = bitrate * 125;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    QSignalSpy titles( &player, SIGNAL( metaDataChanged( const QMultiMap< QString, QString > & ) ) );
+    QElapsedTimer clock;
+    clock.start();
+    player.setUrl( url );
+    player.startPlay();
+    QVERIFY( waitFor( started, 1, HARNESS_TIMEOUT ) );
+    const qint64 firstAudio = clock.elapsed();
+
+    // Meta data block follows every second of audio.
+    QVERIFY( waitFor( titles, 1, 3000 ) );
+    const MetaData data = titles.first().first().value< MetaData >();
+    QVERIFY( data.value( "TITLE" ).startsWith( "Title of track number" ) );
+    QVERIFY( server.lastRequest().toLower().contains( "icy-metadata: 1" ) );
+    player.stopPlay();
+
+    QTest::setBenchmarkResult( firstAudio, QTest::WalltimeMilliseconds );
+}
+
+void TestPlayback::switchLatency_data()
+{
+    QTest::addColumn< bool >( "warm" );
+    QTest::newRow( "cold" ) << false;
+    QTest::newRow( "standby" ) << true;
+}
+
+void TestPlayback::switchLatency()
+{
+    if ( !canPlay )
+        QSKIP( "Phonon backend doesn't play.", SkipAll );
+    QFETCH( bool, warm );
+
+    StandInServer first;
+    StandInServer second;
+    const QUrl firstUrl = first.start();
+    const QUrl secondUrl = second.start();
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    QSignalSpy switched( &player, SIGNAL( switched( int, bool ) ) );
+    player.setUrl( firstUrl );
+    player.startPlay();
+    QVERIFY( waitFor( started, 1, HARNESS_TIMEOUT ) );
+
+    if ( warm )
+    {
+        // Standby stream needs its burst before switch.
+        player.warmUp( QList< QUrl >() << secondUrl );
+        QTest::qWait( 1000 );
+    }
+    player.switchTo( secondUrl );
+    QVERIFY( waitFor( switched, 1, HARNESS_TIMEOUT ) );
+    QCOMPARE( switched.first().at( 1 ).toBool(), warm );
+    player.stopPlay();
+
+    QTest::setBenchmarkResult( switched.first().at( 0 ).toInt(), QTest::WalltimeMilliseconds );
+}
+
+void TestPlayback::buffering_data()
+{
+    QTest::addColumn< int >( "stall" );
+    QTest::addColumn< int >( "bandwidth" );
+    QTest::newRow( "steady" ) << 0 << 0;
+    QTest::newRow( "stall 6s" ) << 6000 << 0;
+    QTest::newRow( "bandwidth 96k" ) << 0 << 96;
+}
+
+void TestPlayback::buffering()
+{
+    if ( !canPlay )
+        QSKIP( "Phonon backend doesn't play.", SkipAll );
+    QFETCH( int, stall );
+    QFETCH( int, bandwidth );
+
+    StandInServer server;
+    StandInServer::Options options;
+    options.stallAfter = ( stall > 0 ) ? 4000 : 0;
+    options.stallLength = stall;
+    options.bandwidth = bandwidth;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    QSignalSpy errors( &player, SIGNAL( errorOccured() ) );
+    player.setUrl( url );
+    player.startPlay();
+    QVERIFY( waitFor( started, 1, HARNESS_TIMEOUT ) );
+    QTest::qWait( HARNESS_PLAY_TIME );
+
+    // Stream must survive, trouble shows only as buffering.
+    QVERIFY( errors.isEmpty() );
+    if ( stall == 0 && bandwidth == 0 )
+        QCOMPARE( player.underrunCount(), 0 );
+    else
+        QVERIFY( player.underrunCount() > 0 );
+    player.stopPlay();
+
+    QTest::setBenchmarkResult( player.underrunCount(), QTest::Events );
+}
+
+void TestPlayback::recovery()
+{
+    if ( !canPlay )
+        QSKIP( "Phonon backend doesn't play.", SkipAll );
+
+    StandInServer server;
+    StandInServer::Options options;
+    options.dropAfter = 5000;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    QSignalSpy reconnected( &player, SIGNAL( reconnected( int, int ) ) );
+    player.setUrl( url );
+    player.startPlay();
+    QVERIFY( waitFor( started, 1, HARNESS_TIMEOUT ) );
+
+    // Next connection is kept.
+    server.setOptions( StandInServer::Options() );
+    QVERIFY( waitFor( reconnected, 1, HARNESS_TIMEOUT ) );
+    QVERIFY( server.connectionCount() >= 2 );
+    QCOMPARE( player.outageCount(), 1 );
+    player.stopPlay();
+
+    QTest::setBenchmarkResult( reconnected.first().at( 1 ).toInt(), QTest::WalltimeMilliseconds );
+}
+
+void TestPlayback::faultsChange()
+{
+    if ( !canPlay )
+        QSKIP( "Phonon backend doesn't play.", SkipAll );
+
+    StandInServer server;
+    const QUrl url = server.start();
+
+    Player player;
+    setUp( player );
+    QSignalSpy started( &player, SIGNAL( audioStarted() ) );
+    QSignalSpy reconnecting( &player, SIGNAL( reconnecting( int, int ) ) );
+    player.setUrl( url );
+    player.startPlay();
+    QVERIFY( waitFor( started, 1, HARNESS_TIMEOUT ) );
+
+    // Faults reach open stream: bandwidth below bitrate drains buffer.
+    IcyClient::Faults faults;
+    faults.bandwidth = 32;
+    player.setFaults( faults );
+    QTest::qWait( 8000 );
+    QVERIFY( player.underrunCount() > 0 );
+
+    // Cleared faults release held data, stream goes on without reconnect.
+    const int underruns = player.underrunCount();
+    player.setFaults( IcyClient::Faults() );
+    QTest::qWait( 8000 );
+    QVERIFY( player.throughput() > 0 );
+    QVERIFY( player.underrunCount() <= underruns + 1 );
+    QVERIFY( reconnecting.isEmpty() );
+    QCOMPARE( server.connectionCount(), 1 );
+    player.stopPlay();
+}
+
+QTEST_MAIN( TestPlayback )
+#include "test_playback.moc"
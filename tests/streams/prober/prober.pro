@@ -0,0 +1,10 @@
+#
+# Test: station prober against stand-in server ( results, timeouts,
+# concurrency limit, cancel ).
+#
+
+TEMPLATE = app
+TARGET = test_prober
+include( ../../tests.pri )
+
+SOURCES += test_prober.cpp
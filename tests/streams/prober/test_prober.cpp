@@ -0,0 +1,181 @@
+//
+// Test: station prober against stand-in server.
+//
+#include <QtTest>
+
+#include "stationprober.h"
+#include "standinserver.h"
+#include "waitfor.h"
+
+// Longest wait for probe result ( msec ).
+#define TEST_TIMEOUT 5000
+
+Q_DECLARE_METATYPE( StationProber::Result )
+
+class TestProber : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        // Result by server answer.
+        void result_data();
+        void result();
+        // Probe of silent server ends by timeout.
+        void timeout();
+        // Nothing listens on port.
+        void unreachable();
+        // Running probes never exceed the limit.
+        void concurrency();
+        // Cancelled probe reports only that.
+        void cancel();
+
+    public slots:
+        // Running probes count ( not test cases ).
+        void onStarted();
+        void onFinished();
+
+    private:
+        int running;
+        int mostRunning;
+};
+
+void TestProber::initTestCase()
+{
+    qRegisterMetaType< StationProber::Result >( "StationProber::Result" );
+}
+
+void TestProber::onStarted()
+{
+    ++running;
+    mostRunning = qMax( mostRunning, running );
+}
+
+void TestProber::onFinished()
+{
+    --running;
+}
+
+void TestProber::result_data()
+{
+    QTest::addColumn< bool >( "icyStatus" );
+    QTest::addColumn< int >( "statusCode" );
+    QTest::addColumn< int >( "expected" );
+    // Qt's HTTP parser would reject this one.
+    QTest::newRow( "shoutcast" ) << true << 200 << int( StationProber::Ok );
+    QTest::newRow( "icecast" ) << false << 200 << int( StationProber::Ok );
+    QTest::newRow( "not found" ) << false << 404 << int( StationProber::BadStatus );
+}
+
+void TestProber::result()
+{
+    QFETCH( bool, icyStatus );
+    QFETCH( int, statusCode );
+    QFETCH( int, expected );
+
+    StandInServer server;
+    StandInServer::Options options;
+    options.icyStatus = icyStatus;
+    options.statusCode = statusCode;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    StationProber prober;
+    QSignalSpy finished( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ) );
+    QSignalSpy measured( &prober, SIGNAL( probeMeasured( int, int, const QString &, int ) ) );
+    const int id = prober.probe( url.toString() );
+    QVERIFY( id >= 0 );
+    QVERIFY( waitFor( finished, 1, TEST_TIMEOUT ) );
+
+    QCOMPARE( finished.first().at( 0 ).toInt(), id );
+    QCOMPARE( int( finished.first().at( 1 ).value< StationProber::Result >() ), expected );
+    QCOMPARE( measured.count(), 1 );
+    QVERIFY( measured.first().at( 1 ).toInt() >= 0 );
+    if ( expected == StationProber::Ok )
+    {
+        QCOMPARE( measured.first().at( 2 ).toString(), QString( "audio/mpeg" ) );
+        QCOMPARE( measured.first().at( 3 ).toInt(), 128 );
+    }
+    QCOMPARE( prober.pendingCount(), 0 );
+}
+
+void TestProber::timeout()
+{
+    StandInServer server;
+    StandInServer::Options options;
+    options.latency = 60000;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    StationProber prober;
+    prober.setTimeout( 500 );
+    QSignalSpy finished( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ) );
+    prober.probe( url.toString() );
+    QVERIFY( waitFor( finished, 1, TEST_TIMEOUT ) );
+    QCOMPARE( finished.first().at( 1 ).value< StationProber::Result >(), StationProber::Timeout );
+}
+
+void TestProber::unreachable()
+{
+    // Port of closed server is free.
+    StandInServer server;
+    const QUrl url = server.start();
+    server.close();
+
+    StationProber prober;
+    QSignalSpy finished( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ) );
+    prober.probe( url.toString() );
+    QVERIFY( waitFor( finished, 1, TEST_TIMEOUT ) );
+    QCOMPARE( finished.first().at( 1 ).value< StationProber::Result >(), StationProber::Unreachable );
+}
+
+void TestProber::concurrency()
+{
+    // Answers come late, so probes overlap.
+    StandInServer server;
+    StandInServer::Options options;
+    options.latency = 300;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    running = 0;
+    mostRunning = 0;
+    StationProber prober;
+    prober.setMaxConcurrent( 2 );
+    connect( &prober, SIGNAL( probeStarted( int ) ), SLOT( onStarted() ) );
+    connect( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ), SLOT( onFinished() ) );
+    QSignalSpy finished( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ) );
+    for ( int i = 0; i < 6; ++i )
+        prober.probe( url.toString() + QString( "?%1" ).arg( i ) );
+    QCOMPARE( prober.pendingCount(), 6 );
+
+    QVERIFY( waitFor( finished, 6, TEST_TIMEOUT ) );
+    QCOMPARE( mostRunning, 2 );
+    QCOMPARE( server.connectionCount(), 6 );
+    foreach ( const QList< QVariant > & arguments, finished )
+        QCOMPARE( arguments.at( 1 ).value< StationProber::Result >(), StationProber::Ok );
+}
+
+void TestProber::cancel()
+{
+    StandInServer server;
+    StandInServer::Options options;
+    options.latency = 60000;
+    server.setOptions( options );
+    const QUrl url = server.start();
+
+    StationProber prober;
+    QSignalSpy finished( &prober, SIGNAL( probeFinished( int, StationProber::Result ) ) );
+    QSignalSpy measured( &prober, SIGNAL( probeMeasured( int, int, const QString &, int ) ) );
+    const int id = prober.probe( url.toString() );
+    QTest::qWait( 200 );
+    prober.cancel( id );
+
+    QCOMPARE( finished.count(), 1 );
+    QCOMPARE( finished.first().at( 1 ).value< StationProber::Result >(), StationProber::Cancelled );
+    QVERIFY( measured.isEmpty() );
+    QCOMPARE( prober.pendingCount(), 0 );
+}
+
+QTEST_MAIN( TestProber )
+#include "test_prober.moc"
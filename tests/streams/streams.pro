@@ -0,0 +1,13 @@
+#
+# Stream tests against local stand-in server ( no network needed ).
+#
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    playback \
+    icyclient \
+    prober
+
+check.CONFIG = recursive
+QMAKE_EXTRA_TARGETS += check
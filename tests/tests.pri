@@ -0,0 +1,47 @@
+#
+# Common settings of tests and benchmarks ( tests/<group>/<name>/<name>.pro ).
+#
+# Test links player sources from core library. "make check" runs it and
+# writes QtTest XML results to <name>.xml, so runs of different builds can
+# be compared.
+#
+
+CONFIG += console
+CONFIG -= app_bundle debug_and_release
+DEPENDPATH += $$PWD/../src $$PWD/common
+INCLUDEPATH += $$PWD/../src $$PWD/common
+MOC_DIR = tmp
+OBJECTS_DIR = tmp
+RCC_DIR = tmp
+
+#
+# Modules.
+#
+
+QT += core gui network phonon testlib
+
+#
+# Player sources.
+#
+
+LIBS += -L../../core -lqradiotraycore
+PRE_TARGETDEPS += ../../core/libqradiotraycore.a
+
+#
+# Helpers.
+#
+
+SOURCES += $$PWD/common/synthetic.cpp \
+           $$PWD/common/standinserver.cpp \
+           $$PWD/common/waitfor.cpp
+HEADERS += $$PWD/common/synthetic.h \
+           $$PWD/common/standinserver.h \
+           $$PWD/common/waitfor.h
+
+#
+# Run.
+#
+
+unix: check.commands = ./$$TARGET -xml -o $${TARGET}.xml
+win32: check.commands = $${TARGET}.exe -xml -o $${TARGET}.xml
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,16 @@
+#
+# Tests and benchmarks.
+#
+
+TEMPLATE = subdirs
+# Core library first.
+CONFIG += ordered
+
+SUBDIRS += \
+    core \
+    benchmarks \
+    streams
+
+check.CONFIG = recursive
+check.recurse = benchmarks streams
+QMAKE_EXTRA_TARGETS += check